@@ -0,0 +1,213 @@
+#include "batch.h"
+#include "chip8.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <thread>
+
+namespace CHIP8
+{
+	#pragma region Helpers
+
+	uint64_t HashDisplayState(const uint64_t* video, size_t rows)
+	{
+		const uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+		const uint64_t FNV_PRIME = 0x100000001B3ULL;
+
+		uint64_t hash = FNV_OFFSET_BASIS;
+		size_t i;
+		int shift;
+
+		/* Hash byte by byte from the leftmost pixel so the result does not depend on host byte order */
+		for (i = 0; i < rows; i++)
+		{
+			for (shift = 56; shift >= 0; shift -= 8)
+			{
+				hash ^= (video[i] >> shift) & 0xFFU;
+				hash *= FNV_PRIME;
+			}
+		}
+
+		return hash;
+	}
+
+	uint64_t HashDisplayState(const Chip8Processor& chip8)
+	{
+		size_t words = chip8.GetDisplayHeight() * (chip8.GetDisplayWidth() / 64);
+		const uint64_t* plane = chip8.GetDisplayPlane(1);
+		uint64_t hash = HashDisplayState(chip8.GetDisplayState(), words);
+
+		/* An XO-CHIP second plane is folded in; a single-plane screen hashes as before */
+		if (plane)
+			hash = (hash ^ HashDisplayState(plane, words)) * 0x100000001B3ULL;
+
+		return hash;
+	}
+
+	std::string JsonEscape(const std::string& value)
+	{
+		std::string escaped;
+		char buffer[8];
+
+		for (unsigned char c : value)
+		{
+			if (c == '"' || c == '\\')
+			{
+				escaped += '\\';
+				escaped += (char)c;
+			}
+			else if (c < 0x20)
+			{
+				snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+				escaped += buffer;
+			}
+			else
+			{
+				escaped += (char)c;
+			}
+		}
+
+		return escaped;
+	}
+
+	void CollectRoms(const char* path, std::vector<std::string>& roms)
+	{
+		std::error_code error;
+
+		if (std::filesystem::is_directory(path, error))
+		{
+			std::vector<std::string> found;
+
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(path, error))
+			{
+				if (entry.is_regular_file() && entry.path().extension() == ".ch8")
+					found.push_back(entry.path().string());
+			}
+
+			/* Directory iteration order is unspecified, sort so output is stable between runs */
+			std::sort(found.begin(), found.end());
+			roms.insert(roms.end(), found.begin(), found.end());
+		}
+		else
+		{
+			roms.push_back(path);
+		}
+	}
+
+	bool IsRomBundle(const char* path)
+	{
+		return std::filesystem::path(path).extension() == ".c8b";
+	}
+
+	#pragma endregion
+
+	#pragma region RunBatch
+
+	void RunBatch(const std::vector<BatchJob>& jobs, uint64_t frames, uint64_t instructions_per_frame,
+		BatchEngine engine, unsigned int threads,
+		std::vector<BatchResult>& results, std::vector<BatchWorkerStats>& workers)
+	{
+		BatchScript script = { (uint32_t)Chip8Processor::DEFAULT_RANDOM_SEED, NULL, {} };
+
+		RunBatch(jobs, frames, instructions_per_frame, engine, threads, script, results, workers);
+	}
+
+	void RunBatch(const std::vector<BatchJob>& jobs, uint64_t frames, uint64_t instructions_per_frame,
+		BatchEngine engine, unsigned int threads, const BatchScript& script,
+		std::vector<BatchResult>& results, std::vector<BatchWorkerStats>& workers)
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		std::atomic<size_t> next_job(0);
+		std::vector<std::thread> pool;
+		unsigned int t;
+
+		if (threads == 0)
+			threads = std::thread::hardware_concurrency();
+
+		if (threads == 0)
+			threads = 1;
+
+		if (threads > jobs.size() && !jobs.empty())
+			threads = (unsigned int)jobs.size();
+
+		results.assign(jobs.size(), BatchResult());
+		workers.assign(threads, BatchWorkerStats());
+
+		for (t = 0; t < threads; t++)
+		{
+			pool.emplace_back([&, t]()
+			{
+				BatchWorkerStats& stats = workers[t];
+				size_t job;
+
+				/* Workers pull jobs until the queue runs dry, so long ROMs do not leave cores idle */
+				while ((job = next_job.fetch_add(1)) < jobs.size())
+				{
+					BatchResult& result = results[job];
+					std::unique_ptr<Chip8Processor> chip8(new Chip8Processor());
+					size_t checkpoint = 0;
+					uint64_t frame;
+
+					/* Each job replays the input from its own cursor */
+					Chip8InputLog input;
+
+					if (script.input)
+						input = *script.input;
+
+					/* Hosts without a JIT fall back to the interpreter */
+					if (engine == ENGINE_DECODE_CACHE)
+						chip8->SetDecodeCache(true);
+					else if (engine == ENGINE_JIT)
+						chip8->SetJit(true);
+
+					result.rom = jobs[job].rom;
+					result.copy = jobs[job].copy;
+					result.worker = t;
+					result.cycles = 0;
+					result.seconds = 0.0;
+					result.checkpoint_hashes.clear();
+					result.loaded = (jobs[job].image.data ? chip8->LoadROM(jobs[job].image) : chip8->LoadROM(jobs[job].rom.c_str())) != 0;
+
+					chip8->SetRandomSeed(script.seed);
+
+					if (result.loaded)
+					{
+						Clock::time_point start = Clock::now();
+
+						for (frame = 0; frame < frames; frame++)
+						{
+							if (script.input)
+								chip8->SetKeypadMask(input.GetKeys(frame));
+
+							chip8->RunFrame(instructions_per_frame);
+
+							while (checkpoint < script.checkpoints.size() && script.checkpoints[checkpoint] == frame + 1)
+							{
+								result.checkpoint_hashes.push_back(HashDisplayState(*chip8));
+								checkpoint++;
+							}
+						}
+
+						result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+						result.cycles = frames * instructions_per_frame;
+					}
+
+					result.display_hash = HashDisplayState(*chip8);
+
+					stats.jobs++;
+					stats.cycles += result.cycles;
+					stats.seconds += result.seconds;
+				}
+			});
+		}
+
+		for (std::thread& worker : pool)
+			worker.join();
+	}
+
+	#pragma endregion
+}
@@ -0,0 +1,96 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "chip8.h"
+#include "inputlog.h"
+
+namespace CHIP8
+{
+	/* Execution engine used for every job in a batch */
+	enum BatchEngine
+	{
+		ENGINE_TABLE,
+		ENGINE_DECODE_CACHE,
+		ENGINE_JIT
+	};
+
+	/*
+	 * One headless run of a ROM. The same ROM may appear several times with different copy numbers. The ROM is
+	 * loaded from image if it has data, such as a ROM in a mapped bundle, and read from the file rom otherwise.
+	 */
+	struct BatchJob
+	{
+		std::string rom;
+		unsigned int copy;
+		ByteSpan image;
+	};
+
+	/* What every job in a batch is fed and which frames are checked, for runs that must be reproducible */
+	struct BatchScript
+	{
+		/* CXNN seed every job starts from */
+		uint32_t seed;
+
+		/* Keys held in each frame, or NULL to leave the keypad released. Not owned. */
+		const Chip8InputLog* input;
+
+		/* Frame counts, ascending, after which the framebuffer is hashed into BatchResult::checkpoint_hashes */
+		std::vector<uint64_t> checkpoints;
+	};
+
+	/* Outcome of a single BatchJob */
+	struct BatchResult
+	{
+		std::string rom;
+		unsigned int copy;
+		bool loaded;
+		uint64_t cycles;
+		double seconds;
+		uint64_t display_hash;
+		std::vector<uint64_t> checkpoint_hashes;
+		unsigned int worker;
+	};
+
+	/* Aggregate throughput of one worker thread */
+	struct BatchWorkerStats
+	{
+		uint64_t jobs;
+		uint64_t cycles;
+		double seconds;
+	};
+
+	/* Hash the rows of a Chip-8 framebuffer (64-bit FNV-1a) */
+	uint64_t HashDisplayState(const uint64_t* video, size_t rows);
+
+	/* Hash the machine's framebuffer at its current resolution and every plane in use; 64x32 Chip-8 hashes as above */
+	uint64_t HashDisplayState(const Chip8Processor& chip8);
+
+	/* Escape a string for use inside a JSON string literal */
+	std::string JsonEscape(const std::string& value);
+
+	/* Expand a command line path into ROM files. Directories are searched recursively for .ch8 files. */
+	void CollectRoms(const char* path, std::vector<std::string>& roms);
+
+	/* True if path names a ROM bundle (.c8b) rather than a ROM or a directory */
+	bool IsRomBundle(const char* path);
+
+	/*
+	 * Run every job for the given number of 60 Hz frames of instructions_per_frame instructions each on a
+	 * pool of worker threads. Each job gets its own Chip8Processor, so jobs never share machine state.
+	 * results is resized to match jobs and workers to the number of threads used. A thread count of zero
+	 * uses every hardware thread.
+	 */
+	void RunBatch(const std::vector<BatchJob>& jobs, uint64_t frames, uint64_t instructions_per_frame,
+		BatchEngine engine, unsigned int threads,
+		std::vector<BatchResult>& results, std::vector<BatchWorkerStats>& workers);
+
+	/* As above, with every job seeded, fed input and hashed at checkpoints as script says */
+	void RunBatch(const std::vector<BatchJob>& jobs, uint64_t frames, uint64_t instructions_per_frame,
+		BatchEngine engine, unsigned int threads, const BatchScript& script,
+		std::vector<BatchResult>& results, std::vector<BatchWorkerStats>& workers);
+}
+
+#endif
@@ -0,0 +1,206 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "batch.h"
+#include "rombundle.h"
+
+/*
+ * Headless batch runner. Runs ROMs (or many copies of one ROM) across a pool of worker threads
+ * with no SDL window and writes per-ROM results plus per-core throughput as JSON.
+ *
+ * Usage: chip8-batch [--threads N] [--cycles N | --frames N [--ipf N]] [--copies N] [--engine table|cached|jit] [--output FILE] ROM|DIR|BUNDLE...
+ *
+ * A .c8b bundle written by chip8-pack is mapped once and every ROM in it becomes a job, loaded straight from the mapping.
+ */
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: chip8-batch [--threads N] [--cycles N | --frames N [--ipf N]] [--copies N] [--engine table|cached|jit] [--output FILE] ROM|DIR|BUNDLE..." << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<CHIP8::BatchJob> roms;
+	std::vector<std::unique_ptr<CHIP8::Chip8RomBundle>> bundles;
+	unsigned int threads = 0;
+	unsigned int copies = 1;
+	uint64_t cycles = 0;
+	uint64_t frames = 0;
+	uint64_t instructions_per_frame = 8;
+	CHIP8::BatchEngine engine = CHIP8::ENGINE_TABLE;
+	const char* output = NULL;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		bool has_value = i + 1 < argc;
+
+		if (!strcmp(argv[i], "--threads") && has_value)
+			threads = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--cycles") && has_value)
+			cycles = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--frames") && has_value)
+			frames = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--ipf") && has_value)
+			instructions_per_frame = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--copies") && has_value)
+			copies = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--engine") && has_value)
+		{
+			const char* name = argv[++i];
+
+			if (!strcmp(name, "table"))
+				engine = CHIP8::ENGINE_TABLE;
+			else if (!strcmp(name, "cached"))
+				engine = CHIP8::ENGINE_DECODE_CACHE;
+			else if (!strcmp(name, "jit"))
+				engine = CHIP8::ENGINE_JIT;
+			else
+			{
+				PrintUsage();
+				std::exit(EXIT_FAILURE);
+			}
+		}
+		else if (!strcmp(argv[i], "--output") && has_value)
+			output = argv[++i];
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			std::exit(EXIT_FAILURE);
+		}
+		else if (CHIP8::IsRomBundle(argv[i]))
+		{
+			bundles.emplace_back(new CHIP8::Chip8RomBundle());
+
+			if (!bundles.back()->Open(argv[i]))
+			{
+				std::cerr << "Error: Unable to open bundle " << argv[i] << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+
+			for (size_t e = 0; e < bundles.back()->GetCount(); e++)
+			{
+				const CHIP8::RomEntry& entry = bundles.back()->GetEntry(e);
+
+				roms.push_back({ entry.name, 0, entry.image });
+			}
+		}
+		else
+		{
+			std::vector<std::string> files;
+
+			CHIP8::CollectRoms(argv[i], files);
+
+			for (const std::string& file : files)
+				roms.push_back({ file, 0, { NULL, 0 } });
+		}
+	}
+
+	/* Jobs always run whole frames so the timers tick at 60 Hz */
+	if (cycles && instructions_per_frame)
+		frames = (cycles + instructions_per_frame - 1) / instructions_per_frame;
+
+	if (roms.empty() || frames == 0 || instructions_per_frame == 0 || copies == 0)
+	{
+		PrintUsage();
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::vector<CHIP8::BatchJob> jobs;
+	std::vector<CHIP8::BatchResult> results;
+	std::vector<CHIP8::BatchWorkerStats> workers;
+
+	for (const CHIP8::BatchJob& rom : roms)
+	{
+		unsigned int copy;
+
+		for (copy = 0; copy < copies; copy++)
+			jobs.push_back({ rom.rom, copy, rom.image });
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	CHIP8::RunBatch(jobs, frames, instructions_per_frame, engine, threads, results, workers);
+	double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::ofstream file;
+	std::ostream* out = &std::cout;
+
+	if (output)
+	{
+		file.open(output);
+
+		if (!file)
+		{
+			std::cerr << "Error: Unable to open output file " << output << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+
+		out = &file;
+	}
+
+	uint64_t total_cycles = 0;
+	double busy_seconds = 0.0;
+	size_t failed = 0;
+	size_t r;
+	char hash[32];
+
+	*out << "{\n";
+	*out << "  \"frames_per_job\": " << frames << ",\n";
+	*out << "  \"instructions_per_frame\": " << instructions_per_frame << ",\n";
+	*out << "  \"threads\": " << workers.size() << ",\n";
+	*out << "  \"results\": [\n";
+
+	for (r = 0; r < results.size(); r++)
+	{
+		const CHIP8::BatchResult& result = results[r];
+
+		snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)result.display_hash);
+
+		*out << "    { \"rom\": \"" << CHIP8::JsonEscape(result.rom) << "\""
+			<< ", \"copy\": " << result.copy
+			<< ", \"loaded\": " << (result.loaded ? "true" : "false")
+			<< ", \"cycles\": " << result.cycles
+			<< ", \"seconds\": " << result.seconds
+			<< ", \"ips\": " << (result.seconds > 0.0 ? result.cycles / result.seconds : 0.0)
+			<< ", \"display_hash\": \"" << hash << "\""
+			<< ", \"worker\": " << result.worker
+			<< " }" << (r + 1 < results.size() ? "," : "") << "\n";
+
+		if (!result.loaded)
+			failed++;
+	}
+
+	*out << "  ],\n";
+	*out << "  \"workers\": [\n";
+
+	for (r = 0; r < workers.size(); r++)
+	{
+		const CHIP8::BatchWorkerStats& stats = workers[r];
+
+		*out << "    { \"worker\": " << r
+			<< ", \"jobs\": " << stats.jobs
+			<< ", \"cycles\": " << stats.cycles
+			<< ", \"seconds\": " << stats.seconds
+			<< ", \"ips\": " << (stats.seconds > 0.0 ? stats.cycles / stats.seconds : 0.0)
+			<< " }" << (r + 1 < workers.size() ? "," : "") << "\n";
+
+		total_cycles += stats.cycles;
+		busy_seconds += stats.seconds;
+	}
+
+	*out << "  ],\n";
+	*out << "  \"aggregate\": { \"cycles\": " << total_cycles
+		<< ", \"wall_seconds\": " << wall_seconds
+		<< ", \"ips\": " << (wall_seconds > 0.0 ? total_cycles / wall_seconds : 0.0)
+		<< ", \"ips_per_core\": " << (busy_seconds > 0.0 ? total_cycles / busy_seconds : 0.0)
+		<< ", \"failed\": " << failed
+		<< " }\n";
+	*out << "}\n";
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,198 @@
+#include "beeper.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace CHIP8
+{
+	/* Square wave amplitude, well clear of clipping */
+	static const int16_t AMPLITUDE = 3000;
+
+	/* XO-CHIP pattern length in bits */
+	static const unsigned int PATTERN_BITS = Chip8Processor::AUDIO_PATTERN_SIZE * 8;
+
+	static size_t RoundUpToPowerOfTwo(size_t value)
+	{
+		size_t power = 1;
+
+		while (power < value)
+			power *= 2;
+
+		return power;
+	}
+
+	#pragma region Chip8SampleRing
+
+	Chip8SampleRing::Chip8SampleRing(size_t capacity)
+		: samples(RoundUpToPowerOfTwo(capacity)), mask(samples.size() - 1), write_position(0), read_position(0)
+	{
+
+	}
+
+	size_t Chip8SampleRing::Write(const int16_t* data, size_t count)
+	{
+		size_t write = write_position.load(std::memory_order_relaxed);
+		size_t read = read_position.load(std::memory_order_acquire);
+		size_t first;
+
+		count = std::min(count, samples.size() - (write - read));
+		first = std::min(count, samples.size() - (write & mask));
+
+		memcpy(&samples[write & mask], data, first * sizeof(int16_t));
+		memcpy(&samples[0], data + first, (count - first) * sizeof(int16_t));
+
+		/* Publish the samples only once they are in place */
+		write_position.store(write + count, std::memory_order_release);
+
+		return count;
+	}
+
+	size_t Chip8SampleRing::Read(int16_t* data, size_t count)
+	{
+		size_t read = read_position.load(std::memory_order_relaxed);
+		size_t write = write_position.load(std::memory_order_acquire);
+		size_t first;
+
+		count = std::min(count, write - read);
+		first = std::min(count, samples.size() - (read & mask));
+
+		memcpy(data, &samples[read & mask], first * sizeof(int16_t));
+		memcpy(data + first, &samples[0], (count - first) * sizeof(int16_t));
+
+		/* Hand the space back only once the samples are copied out */
+		read_position.store(read + count, std::memory_order_release);
+
+		return count;
+	}
+
+	size_t Chip8SampleRing::GetFill() const
+	{
+		size_t read = read_position.load(std::memory_order_acquire);
+
+		return write_position.load(std::memory_order_acquire) - read;
+	}
+
+	size_t Chip8SampleRing::GetCapacity() const
+	{
+		return samples.size();
+	}
+
+	#pragma endregion
+
+	#pragma region Chip8Beeper
+
+	Chip8Beeper::Chip8Beeper(unsigned int sample_rate, unsigned int buffer_samples)
+		: sample_rate(sample_rate), buffer_samples(buffer_samples),
+		max_queued(buffer_samples + 2 * ((sample_rate + FRAMES_PER_SECOND - 1) / FRAMES_PER_SECOND)), ring(max_queued),
+		frame_samples((sample_rate + FRAMES_PER_SECOND - 1) / FRAMES_PER_SECOND), frames(0), phase(0.0), dropped_samples(0),
+		sounding(false), callbacks(0), underruns(0), underrun_samples(0)
+	{
+
+	}
+
+	void Chip8Beeper::RenderFrame(const Chip8Processor& chip8)
+	{
+		/* Spread sample_rate over 60 frames so rates that are not a multiple of 60 stay in step with the timer */
+		uint64_t second_frame = frames % FRAMES_PER_SECOND;
+		size_t count = (size_t)((sample_rate * (second_frame + 1)) / FRAMES_PER_SECOND - (sample_rate * second_frame) / FRAMES_PER_SECOND);
+		const uint8_t* pattern = chip8.GetAudioPattern();
+		bool playing = chip8.IsSoundPlaying();
+		int16_t* out = frame_samples.data();
+		size_t i;
+
+		frames++;
+
+		if (!playing)
+		{
+			/* Every beep starts from the same point of the waveform */
+			std::fill(out, out + count, 0);
+			phase = 0.0;
+		}
+		else if (pattern)
+		{
+			double step = 4000.0 * pow(2.0, (chip8.GetAudioPitch() - 64) / 48.0) / sample_rate;
+
+			phase = fmod(phase, (double)PATTERN_BITS);
+
+			for (i = 0; i < count; i++)
+			{
+				unsigned int bit = (unsigned int)phase;
+
+				out[i] = (pattern[bit >> 3] >> (7 - (bit & 7))) & 1 ? AMPLITUDE : -AMPLITUDE;
+
+				if ((phase += step) >= PATTERN_BITS)
+					phase -= PATTERN_BITS;
+			}
+		}
+		else
+		{
+			double step = (double)TONE_FREQUENCY / sample_rate;
+
+			phase = fmod(phase, 1.0);
+
+			for (i = 0; i < count; i++)
+			{
+				out[i] = phase < 0.5 ? AMPLITUDE : -AMPLITUDE;
+
+				if ((phase += step) >= 1.0)
+					phase -= 1.0;
+			}
+		}
+
+		if (ring.GetFill() + count > max_queued)
+			dropped_samples += count;
+		else
+			ring.Write(out, count);
+
+		sounding.store(playing, std::memory_order_relaxed);
+	}
+
+	void Chip8Beeper::Stop()
+	{
+		sounding.store(false, std::memory_order_relaxed);
+	}
+
+	void Chip8Beeper::Read(int16_t* out, size_t count)
+	{
+		size_t available = ring.Read(out, count);
+
+		callbacks.fetch_add(1, std::memory_order_relaxed);
+
+		if (available == count)
+			return;
+
+		memset(out + available, 0, (count - available) * sizeof(int16_t));
+
+		/* Running dry while the machine is silent (idle, paused, starting up) cannot be heard */
+		if (sounding.load(std::memory_order_relaxed))
+		{
+			underruns.fetch_add(1, std::memory_order_relaxed);
+			underrun_samples.fetch_add(count - available, std::memory_order_relaxed);
+		}
+	}
+
+	unsigned int Chip8Beeper::GetSampleRate() const
+	{
+		return sample_rate;
+	}
+
+	unsigned int Chip8Beeper::GetBufferSamples() const
+	{
+		return buffer_samples;
+	}
+
+	AudioStats Chip8Beeper::GetStats() const
+	{
+		AudioStats stats;
+
+		stats.frames = frames;
+		stats.callbacks = callbacks.load(std::memory_order_relaxed);
+		stats.underruns = underruns.load(std::memory_order_relaxed);
+		stats.underrun_samples = underrun_samples.load(std::memory_order_relaxed);
+		stats.dropped_samples = dropped_samples;
+
+		return stats;
+	}
+
+	#pragma endregion
+}
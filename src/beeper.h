@@ -0,0 +1,125 @@
+#ifndef _BEEPER_H_
+#define _BEEPER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "chip8.h"
+
+namespace CHIP8
+{
+	/*
+	 * Single-producer, single-consumer ring of 16-bit samples. Write is called from one thread only and Read from
+	 * one other thread only. Neither side locks, waits or allocates, so Read is safe in an audio callback.
+	 */
+	class Chip8SampleRing
+	{
+		private:
+			std::vector<int16_t> samples;
+			size_t mask;
+
+			/* Free-running positions, each stored only by its own side and kept on its own cache line */
+			alignas(64) std::atomic<size_t> write_position;
+			alignas(64) std::atomic<size_t> read_position;
+
+		public:
+			/* The capacity is rounded up to a power of two */
+			explicit Chip8SampleRing(size_t capacity);
+
+			/* Producer: append up to count samples. Returns how many fit. */
+			size_t Write(const int16_t* data, size_t count);
+
+			/* Consumer: take up to count samples. Returns how many were queued. */
+			size_t Read(int16_t* data, size_t count);
+
+			/* Samples queued. Seen from the producer this may be more than are left by the time it returns. */
+			size_t GetFill() const;
+			size_t GetCapacity() const;
+	};
+
+	struct AudioStats
+	{
+		uint64_t frames;
+
+		/* Device callbacks, and the ones that ran out of samples in the middle of a beep */
+		uint64_t callbacks;
+		uint64_t underruns;
+
+		/* Silence inserted by those underruns */
+		uint64_t underrun_samples;
+
+		/* Samples thrown away because the queue was already at the latency limit, such as in turbo mode */
+		uint64_t dropped_samples;
+	};
+
+	/*
+	 * The CHIP-8 buzzer. The emulation thread renders every emulated frame into the ring as sample_rate / 60
+	 * samples, sounding for the whole frame if the sound timer was running when it ticked, so beeps start and
+	 * stop on the exact sample where the 60 Hz tick falls. A plain machine plays a square wave; after XO-CHIP
+	 * F002 the loaded pattern is played at the FX3A pitch instead.
+	 *
+	 * The audio thread takes samples with Read. If the ring runs dry it pads with silence, and counts an underrun
+	 * if the buzzer was meant to be sounding. The queue is held to buffer_samples plus two frames, so a host
+	 * that runs slightly faster than the audio clock drops a frame now and then instead of drifting into lag.
+	 */
+	class Chip8Beeper
+	{
+		public:
+			static const unsigned int DEFAULT_SAMPLE_RATE = 48000;
+
+			/* Device buffer: 512 samples is about 11 ms at 48 kHz */
+			static const unsigned int DEFAULT_BUFFER_SAMPLES = 512;
+
+			/* Frequency of the plain beep */
+			static const unsigned int TONE_FREQUENCY = 440;
+
+		private:
+			/* Sound timer rate, which is also the rate frames are rendered at */
+			static const unsigned int FRAMES_PER_SECOND = 60;
+
+			unsigned int sample_rate;
+			unsigned int buffer_samples;
+
+			/* A frame is dropped rather than queued past this many samples */
+			size_t max_queued;
+
+			Chip8SampleRing ring;
+
+			/* Scratch for the frame being rendered, sized for the longest frame so RenderFrame never allocates */
+			std::vector<int16_t> frame_samples;
+
+			/* Producer state: frames rendered, position in the waveform (cycles or pattern bits), dropped samples */
+			uint64_t frames;
+			double phase;
+			uint64_t dropped_samples;
+
+			/* Whether the last rendered frame sounded, so the consumer can tell a real underrun from idle silence */
+			std::atomic<bool> sounding;
+
+			/* Consumer counters */
+			std::atomic<uint64_t> callbacks;
+			std::atomic<uint64_t> underruns;
+			std::atomic<uint64_t> underrun_samples;
+
+		public:
+			explicit Chip8Beeper(unsigned int sample_rate = DEFAULT_SAMPLE_RATE, unsigned int buffer_samples = DEFAULT_BUFFER_SAMPLES);
+
+			/* Producer: render the frame chip8 just ran. Call once per emulated frame, after RunFrame. */
+			void RenderFrame(const Chip8Processor& chip8);
+
+			/* Producer: no frames will be rendered for a while (paused or rewinding), so silence is expected */
+			void Stop();
+
+			/* Consumer: fill out with count samples. Never blocks or allocates. */
+			void Read(int16_t* out, size_t count);
+
+			unsigned int GetSampleRate() const;
+			unsigned int GetBufferSamples() const;
+
+			/* Call from the producer thread */
+			AudioStats GetStats() const;
+	};
+}
+
+#endif
@@ -0,0 +1,333 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "batch.h"
+#include "chip8.h"
+
+/*
+ * Benchmark suite. Measures the cost of individual opcode handlers, raw dispatch overhead through the jump
+ * tables, and end-to-end instructions/sec on a fixed set of ROMs with a scripted keypad and a fixed RNG seed.
+ * Results are written as JSON with a fixed key order and schema version so runs can be diffed across commits.
+ *
+ * Usage: chip8-bench [--cycles N] [--frames N] [--ipf N] [--repeat N] [--output FILE] [ROM...]
+ */
+
+/* Bump when the meaning or layout of the JSON output changes */
+static const int SCHEMA_VERSION = 1;
+
+static const uint32_t RNG_SEED = 1;
+
+static const char* DEFAULT_ROMS[] =
+{
+	"chip8-roms/programs/Life [GV Samways, 1980].ch8",
+	"chip8-roms/demos/Maze [David Winter, 199x].ch8",
+	"chip8-roms/demos/Sierpinski [Sergey Naydenov, 2010].ch8",
+	"chip8-roms/games/Brix [Andreas Gustafsson, 1990].ch8",
+	"chip8-roms/games/Pong [Paul Vervalin, 1990].ch8",
+	"chip8-roms/games/Space Invaders [David Winter].ch8",
+	"chip8-roms/games/Tetris [Fran Dachille, 1991].ch8",
+	"chip8-roms/games/Blinky [Hans Christian Egeberg, 1991].ch8"
+};
+
+enum Engine
+{
+	TABLE,
+	DECODE_CACHE,
+	JIT
+};
+
+static const char* ENGINE_NAMES[] = { "table", "cached", "jit" };
+
+/* A synthetic program: setup runs once per pass, then body fills the rest and the program jumps back */
+struct Microbenchmark
+{
+	const char* group;
+	const char* name;
+	std::vector<uint16_t> setup;
+	uint16_t body;
+};
+
+struct Measurement
+{
+	double seconds;
+	uint64_t instructions;
+	uint64_t display_hash;
+};
+
+static std::vector<uint8_t> BuildProgram(const Microbenchmark& bench)
+{
+	const unsigned int INSTRUCTIONS = 256;
+	std::vector<uint8_t> program;
+	unsigned int i;
+
+	for (i = 0; i < INSTRUCTIONS; i++)
+	{
+		uint16_t opcode = i < bench.setup.size() ? bench.setup[i] : bench.body;
+		program.push_back(opcode >> 8U);
+		program.push_back(opcode & 0xFFU);
+	}
+
+	program.push_back(0x12);
+	program.push_back(0x00);
+
+	return program;
+}
+
+static bool Configure(CHIP8::Chip8Processor& chip8, Engine engine)
+{
+	chip8.SetDecodeCache(engine == DECODE_CACHE);
+
+	/* Measure the engines themselves, not how much of a ROM's time is spent idling */
+	chip8.SetIdleSkip(false);
+
+	return engine != JIT || chip8.SetJit(true);
+}
+
+/* Run a synthetic program through Cycle, so every instruction pays the full fetch and dispatch */
+static bool RunMicrobenchmark(const std::vector<uint8_t>& program, Engine engine, uint64_t cycles, Measurement& result)
+{
+	std::unique_ptr<CHIP8::Chip8Processor> chip8(new CHIP8::Chip8Processor());
+	uint64_t i;
+
+	if (!Configure(*chip8, engine) || !chip8->LoadROM(program.data(), program.size()))
+		return false;
+
+	chip8->SetRandomSeed(RNG_SEED);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (i = 0; i < cycles; i++)
+		chip8->Cycle();
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.instructions = cycles;
+	result.display_hash = CHIP8::HashDisplayState(*chip8);
+
+	return true;
+}
+
+/* Every 30 frames press the next key for 5 frames, so input-driven ROMs take the same path on every run */
+static void ScriptKeypad(uint8_t* keys, uint64_t frame)
+{
+	unsigned int key = (unsigned int)((frame / 30) % CHIP8::Chip8Processor::INPUT_KEYS);
+	unsigned int i;
+
+	for (i = 0; i < CHIP8::Chip8Processor::INPUT_KEYS; i++)
+		keys[i] = (i == key && frame % 30 < 5) ? 1 : 0;
+}
+
+static bool RunRom(const std::string& rom, Engine engine, uint64_t frames, uint64_t instructions_per_frame, Measurement& result)
+{
+	std::unique_ptr<CHIP8::Chip8Processor> chip8(new CHIP8::Chip8Processor());
+	uint64_t frame;
+
+	if (!Configure(*chip8, engine) || !chip8->LoadROM(rom.c_str()))
+		return false;
+
+	chip8->SetRandomSeed(RNG_SEED);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (frame = 0; frame < frames; frame++)
+	{
+		ScriptKeypad(chip8->GetKeypadState(), frame);
+		chip8->RunFrame(instructions_per_frame);
+	}
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.instructions = frames * instructions_per_frame;
+	result.display_hash = CHIP8::HashDisplayState(*chip8);
+
+	return true;
+}
+
+/* Keep the fastest of several runs to filter out scheduling noise */
+template <typename Run>
+static bool Best(unsigned int repeat, Measurement& best, Run run)
+{
+	Measurement measurement;
+	unsigned int r;
+
+	best.seconds = 1e30;
+
+	for (r = 0; r < repeat; r++)
+	{
+		if (!run(measurement))
+			return false;
+
+		if (measurement.seconds < best.seconds)
+			best = measurement;
+	}
+
+	return true;
+}
+
+static void WriteMeasurement(std::ostream& out, const Measurement& measurement)
+{
+	char hash[32];
+
+	snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)measurement.display_hash);
+
+	out << ", \"instructions\": " << measurement.instructions
+		<< ", \"seconds\": " << measurement.seconds
+		<< ", \"ns_per_instruction\": " << measurement.seconds * 1e9 / measurement.instructions
+		<< ", \"ips\": " << measurement.instructions / measurement.seconds
+		<< ", \"display_hash\": \"" << hash << "\"";
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> roms;
+	uint64_t cycles = 10000000;
+	uint64_t frames = 600;
+	uint64_t instructions_per_frame = 1000;
+	unsigned int repeat = 3;
+	const char* output = NULL;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+			cycles = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+			frames = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--ipf") && i + 1 < argc)
+			instructions_per_frame = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+			repeat = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--output") && i + 1 < argc)
+			output = argv[++i];
+		else
+			roms.push_back(argv[i]);
+	}
+
+	if (roms.empty())
+		roms.assign(std::begin(DEFAULT_ROMS), std::end(DEFAULT_ROMS));
+
+	if (repeat == 0)
+		repeat = 1;
+
+	if (cycles == 0 || frames == 0 || instructions_per_frame == 0)
+	{
+		std::cerr << "Error: --cycles, --frames and --ipf must be positive" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	/* Sprites and stores point I at 0xE00, clear of the 514-byte program at 0x200 */
+	const Microbenchmark microbenchmarks[] =
+	{
+		{ "dispatch", "table 0NNN (Table0, null handler)", { }, 0x0000 },
+		{ "dispatch", "TableF FX00 (null handler)", { }, 0xF000 },
+		{ "dispatch", "table 1NNN to next (jump)", { }, 0x1202 },
+		{ "opcode", "8XY4", { 0x60F0, 0x6133 }, 0x8014 },
+		{ "opcode", "DXYN N=1", { 0xAE00 }, 0xD011 },
+		{ "opcode", "DXYN N=5", { 0xAE00 }, 0xD015 },
+		{ "opcode", "DXYN N=8", { 0xAE00 }, 0xD018 },
+		{ "opcode", "DXYN N=15", { 0xAE00 }, 0xD01F },
+		{ "opcode", "FX33", { 0xAE00, 0x60FE }, 0xF033 },
+		{ "opcode", "FX55 X=15", { 0xAE00 }, 0xFF55 },
+		{ "opcode", "FX65 X=15", { 0xAE00 }, 0xFF65 }
+	};
+
+	std::ofstream file;
+	std::ostream* out = &std::cout;
+
+	if (output)
+	{
+		file.open(output);
+
+		if (!file)
+		{
+			std::cerr << "Error: Unable to open output file " << output << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		out = &file;
+	}
+
+	size_t m;
+	size_t r;
+	unsigned int engine;
+	bool first = true;
+	bool failed = false;
+
+	*out << "{\n";
+	*out << "  \"schema\": " << SCHEMA_VERSION << ",\n";
+	*out << "  \"cycles\": " << cycles << ",\n";
+	*out << "  \"frames\": " << frames << ",\n";
+	*out << "  \"instructions_per_frame\": " << instructions_per_frame << ",\n";
+	*out << "  \"repeat\": " << repeat << ",\n";
+	*out << "  \"seed\": " << RNG_SEED << ",\n";
+	*out << "  \"microbenchmarks\": [\n";
+
+	/* The decode cache isolates the handler cost; the table engine adds the fetch and two-level dispatch */
+	for (m = 0; m < sizeof(microbenchmarks) / sizeof(microbenchmarks[0]); m++)
+	{
+		const Microbenchmark& bench = microbenchmarks[m];
+		std::vector<uint8_t> program = BuildProgram(bench);
+
+		for (engine = TABLE; engine <= DECODE_CACHE; engine++)
+		{
+			Measurement result;
+
+			Best(repeat, result, [&](Measurement& measurement)
+			{
+				return RunMicrobenchmark(program, (Engine)engine, cycles, measurement);
+			});
+
+			*out << (first ? "" : ",\n") << "    { \"group\": \"" << bench.group << "\""
+				<< ", \"name\": \"" << CHIP8::JsonEscape(bench.name) << "\""
+				<< ", \"engine\": \"" << ENGINE_NAMES[engine] << "\"";
+			WriteMeasurement(*out, result);
+			*out << " }";
+
+			first = false;
+		}
+	}
+
+	*out << "\n  ],\n";
+	*out << "  \"roms\": [\n";
+
+	first = true;
+
+	for (r = 0; r < roms.size(); r++)
+	{
+		for (engine = TABLE; engine <= JIT; engine++)
+		{
+			Measurement result;
+
+			if (!Best(repeat, result, [&](Measurement& measurement)
+			{
+				return RunRom(roms[r], (Engine)engine, frames, instructions_per_frame, measurement);
+			}))
+			{
+				/* The JIT is optional on hosts that cannot run it; a ROM that fails to load is an error */
+				if (engine != JIT)
+				{
+					std::cerr << "Error: Unable to load " << roms[r] << std::endl;
+					failed = true;
+				}
+
+				continue;
+			}
+
+			*out << (first ? "" : ",\n") << "    { \"rom\": \"" << CHIP8::JsonEscape(roms[r]) << "\""
+				<< ", \"engine\": \"" << ENGINE_NAMES[engine] << "\"";
+			WriteMeasurement(*out, result);
+			*out << " }";
+
+			first = false;
+		}
+	}
+
+	*out << "\n  ]\n";
+	*out << "}\n";
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "batch.h"
+#include "chip8.h"
+
+/*
+ * Compares the table dispatcher against the predecoded instruction cache on long-running ROMs.
+ * Each ROM is run for the same number of cycles with both engines from the same random seed;
+ * the final framebuffers must match. Before that, two built-in programs must leave the table, cached and JIT
+ * engines in the same state: a self-modifying one whose FX55 wraps past the end of memory into code they have
+ * already decoded, and one that runs 5XY2/5XY3, which skip like 5XY0 on a 4 KB machine.
+ *
+ * Usage: chip8-bench-decode [--cycles N] [--repeat N] [ROM...]
+ */
+
+static const char* DEFAULT_ROMS[] =
+{
+	"chip8-roms/programs/Life [GV Samways, 1980].ch8",
+	"chip8-roms/demos/Sierpinski [Sergey Naydenov, 2010].ch8",
+	"chip8-roms/demos/Maze [David Winter, 199x].ch8",
+	"chip8-roms/programs/SQRT Test [Sergey Naydenov, 2010].ch8"
+};
+
+/*
+ * Writes a routine to 0x000 and runs it, then rewrites it with an FX55 from 0xFFC that wraps around to 0x000 and
+ * runs it again. An engine that misses the wrapped part keeps running the old routine, which jumps back and loops.
+ */
+static const uint8_t WRAPPED_WRITE_ROM[] =
+{
+	0x60, 0x6A, 0x61, 0x01, 0x62, 0x12, 0x63, 0x0E,		/* V0-V3 = 6A01 120E: VA = 1, jump to 0x20E */
+	0xA0, 0x00, 0xF3, 0x55, 0x10, 0x00,					/* store at 0x000 and run it */
+	0x64, 0x6A, 0x65, 0x02, 0x66, 0x12, 0x67, 0x1E,		/* V4-V7 = 6A02 121E: VA = 2, jump to 0x21E */
+	0xAF, 0xFC, 0xF7, 0x55, 0x10, 0x00,					/* store V0-V7 at 0xFFC, wrapping to 0x000, and run it */
+	0x12, 0x1E											/* done */
+};
+
+/* V0 = V1, so both skips are taken and V2 and V3 stay zero */
+static const uint8_t XO_SKIP_ROM[] =
+{
+	0x60, 0x01, 0x61, 0x01,								/* V0 = V1 = 1 */
+	0x50, 0x12, 0x62, 0x05,								/* 5XY2 skips V2 = 5 */
+	0x50, 0x13, 0x63, 0x07,								/* 5XY3 skips V3 = 7 */
+	0x12, 0x0C											/* done */
+};
+
+/* Run a program on the table, cached and JIT engines; true if all three end in the same state */
+static bool CheckEngines(const uint8_t* rom, size_t size)
+{
+	std::vector<uint8_t> states[3];
+	unsigned int engine;
+
+	for (engine = 0; engine < 3; engine++)
+	{
+		std::unique_ptr<CHIP8::Chip8Processor> chip8(new CHIP8::Chip8Processor());
+
+		chip8->SetDecodeCache(engine == 1);
+
+		if (engine == 2)
+			chip8->SetJit(true);
+
+		chip8->LoadROM(rom, size);
+		chip8->RunCycles(1000);
+
+		states[engine].resize(chip8->GetStateSize());
+		chip8->SaveState(states[engine].data(), states[engine].size());
+	}
+
+	return states[0] == states[1] && states[0] == states[2];
+}
+
+struct RunResult
+{
+	double seconds;
+	uint64_t display_hash;
+};
+
+static bool RunRom(const std::string& rom, uint64_t cycles, bool cached, RunResult& result)
+{
+	std::unique_ptr<CHIP8::Chip8Processor> chip8(new CHIP8::Chip8Processor());
+	uint64_t i;
+
+	chip8->SetDecodeCache(cached);
+
+	if (!chip8->LoadROM(rom.c_str()))
+		return false;
+
+	/* Give both engines the same CXNN sequence */
+	chip8->SetRandomSeed(1);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (i = 0; i < cycles; i++)
+		chip8->Cycle();
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.display_hash = CHIP8::HashDisplayState(*chip8);
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> roms;
+	uint64_t cycles = 20000000;
+	unsigned int repeat = 3;
+	bool mismatch = false;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+			cycles = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+			repeat = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+			roms.push_back(argv[i]);
+	}
+
+	if (roms.empty())
+		roms.assign(std::begin(DEFAULT_ROMS), std::end(DEFAULT_ROMS));
+
+	if (repeat == 0)
+		repeat = 1;
+
+	if (!CheckEngines(WRAPPED_WRITE_ROM, sizeof(WRAPPED_WRITE_ROM)))
+	{
+		std::cerr << "Error: The cached or JIT engine missed a write that wrapped around memory" << std::endl;
+		mismatch = true;
+	}
+
+	if (!CheckEngines(XO_SKIP_ROM, sizeof(XO_SKIP_ROM)))
+	{
+		std::cerr << "Error: The cached or JIT engine runs 5XY2/5XY3 differently from the table dispatcher" << std::endl;
+		mismatch = true;
+	}
+
+	std::cout << "rom,cycles,table_ips,cached_ips,speedup,identical" << std::endl;
+
+	for (const std::string& rom : roms)
+	{
+		RunResult table = { }, cached = { }, run;
+		unsigned int r;
+		bool loaded = true;
+
+		table.seconds = cached.seconds = 1e30;
+
+		/* Keep the best of several runs to filter out scheduling noise */
+		for (r = 0; r < repeat && loaded; r++)
+		{
+			loaded = RunRom(rom, cycles, false, run);
+
+			if (loaded && run.seconds < table.seconds)
+				table = run;
+
+			loaded = loaded && RunRom(rom, cycles, true, run);
+
+			if (loaded && run.seconds < cached.seconds)
+				cached = run;
+		}
+
+		if (!loaded)
+		{
+			std::cerr << "Error: Unable to load " << rom << std::endl;
+			continue;
+		}
+
+		bool identical = table.display_hash == cached.display_hash;
+		mismatch = mismatch || !identical;
+
+		std::cout << "\"" << rom << "\"," << cycles << ","
+			<< cycles / table.seconds << ","
+			<< cycles / cached.seconds << ","
+			<< table.seconds / cached.seconds << ","
+			<< (identical ? "yes" : "no") << std::endl;
+	}
+
+	return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
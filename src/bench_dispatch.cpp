@@ -0,0 +1,114 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "chip8.h"
+
+/*
+ * Per-opcode-class dispatch microbenchmark. Each class is a synthetic program that repeats a few opcodes
+ * of that class and jumps back to the start, run through the table dispatcher, the decode cache and the
+ * threaded dispatch loop. Prints instructions/sec per class and engine as CSV.
+ *
+ * Usage: chip8-bench-dispatch [--cycles N]
+ */
+
+struct OpcodeClass
+{
+	const char* name;
+	std::vector<uint16_t> body;
+};
+
+enum Engine
+{
+	TABLE,
+	DECODE_CACHE,
+	THREADED
+};
+
+static const char* ENGINE_NAMES[] = { "table", "cached", "threaded" };
+
+/* Repeat body to fill the program, then jump back to 0x200 */
+static std::vector<uint8_t> BuildProgram(const std::vector<uint16_t>& body)
+{
+	const unsigned int INSTRUCTIONS = 256;
+	std::vector<uint8_t> program;
+	unsigned int i;
+
+	for (i = 0; i < INSTRUCTIONS; i++)
+	{
+		uint16_t opcode = body[i % body.size()];
+		program.push_back(opcode >> 8U);
+		program.push_back(opcode & 0xFFU);
+	}
+
+	program.push_back(0x12);
+	program.push_back(0x00);
+
+	return program;
+}
+
+static double Run(const std::vector<uint8_t>& program, Engine engine, uint64_t cycles)
+{
+	std::unique_ptr<CHIP8::Chip8Processor> chip8(new CHIP8::Chip8Processor());
+	uint64_t i;
+
+	chip8->SetDecodeCache(engine == DECODE_CACHE);
+	chip8->LoadROM(program.data(), program.size());
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	if (engine == THREADED)
+	{
+		chip8->RunThreaded(cycles);
+	}
+	else
+	{
+		for (i = 0; i < cycles; i++)
+			chip8->Cycle();
+	}
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t cycles = 20000000;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+			cycles = strtoull(argv[++i], NULL, 10);
+	}
+
+	const OpcodeClass classes[] =
+	{
+		{ "load (6XNN/7XNN)", { 0x6005, 0x7101, 0x6A10, 0x7B02 } },
+		{ "alu (8XY*)", { 0x8010, 0x8121, 0x8232, 0x8343, 0x8454, 0x8565, 0x8676, 0x878E } },
+		{ "skip (3XNN/4XNN/5XY0/9XY0)", { 0x3001, 0x4000, 0x5120, 0x9000 } },
+		{ "index (ANNN/FX1E/FX29)", { 0xA300, 0xF01E, 0xF129 } },
+		{ "memory (FX33/FX55/FX65)", { 0xA400, 0xF033, 0xFF55, 0xFF65 } },
+		{ "draw (DXYN)", { 0xA050, 0xD015, 0xD235 } },
+		{ "random (CXNN)", { 0xC0FF, 0xC10F } },
+		{ "keypad (EX9E/EXA1)", { 0xE09E, 0xE0A1 } }
+	};
+
+	std::cout << "class,engine,ips" << std::endl;
+
+	for (const OpcodeClass& opcode_class : classes)
+	{
+		std::vector<uint8_t> program = BuildProgram(opcode_class.body);
+		unsigned int engine;
+
+		for (engine = TABLE; engine <= THREADED; engine++)
+		{
+			double seconds = Run(program, (Engine)engine, cycles);
+
+			std::cout << "\"" << opcode_class.name << "\"," << ENGINE_NAMES[engine] << "," << cycles / seconds << std::endl;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
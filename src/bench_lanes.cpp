@@ -0,0 +1,183 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "chip8.h"
+#include "lanes.h"
+
+/*
+ * Machine-steps/sec of the lockstep lane engine against the same number of scalar Chip8Processor instances,
+ * for a range of lane counts. Lane i and scalar machine i share RNG seed i + 1, and their final states must be
+ * byte-identical. The built-in ALU loop keeps every lane in lockstep; ROMs that branch on CXNN diverge.
+ *
+ * Usage: chip8-bench-lanes [--cycles N] [--lanes N,N,...] [ROM...]
+ */
+
+struct Program
+{
+	std::string name;
+	std::vector<uint8_t> data;
+};
+
+/* 8XY* and 7XNN on every register, then jump back to the start */
+static Program AluProgram()
+{
+	static const uint16_t body[] =
+	{
+		0x7001, 0x7103, 0x8014, 0x8125, 0x8236, 0x8317, 0x841E, 0x8501,
+		0x8612, 0x8723, 0x8874, 0x8985, 0x8A90, 0x7B07, 0x8CB4, 0x8FC5
+	};
+	Program program;
+
+	program.name = "alu loop";
+
+	for (uint16_t opcode : body)
+	{
+		program.data.push_back(opcode >> 8U);
+		program.data.push_back(opcode & 0xFFU);
+	}
+
+	program.data.push_back(0x12);
+	program.data.push_back(0x00);
+
+	return program;
+}
+
+static bool ReadProgram(const char* path, Program& program)
+{
+	FILE* file = fopen(path, "rb");
+	uint8_t buffer[4096];
+	size_t size;
+
+	if (!file)
+		return false;
+
+	size = fread(buffer, 1, sizeof(buffer), file);
+	fclose(file);
+
+	program.name = path;
+	program.data.assign(buffer, buffer + size);
+
+	return size > 0;
+}
+
+static void ParseLaneCounts(const char* list, std::vector<unsigned int>& counts)
+{
+	counts.clear();
+
+	while (*list)
+	{
+		char* end;
+		unsigned long count = strtoul(list, &end, 10);
+
+		if (end == list)
+			break;
+
+		if (count)
+			counts.push_back((unsigned int)count);
+
+		list = *end == ',' ? end + 1 : end;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<unsigned int> lane_counts = { 1, 4, 16, 64, 256, 1024 };
+	std::vector<Program> programs;
+	uint64_t cycles = 100000;
+	bool mismatch = false;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+		{
+			cycles = strtoull(argv[++i], NULL, 10);
+		}
+		else if (!strcmp(argv[i], "--lanes") && i + 1 < argc)
+		{
+			ParseLaneCounts(argv[++i], lane_counts);
+		}
+		else
+		{
+			Program program;
+
+			if (ReadProgram(argv[i], program))
+				programs.push_back(program);
+			else
+				std::cerr << "Error: Unable to load " << argv[i] << std::endl;
+		}
+	}
+
+	if (programs.empty())
+		programs.push_back(AluProgram());
+
+	std::cout << "program,isa,lanes,cycles,lane_steps_per_sec,scalar_steps_per_sec,speedup,identical" << std::endl;
+
+	for (const Program& program : programs)
+	{
+		for (unsigned int lanes : lane_counts)
+		{
+			std::unique_ptr<CHIP8::Chip8Lanes> engine(new CHIP8::Chip8Lanes(lanes));
+			std::vector<std::unique_ptr<CHIP8::Chip8Processor>> scalar;
+			std::vector<uint8_t> lane_state(CHIP8::Chip8Processor::STATE_SIZE), scalar_state(CHIP8::Chip8Processor::STATE_SIZE);
+			std::unique_ptr<CHIP8::Chip8Processor> exported(new CHIP8::Chip8Processor());
+			unsigned int lane;
+			uint64_t cycle;
+
+			if (!engine->LoadROM(program.data.data(), program.data.size()))
+			{
+				std::cerr << "Error: " << program.name << " does not fit in memory" << std::endl;
+				break;
+			}
+
+			for (lane = 0; lane < lanes; lane++)
+			{
+				scalar.emplace_back(new CHIP8::Chip8Processor());
+				scalar[lane]->LoadROM(program.data.data(), program.data.size());
+				scalar[lane]->SetRandomSeed(lane + 1);
+			}
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			engine->RunCycles(cycles);
+
+			double lane_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			start = std::chrono::steady_clock::now();
+
+			for (lane = 0; lane < lanes; lane++)
+			{
+				for (cycle = 0; cycle < cycles; cycle++)
+					scalar[lane]->Cycle();
+			}
+
+			double scalar_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			bool identical = true;
+
+			for (lane = 0; lane < lanes; lane++)
+			{
+				engine->StoreLane(lane, *exported);
+				exported->SaveState(lane_state.data(), lane_state.size());
+				scalar[lane]->SaveState(scalar_state.data(), scalar_state.size());
+				identical = identical && lane_state == scalar_state;
+			}
+
+			mismatch = mismatch || !identical;
+
+			double steps = (double)cycles * lanes;
+
+			std::cout << "\"" << program.name << "\"," << CHIP8::Chip8Lanes::GetVectorIsa() << "," << lanes << "," << cycles << ","
+				<< steps / lane_seconds << ","
+				<< steps / scalar_seconds << ","
+				<< scalar_seconds / lane_seconds << ","
+				<< (identical ? "yes" : "no") << std::endl;
+		}
+	}
+
+	return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "chip8.h"
+#include "postprocess.h"
+
+/*
+ * Times Chip8PostProcess on a 64x32 and a 128x64 framebuffer whose bits change every frame, for both
+ * filters with and without persistence and scanlines, fitted to a WIDTH x HEIGHT window (default 1920x1080).
+ * Prints mean and best microseconds per frame as CSV.
+ *
+ * Usage: chip8-bench-postprocess [--width N] [--height N] [--frames N]
+ */
+
+static const uint32_t PALETTE[4] = { 0x00000000, 0xFFFFFFFF, 0xFF6600FF, 0x662200FF };
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: chip8-bench-postprocess [--width N] [--height N] [--frames N]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int width = 1920;
+	unsigned int height = 1080;
+	unsigned int frames = 600;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--width") && i + 1 < argc)
+			width = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--height") && i + 1 < argc)
+			height = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+			frames = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!width || !height || !frames)
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	static const unsigned int SOURCES[][2] = { { 64, 32 }, { 128, 64 } };
+	std::vector<uint64_t> plane(CHIP8::Chip8Processor::MAX_DISPLAY_WORDS);
+	unsigned int source, mode, frame;
+	uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+	std::cout << "source,filter,phosphor,scanlines,output,mean_us,best_us" << std::endl;
+
+	for (source = 0; source < sizeof(SOURCES) / sizeof(SOURCES[0]); source++)
+	{
+		for (mode = 0; mode < 8; mode++)
+		{
+			CHIP8::PostProcessSettings settings = { mode & 1 ? 154U : 0U, mode & 2 ? CHIP8::SCALE_SHARP_BILINEAR : CHIP8::SCALE_INTEGER, (mode & 4) != 0 };
+			CHIP8::Chip8PostProcess post(settings);
+			double total = 0.0, best = 0.0;
+
+			post.SetTargetSize(width, height);
+
+			for (frame = 0; frame < frames; frame++)
+			{
+				/* A few sprites' worth of changed bits per frame, like a game redrawing */
+				for (uint64_t& word : plane)
+				{
+					state ^= state << 13;
+					state ^= state >> 7;
+					state ^= state << 17;
+					word ^= state & (state >> 3) & (state >> 5);
+				}
+
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+				post.Process(plane.data(), NULL, SOURCES[source][0], SOURCES[source][1], PALETTE);
+
+				double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+				total += us;
+
+				if (frame == 0 || us < best)
+					best = us;
+			}
+
+			std::cout << SOURCES[source][0] << "x" << SOURCES[source][1] << "," << (settings.filter == CHIP8::SCALE_INTEGER ? "integer" : "sharp")
+				<< "," << (settings.phosphor_decay ? 1 : 0) << "," << (settings.scanlines ? 1 : 0) << ","
+				<< post.GetOutputWidth() << "x" << post.GetOutputHeight() << "," << total / frames << "," << best << std::endl;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
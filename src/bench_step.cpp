@@ -0,0 +1,243 @@
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "chip8.h"
+#include "rombundle.h"
+#include "scheduler.h"
+#include "stepclient.h"
+#include "stepserver.h"
+
+/*
+ * Round-trip benchmark of the shared-memory step server. Forks a Chip8StepServer with N instances of ROM, then
+ * from the parent process submits one STEP_RUN of F frames with random keys to each of 1, 2, 4, ... N instances
+ * and waits for them, over and over for S seconds per row. Prints round trips, microseconds per round trip and
+ * steps and frames per second as CSV. Finally it checks that an instance driven through the server ends in the
+ * same framebuffer and registers as a local Chip8Processor given the same keys, including after a reset.
+ *
+ * Usage: chip8-bench-step [--instances N] [--threads N] [--frames F] [--seconds S] ROM
+ */
+
+static const uint32_t SEED = 1;
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void OnSignal(int)
+{
+	interrupted = 1;
+}
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: chip8-bench-step [--instances N] [--threads N] [--frames F] [--seconds S] ROM" << std::endl;
+}
+
+static uint16_t NextKeys(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+
+	/* Mostly one key or none, like an agent's action */
+	return state & 0x100 ? (uint16_t)(1U << (state & 15)) : 0;
+}
+
+/* Drive instance 0 through the server and a local processor with the same keys; true if they agree */
+static bool CheckAgainstLocal(CHIP8::Chip8StepClient& client, const std::vector<uint8_t>& rom, uint32_t frames)
+{
+	std::unique_ptr<CHIP8::Chip8Processor> chip8;
+	unsigned int instructions_per_second = client.GetHeader().instructions_per_second;
+	uint64_t frame = 0;
+	uint32_t state = 0x12345678U;
+	unsigned int step, f;
+
+	/* Run twice from the boot snapshot, so the second pass also checks that a reset really starts over */
+	for (step = 0; step < 400; step++)
+	{
+		uint16_t keys = NextKeys(state);
+
+		if (step % 200 == 0)
+		{
+			chip8.reset(new CHIP8::Chip8Processor());
+			chip8->LoadROM({ rom.data(), rom.size() });
+			chip8->SetRandomSeed(SEED);
+			frame = 0;
+			client.Reset(0);
+		}
+
+		chip8->SetKeypadMask(keys);
+
+		for (f = 0; f < frames; f++)
+			chip8->RunFrame(CHIP8::Chip8Scheduler::InstructionsForFrame(instructions_per_second, frame++));
+
+		client.Step(0, keys, frames);
+	}
+
+	if (!client.Wait())
+		return false;
+
+	const CHIP8::StepObservation& observation = client.GetObservation(0);
+	const uint64_t* plane1 = chip8->GetDisplayPlane(1);
+	size_t words = chip8->GetDisplayWidth() / 64 * chip8->GetDisplayHeight();
+	CHIP8::Chip8Registers registers = { };
+
+	chip8->GetRegisters(registers);
+
+	return observation.frame == frame && observation.width == chip8->GetDisplayWidth() && observation.height == chip8->GetDisplayHeight()
+		&& !memcmp(observation.planes, chip8->GetDisplayState(), words * sizeof(uint64_t))
+		&& (!plane1 || !memcmp(&observation.planes[CHIP8::Chip8Processor::MAX_DISPLAY_WORDS], plane1, words * sizeof(uint64_t)))
+		&& !memcmp(&observation.registers, &registers, sizeof(registers));
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t instances = 64;
+	unsigned int threads = 1;
+	uint32_t frames = 1;
+	double seconds = 1.0;
+	const char* romFile = NULL;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--instances") && i + 1 < argc)
+			instances = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+			threads = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+			frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--seconds") && i + 1 < argc)
+			seconds = strtod(argv[++i], NULL);
+		else if (argv[i][0] == '-' || romFile)
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+		else
+			romFile = argv[i];
+	}
+
+	std::vector<uint8_t> rom;
+
+	if (!romFile || !instances || !frames || seconds <= 0.0)
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	if (!CHIP8::ReadRomFile(romFile, rom))
+		return EXIT_FAILURE;
+
+	std::string name = "/chip8-bench-step-" + std::to_string((long)getpid());
+	pid_t parent = getpid();
+	pid_t child = fork();
+
+	if (child < 0)
+	{
+		std::cerr << "Error: Unable to start the server process" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (child == 0)
+	{
+		CHIP8::Chip8StepServer server;
+
+		std::signal(SIGTERM, OnSignal);
+
+		if (!server.Start(name.c_str(), { rom.data(), rom.size() }, instances, threads,
+			CHIP8::Chip8Scheduler::DEFAULT_INSTRUCTIONS_PER_SECOND, SEED, CHIP8::ENGINE_TABLE))
+			_exit(EXIT_FAILURE);
+
+		/* Also stop if the benchmark dies without signalling */
+		while (!interrupted && getppid() == parent)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+		server.Stop();
+		_exit(EXIT_SUCCESS);
+	}
+
+	CHIP8::Chip8StepClient client;
+	int attempt;
+
+	for (attempt = 0; attempt < 500 && !client.Open(name.c_str()); attempt++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	if (!client.GetInstanceCount())
+	{
+		std::cerr << "Error: The server process did not come up" << std::endl;
+		kill(child, SIGTERM);
+		waitpid(child, NULL, 0);
+		return EXIT_FAILURE;
+	}
+
+	std::vector<uint32_t> batches;
+	uint32_t state = 0x9E3779B9U;
+	uint32_t batch;
+	size_t row;
+	bool ok = true;
+
+	/* 1, 2, 4, ... and the full count */
+	for (batch = 1; batch < instances; batch *= 2)
+		batches.push_back(batch);
+
+	batches.push_back(instances);
+
+	std::cout << "instances,frames_per_step,round_trips,round_trip_us,steps_per_second,frames_per_second" << std::endl;
+
+	for (row = 0; row < batches.size() && ok; row++)
+	{
+		typedef std::chrono::steady_clock Clock;
+		Clock::time_point start = Clock::now();
+		double elapsed = 0.0;
+		uint64_t round_trips = 0;
+		uint32_t instance;
+
+		batch = batches[row];
+
+		while (elapsed < seconds)
+		{
+			for (instance = 0; instance < batch; instance++)
+				client.Step(instance, NextKeys(state), frames);
+
+			if (!client.Wait())
+			{
+				std::cerr << "Error: The server process stopped" << std::endl;
+				ok = false;
+				break;
+			}
+
+			round_trips++;
+
+			/* Reading the clock every round trip would show up in the one-instance row */
+			if (round_trips % 64 == 0)
+				elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		}
+
+		if (!ok)
+			break;
+
+		elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+		std::cout << batch << "," << frames << "," << round_trips << "," << elapsed * 1e6 / round_trips << ","
+			<< round_trips * batch / elapsed << "," << round_trips * batch * frames / elapsed << std::endl;
+	}
+
+	if (ok && !CheckAgainstLocal(client, rom, frames))
+	{
+		std::cerr << "Error: The served instance does not match a local processor" << std::endl;
+		ok = false;
+	}
+
+	client.Close();
+	kill(child, SIGTERM);
+	waitpid(child, NULL, 0);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
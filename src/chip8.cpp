@@ -1,94 +1,199 @@
 #include "chip8.h"
+#include "jit.h"
+#include "profiler.h"
 #include <cstdint>
+#include <cstring>
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
 #include <chrono>
-#include <time.h>
+
+/* Profiler hooks vanish entirely unless built with CHIP8_PROFILE=1 */
+#if CHIP8_PROFILE
+#define PROFILING (profiler != NULL)
+#define PROFILE(hook) do { if (profiler) profiler->hook; } while (0)
+#else
+#define PROFILING false
+#define PROFILE(hook) do { } while (0)
+#endif
 
 namespace CHIP8
 {
 	#pragma region Chip8Processor
 
+	const uint8_t Chip8Processor::fontset[FONTSET_SIZE] =
+	{
+		0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+		0x20, 0x60, 0x20, 0x20, 0x70, // 1
+		0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+		0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+		0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+		0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+		0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+		0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+		0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+		0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+		0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+		0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+		0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+		0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+		0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+		0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+	};
+
+	/* 8x10 digits for FX30 */
+	const uint8_t Chip8Processor::big_fontset[BIG_FONTSET_SIZE] =
+	{
+		0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+		0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+		0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+		0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+		0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+		0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+		0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+		0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+		0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+		0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+		0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+		0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+	};
+
+	/* Dispatch tables indexed by the opcode's high nibble and, for groups 0, 8, E and F, its low bits */
+	const Chip8Processor::Opcode Chip8Processor::table[0xF + 1] =
+	{
+		&Chip8Processor::Table0, &Chip8Processor::opcode_1NNN, &Chip8Processor::opcode_2NNN, &Chip8Processor::opcode_3XNN,
+		&Chip8Processor::opcode_4XNN, &Chip8Processor::opcode_5XY0, &Chip8Processor::opcode_6XNN, &Chip8Processor::opcode_7XNN,
+		&Chip8Processor::Table8, &Chip8Processor::opcode_9XY0, &Chip8Processor::opcode_ANNN, &Chip8Processor::opcode_BNNN,
+		&Chip8Processor::opcode_CXNN, &Chip8Processor::opcode_DXYN, &Chip8Processor::TableE, &Chip8Processor::TableF
+	};
+
+	const Chip8Processor::Opcode Chip8Processor::table0[0xF + 1] =
+	{
+		&Chip8Processor::opcode_00E0, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_00EE, &Chip8Processor::opcode_NULL
+	};
+
+	/* SUPER-CHIP 00FB to 00FF, indexed by the low nibble. 00F0 keeps clearing the screen like the rest of 0NN0. */
+	const Chip8Processor::Opcode Chip8Processor::table00F[0xF + 1] =
+	{
+		&Chip8Processor::opcode_00E0, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_00FB,
+		&Chip8Processor::opcode_00FC, &Chip8Processor::opcode_00FD, &Chip8Processor::opcode_00FE, &Chip8Processor::opcode_00FF
+	};
+
+	const Chip8Processor::Opcode Chip8Processor::table8[0xF + 1] =
+	{
+		&Chip8Processor::opcode_8XY0, &Chip8Processor::opcode_8XY1, &Chip8Processor::opcode_8XY2, &Chip8Processor::opcode_8XY3,
+		&Chip8Processor::opcode_8XY4, &Chip8Processor::opcode_8XY5, &Chip8Processor::opcode_8XY6, &Chip8Processor::opcode_8XY7,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_8XYE, &Chip8Processor::opcode_NULL
+	};
+
+	const Chip8Processor::Opcode Chip8Processor::tableE[0xF + 1] =
+	{
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_EXA1, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_EX9E, &Chip8Processor::opcode_NULL
+	};
+
+	const Chip8Processor::Opcode Chip8Processor::tableF[0x85 + 1] =
+	{
+		&Chip8Processor::opcode_F000, &Chip8Processor::opcode_FN01, &Chip8Processor::opcode_F002, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_FX07,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_FX0A, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_FX15, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_FX18, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_FX1E, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_FX29, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_FX30, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_FX33,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_FX3A, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_FX55, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_FX65, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_FX75, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL, &Chip8Processor::opcode_NULL,
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_FX85
+	};
+
 	Chip8Processor::Chip8Processor()
 	{
 		unsigned int i;
 
+		memory = base_memory;
+		memory_mask = MEMORY_MASK;
+
 		/* Initialize the program counter */
 		pc = START_ADDRESS;
 
 		/* Load fonts into memory */
-		for (i = 0; i < FONTSET_START_ADDRESS; i++)
+		for (i = 0; i < FONTSET_SIZE; i++)
 		{
 			memory[FONTSET_START_ADDRESS + i] = fontset[i];
 		}
 
+		memcpy(&memory[BIG_FONTSET_START_ADDRESS], big_fontset, BIG_FONTSET_SIZE);
+
 		opcode = 0;
 		index = 0;
 		sp = 0;
+		sprite_wrap = false;
+		profiler = NULL;
+
+		memory_writes = 0;
+		idle_skip = true;
+		waiting_for_input = false;
+		idle_skipped = 0;
+
+		display_width = DISPLAY_WIDTH;
+		display_height = DISPLAY_HEIGHT;
+		plane_mask = 1;
+		planes_used = 1;
+
+		audio_pattern_loaded = false;
+		audio_pitch = DEFAULT_AUDIO_PITCH;
+
+		frame_generation = 0;
+		dirty_first = 0;
+		dirty_last = DISPLAY_HEIGHT - 1;
 
 		delay_timer = 0;
 		sound_timer = 0;
+		sound_playing = false;
+
+		/* A fixed seed keeps headless runs reproducible. Front ends that want varied play reseed. */
+		SetRandomSeed(DEFAULT_RANDOM_SEED);
+	}
+
+	Chip8Processor::~Chip8Processor()
+	{
 
-		/* Initialize random seed. Cast to unsigned int to suppress warnings.  */
-		srand( (unsigned int)time(NULL));
-
-		for (i = 0; i < 0xF + 1; i++)
-			table[i] = &Chip8Processor::opcode_NULL;
-
-		for (i = 0; i < 0xE + 1; i++)
-		{
-			table0[i] = &Chip8Processor::opcode_NULL;
-			table8[i] = &Chip8Processor::opcode_NULL;
-			tableE[i] = &Chip8Processor::opcode_NULL;
-		}
-
-		for (i = 0; i < 0x65 + 1; i++)
-			tableF[i] = &Chip8Processor::opcode_NULL;
-
-		// Set up function pointer table
-		table[0x0] = &Chip8Processor::Table0;
-		table[0x1] = &Chip8Processor::opcode_1NNN;
-		table[0x2] = &Chip8Processor::opcode_2NNN;
-		table[0x3] = &Chip8Processor::opcode_3XNN;
-		table[0x4] = &Chip8Processor::opcode_4XNN;
-		table[0x5] = &Chip8Processor::opcode_5XY0;
-		table[0x6] = &Chip8Processor::opcode_6XNN;
-		table[0x7] = &Chip8Processor::opcode_7XNN;
-		table[0x8] = &Chip8Processor::Table8;
-		table[0x9] = &Chip8Processor::opcode_9XY0;
-		table[0xA] = &Chip8Processor::opcode_ANNN;
-		table[0xB] = &Chip8Processor::opcode_BNNN;
-		table[0xC] = &Chip8Processor::opcode_CXNN;
-		table[0xD] = &Chip8Processor::opcode_DXYN;
-		table[0xE] = &Chip8Processor::TableE;
-		table[0xF] = &Chip8Processor::TableF;
-
-		table0[0x0] = &Chip8Processor::opcode_00E0;
-		table0[0xE] = &Chip8Processor::opcode_00EE;
-
-		table8[0x0] = &Chip8Processor::opcode_8XY0;
-		table8[0x1] = &Chip8Processor::opcode_8XY1;
-		table8[0x2] = &Chip8Processor::opcode_8XY2;
-		table8[0x3] = &Chip8Processor::opcode_8XY3;
-		table8[0x4] = &Chip8Processor::opcode_8XY4;
-		table8[0x5] = &Chip8Processor::opcode_8XY5;
-		table8[0x6] = &Chip8Processor::opcode_8XY6;
-		table8[0x7] = &Chip8Processor::opcode_8XY7;
-		table8[0xE] = &Chip8Processor::opcode_8XYE;
-
-		tableE[0x1] = &Chip8Processor::opcode_EXA1;
-		tableE[0xE] = &Chip8Processor::opcode_EX9E;
-
-		tableF[0x07] = &Chip8Processor::opcode_FX07;
-		tableF[0x0A] = &Chip8Processor::opcode_FX0A;
-		tableF[0x15] = &Chip8Processor::opcode_FX15;
-		tableF[0x18] = &Chip8Processor::opcode_FX18;
-		tableF[0x1E] = &Chip8Processor::opcode_FX1E;
-		tableF[0x29] = &Chip8Processor::opcode_FX29;
-		tableF[0x33] = &Chip8Processor::opcode_FX33;
-		tableF[0x55] = &Chip8Processor::opcode_FX55;
-		tableF[0x65] = &Chip8Processor::opcode_FX65;
 	}
 
 	#pragma endregion
@@ -97,50 +202,98 @@ namespace CHIP8
 
 	int Chip8Processor::LoadROM(const char *filename)
 	{
+		/* One byte more than fits, so an oversized file is caught without seeking to find its size */
+		std::unique_ptr<uint8_t[]> buffer(new uint8_t[XO_MEMORY_LOCATIONS - START_ADDRESS + 1]);
 		FILE *romFile;
-		long file_size;
-		char *buffer;
-		size_t elements_read;
-		int error;
-		long i;
-
-		try
-		{
-			if ((error = fopen_s(&romFile, filename, "rb")) != 0)
-				throw error;
-
-			// Get the size of the ROM file
-			fseek(romFile, 0, SEEK_END);
-			file_size = ftell(romFile);
-			rewind(romFile);
-
-			/* Dynamically allocate memory for buffer and read binary into buffer */
-			buffer = new char[file_size];
-			elements_read = fread(buffer, sizeof(uint8_t), file_size, romFile);
-			error = elements_read == file_size;
-			
-			if (!error)
-				throw error;
-
-			/* Copy buffer into main memory at the specified starting address */
-			for (i = 0; i < file_size; i++)
-			{
-				memory[START_ADDRESS + i] = buffer[i];
-			}
+		size_t size;
+
+		if ((romFile = fopen(filename, "rb")) == NULL)
+		{
+			std::cerr << "Unable to read ROM file " << filename << std::endl;
+			return 0;
+		}
+
+		size = fread(buffer.get(), sizeof(uint8_t), XO_MEMORY_LOCATIONS - START_ADDRESS + 1, romFile);
+		fclose(romFile);
+
+		if (!LoadROM(buffer.get(), size))
+		{
+			std::cerr << "ROM file " << filename << " does not fit in memory" << std::endl;
+			return 0;
+		}
+
+		return 1;
+	}
+
+	int Chip8Processor::LoadROM(ByteSpan rom)
+	{
+		return LoadROM(rom.data, rom.size);
+	}
+
+	int Chip8Processor::LoadROM(const uint8_t* data, size_t size)
+	{
+		if (size > XO_MEMORY_LOCATIONS - START_ADDRESS)
+			return 0;
+
+		/* Only XO-CHIP has room for more than 3.5 KB of program */
+		if (size > MEMORY_LOCATIONS - START_ADDRESS)
+			SetXoChip(true);
+
+		memcpy(&memory[START_ADDRESS], data, size);
+
+		/* The patch between 0x200 and 0x2C0 is 1802 machine code that enables 64x64 mode on a real VIP */
+		if (size > VIP_HIRES_START_ADDRESS - START_ADDRESS && data[0] == 0x12 && data[1] == 0x60)
+		{
+			SetResolution(DISPLAY_WIDTH, HIRES_HEIGHT);
+			pc = VIP_HIRES_START_ADDRESS;
+		}
+
+		/* Anything decoded or translated before the load is stale */
+		if (decode_cache)
+			SetDecodeCache(true);
+
+		if (jit)
+			jit->Flush();
+
+		waiting_for_input = false;
 
-			/* 
-			 * Initialize random seed so that we can generate random 8-bit unsigned integers.
-			 * Cast to unsigned int to suppress warnings.
-			*/
-			srand((unsigned int)time(NULL));
+		return 1;
+	}
+
+	void Chip8Processor::SetXoChip(bool enabled)
+	{
+		if (enabled == IsXoChip())
+			return;
 
+		if (enabled)
+		{
+			xo_memory.reset(new uint8_t[XO_MEMORY_LOCATIONS]());
+			memcpy(xo_memory.get(), base_memory, MEMORY_LOCATIONS);
+			memory = xo_memory.get();
+			memory_mask = XO_MEMORY_MASK;
 		}
-		catch (int error)
+		else
 		{
-			std::cerr << "Unable to read ROM file. Received error code: " << error << std::endl;
+			memcpy(base_memory, memory, MEMORY_LOCATIONS);
+			memory = base_memory;
+			memory_mask = MEMORY_MASK;
+			xo_memory.reset();
+
+			pc &= MEMORY_MASK;
+			index &= MEMORY_MASK;
 		}
 
-		return error;
+		/* Decodes and translations of the old memory are stale */
+		if (decode_cache)
+			SetDecodeCache(true);
+
+		if (jit)
+			jit->Flush();
+	}
+
+	bool Chip8Processor::IsXoChip() const
+	{
+		return memory != base_memory;
 	}
 
 	#pragma endregion
@@ -149,225 +302,728 @@ namespace CHIP8
 
 	void Chip8Processor::Cycle()
 	{
-		/* Fetch the next opcode. Since the opcode is two bytes long, the first byte is stored in memory[pc] and the second in memory[pc + 1] */
-		opcode = (memory[pc] << 8U) | memory[pc + 1];
+		PROFILE(OnExecute(pc, (memory[pc & memory_mask] << 8U) | memory[(pc + 1) & memory_mask]));
 
-		/* Increment the program counter to move onto the next instruction */
-		pc += 2;
+		if (decode_cache)
+		{
+			ExecuteCached();
+		}
+		else
+		{
+			/* Fetch the next opcode. Since the opcode is two bytes long, the first byte is stored in memory[pc] and the second in memory[pc + 1] */
+			opcode = (memory[pc & memory_mask] << 8U) | memory[(pc + 1) & memory_mask];
+
+			/* Increment the program counter to move onto the next instruction */
+			pc += 2;
+
+			/* Decode and execute the opcode */
+			Instruction in;
+			in.id = OP_UNDECODED;
+			in.x = (opcode & 0x0F00U) >> 8U;
+			in.y = (opcode & 0x00F0U) >> 4U;
+			in.n = opcode & 0x000FU;
+			in.nn = opcode & 0x00FFU;
+			in.nnn = opcode & 0x0FFFU;
 
-		/* Decode and execute the opcode */
-		((*this).*(table[(opcode & 0xF000U) >> 12U]))();
+			((*this).*(table[(opcode & 0xF000U) >> 12U]))(in);
+		}
+	}
+
+	void Chip8Processor::RunCycles(uint64_t count)
+	{
+		IdleState head;
+		uint64_t cycle = 0;
+
+		head.cycle = 0;
+		head.interval = 1;
+		head.countdown = 0;
+		head.stale = 0;
+		waiting_for_input = false;
+
+		while (count > 0)
+		{
+			uint16_t from = pc;
+			uint32_t executed = jit && !PROFILING ? jit->Run(count) : 0;
+
+			if (executed)
+			{
+				count -= executed;
+			}
+			else
+			{
+#if CHIP8_DISPATCH_THREADED
+				/* The threaded loop has no per-instruction way back to the JIT or the decode cache */
+				if (!jit && !decode_cache && !PROFILING)
+				{
+					RunThreaded(count);
+					return;
+				}
+#endif
+
+				Cycle();
+				count--;
+				executed = 1;
+			}
+
+			cycle += executed;
+
+			/* Only a backward branch can close a loop. The profiler has to see every instruction. */
+			if (pc <= from && idle_skip && !PROFILING)
+			{
+				/* Checking every branch would slow down loops that do real work, so busy loops are checked less often */
+				if (head.countdown)
+					head.countdown--;
+				else
+					count -= SkipIdleLoop(head, cycle, count);
+			}
+		}
+	}
+
+	uint64_t Chip8Processor::SkipIdleLoop(IdleState& head, uint64_t cycle, uint64_t remaining)
+	{
+		uint64_t period, skipped;
+
+		/* Wait for the captured loop head to come around again, unless control has clearly moved elsewhere */
+		if (head.cycle && head.pc != pc && ++head.stale < MAX_IDLE_CHECK_INTERVAL)
+			return 0;
+
+		/*
+		 * Within RunCycles the timers and keypad are fixed, so a loop that returns to the same registers, stack,
+		 * RNG state, framebuffer and memory will keep doing so until the frame ends.
+		 */
+		if (head.cycle && head.pc == pc && head.index == index && head.sp == sp && head.rng_state == rng_state
+			&& head.frame_generation == frame_generation && head.memory_writes == memory_writes
+			&& head.delay_timer == delay_timer && head.sound_timer == sound_timer
+			&& !memcmp(head.V, V, sizeof(V)) && !memcmp(head.stack, stack, sizeof(stack)))
+		{
+			period = cycle - head.cycle;
+
+			/* Skip whole periods only, so the leftover instructions stop at the same point in the loop */
+			skipped = remaining / period * period;
+			idle_skipped += skipped;
+			head.cycle = cycle + skipped;
+
+			/* With both timers stopped the next frame repeats this one, only a key press can end the loop */
+			if (!delay_timer && !sound_timer)
+				waiting_for_input = true;
+
+			return skipped;
+		}
+
+		/* Back at the same loop head in a different state: the loop is doing work */
+		if (head.cycle && head.pc == pc && head.interval < MAX_IDLE_CHECK_INTERVAL)
+			head.interval *= 2;
+
+		head.countdown = head.interval - 1;
+		head.stale = 0;
+
+		head.cycle = cycle;
+		head.rng_state = rng_state;
+		head.frame_generation = frame_generation;
+		head.memory_writes = memory_writes;
+		head.pc = pc;
+		head.index = index;
+		head.sp = sp;
+		head.delay_timer = delay_timer;
+		head.sound_timer = sound_timer;
+		memcpy(head.V, V, sizeof(V));
+		memcpy(head.stack, stack, sizeof(stack));
+
+		return 0;
+	}
+
+	void Chip8Processor::SetIdleSkip(bool enabled)
+	{
+		idle_skip = enabled;
+	}
+
+	uint64_t Chip8Processor::GetIdleSkipped() const
+	{
+		return idle_skipped;
+	}
+
+	bool Chip8Processor::IsWaitingForInput() const
+	{
+		return waiting_for_input;
+	}
+
+	void Chip8Processor::RunFrame(uint64_t instructions)
+	{
+		RunCycles(instructions);
+		TickTimers();
+	}
+
+	bool Chip8Processor::SetProfiler(Chip8Profiler* profiler)
+	{
+#if CHIP8_PROFILE
+		this->profiler = profiler;
+		return true;
+#else
+		return profiler == NULL;
+#endif
+	}
 
+	void Chip8Processor::TickTimers()
+	{
 		/* Decrement the delay timer and the sound timer if necessary */
 		if (delay_timer > 0)
 			delay_timer--;
 
+		sound_playing = sound_timer > 0;
+
 		if (sound_timer > 0)
 			sound_timer--;
 	}
 
+	bool Chip8Processor::IsSoundPlaying() const
+	{
+		return sound_playing;
+	}
+
+	bool Chip8Processor::SetJit(bool enabled)
+	{
+		if (!enabled)
+		{
+			jit.reset();
+			return true;
+		}
+
+		if (!jit)
+			jit.reset(new Chip8Jit(*this));
+
+		if (!jit->Available())
+		{
+			jit.reset();
+			return false;
+		}
+
+		return true;
+	}
+
+	#pragma endregion
+
+	#pragma region Threaded Dispatch
+
+	/* Opcode to OpcodeId for all 65536 opcodes, built once from Decode and shared by every processor */
+	static const uint8_t* OpcodeIds()
+	{
+		static const struct OpcodeIdTable
+		{
+			uint8_t ids[0x10000];
+
+			OpcodeIdTable()
+			{
+				unsigned int i;
+
+				for (i = 0; i < 0x10000; i++)
+					ids[i] = Chip8Processor::Decode((uint16_t)i).id;
+			}
+		} table;
+
+		return table.ids;
+	}
+
+#ifndef CHIP8_COMPUTED_GOTO
+#if defined(__GNUC__) || defined(__clang__)
+	#define CHIP8_COMPUTED_GOTO 1
+#else
+	#define CHIP8_COMPUTED_GOTO 0
+#endif
+#endif
+
+	/* Fetch the opcode at pc, advance pc and extract its operands into in */
+	#define CHIP8_FETCH() \
+		opcode = (memory[pc & memory_mask] << 8U) | memory[(pc + 1) & memory_mask]; \
+		pc += 2; \
+		in.id = ids[opcode]; \
+		in.x = (opcode & 0x0F00U) >> 8U; \
+		in.y = (opcode & 0x00F0U) >> 4U; \
+		in.n = opcode & 0x000FU; \
+		in.nn = opcode & 0x00FFU; \
+		in.nnn = opcode & 0x0FFFU
+
+#if CHIP8_COMPUTED_GOTO
+	/* Every handler jumps straight to the next one, giving each its own indirect branch to predict */
+	#define CHIP8_OPCODE(name) label_##name:
+	#define CHIP8_NEXT() \
+		if (--count == 0) \
+			return; \
+		CHIP8_FETCH(); \
+		goto *labels[in.id]
+#else
+	#define CHIP8_OPCODE(name) case OP_##name:
+	#define CHIP8_NEXT() break
+#endif
+
+	void Chip8Processor::RunThreaded(uint64_t count)
+	{
+		const uint8_t* ids = OpcodeIds();
+		Instruction in;
+
+		if (count == 0)
+			return;
+
+#if CHIP8_COMPUTED_GOTO
+		static const void* const labels[OP_COUNT] =
+		{
+			&&label_NULL, &&label_00E0, &&label_00EE, &&label_1NNN, &&label_2NNN, &&label_3XNN, &&label_4XNN,
+			&&label_5XY0, &&label_6XNN, &&label_7XNN, &&label_8XY0, &&label_8XY1, &&label_8XY2, &&label_8XY3,
+			&&label_8XY4, &&label_8XY5, &&label_8XY6, &&label_8XY7, &&label_8XYE, &&label_9XY0, &&label_ANNN,
+			&&label_BNNN, &&label_CXNN, &&label_DXYN, &&label_EX9E, &&label_EXA1, &&label_FX07, &&label_FX0A,
+			&&label_FX15, &&label_FX18, &&label_FX1E, &&label_FX29, &&label_FX33, &&label_FX55, &&label_FX65,
+			&&label_00CN, &&label_00FB, &&label_00FC, &&label_00FD, &&label_00FE, &&label_00FF, &&label_DXY0,
+			&&label_FX30, &&label_FX75, &&label_FX85, &&label_00DN, &&label_5XY2, &&label_5XY3, &&label_F000,
+			&&label_FN01, &&label_F002, &&label_FX3A
+		};
+
+		CHIP8_FETCH();
+		goto *labels[in.id];
+#else
+		for (;;)
+		{
+			CHIP8_FETCH();
+
+			switch (in.id)
+			{
+#endif
+				CHIP8_OPCODE(NULL) opcode_NULL(in); CHIP8_NEXT();
+				CHIP8_OPCODE(00E0) opcode_00E0(in); CHIP8_NEXT();
+				CHIP8_OPCODE(00EE) opcode_00EE(in); CHIP8_NEXT();
+				CHIP8_OPCODE(1NNN) opcode_1NNN(in); CHIP8_NEXT();
+				CHIP8_OPCODE(2NNN) opcode_2NNN(in); CHIP8_NEXT();
+				CHIP8_OPCODE(3XNN) opcode_3XNN(in); CHIP8_NEXT();
+				CHIP8_OPCODE(4XNN) opcode_4XNN(in); CHIP8_NEXT();
+				CHIP8_OPCODE(5XY0) opcode_5XY0(in); CHIP8_NEXT();
+				CHIP8_OPCODE(6XNN) opcode_6XNN(in); CHIP8_NEXT();
+				CHIP8_OPCODE(7XNN) opcode_7XNN(in); CHIP8_NEXT();
+				CHIP8_OPCODE(8XY0) opcode_8XY0(in); CHIP8_NEXT();
+				CHIP8_OPCODE(8XY1) opcode_8XY1(in); CHIP8_NEXT();
+				CHIP8_OPCODE(8XY2) opcode_8XY2(in); CHIP8_NEXT();
+				CHIP8_OPCODE(8XY3) opcode_8XY3(in); CHIP8_NEXT();
+				CHIP8_OPCODE(8XY4) opcode_8XY4(in); CHIP8_NEXT();
+				CHIP8_OPCODE(8XY5) opcode_8XY5(in); CHIP8_NEXT();
+				CHIP8_OPCODE(8XY6) opcode_8XY6(in); CHIP8_NEXT();
+				CHIP8_OPCODE(8XY7) opcode_8XY7(in); CHIP8_NEXT();
+				CHIP8_OPCODE(8XYE) opcode_8XYE(in); CHIP8_NEXT();
+				CHIP8_OPCODE(9XY0) opcode_9XY0(in); CHIP8_NEXT();
+				CHIP8_OPCODE(ANNN) opcode_ANNN(in); CHIP8_NEXT();
+				CHIP8_OPCODE(BNNN) opcode_BNNN(in); CHIP8_NEXT();
+				CHIP8_OPCODE(CXNN) opcode_CXNN(in); CHIP8_NEXT();
+				CHIP8_OPCODE(DXYN) opcode_DXYN(in); CHIP8_NEXT();
+				CHIP8_OPCODE(EX9E) opcode_EX9E(in); CHIP8_NEXT();
+				CHIP8_OPCODE(EXA1) opcode_EXA1(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FX07) opcode_FX07(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FX0A) opcode_FX0A(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FX15) opcode_FX15(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FX18) opcode_FX18(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FX1E) opcode_FX1E(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FX29) opcode_FX29(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FX33) opcode_FX33(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FX55) opcode_FX55(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FX65) opcode_FX65(in); CHIP8_NEXT();
+				CHIP8_OPCODE(00CN) opcode_00CN(in); CHIP8_NEXT();
+				CHIP8_OPCODE(00FB) opcode_00FB(in); CHIP8_NEXT();
+				CHIP8_OPCODE(00FC) opcode_00FC(in); CHIP8_NEXT();
+				CHIP8_OPCODE(00FD) opcode_00FD(in); CHIP8_NEXT();
+				CHIP8_OPCODE(00FE) opcode_00FE(in); CHIP8_NEXT();
+				CHIP8_OPCODE(00FF) opcode_00FF(in); CHIP8_NEXT();
+				CHIP8_OPCODE(DXY0) opcode_DXY0(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FX30) opcode_FX30(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FX75) opcode_FX75(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FX85) opcode_FX85(in); CHIP8_NEXT();
+				CHIP8_OPCODE(00DN) opcode_00DN(in); CHIP8_NEXT();
+				CHIP8_OPCODE(5XY2) opcode_5XY2(in); CHIP8_NEXT();
+				CHIP8_OPCODE(5XY3) opcode_5XY3(in); CHIP8_NEXT();
+				CHIP8_OPCODE(F000) opcode_F000(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FN01) opcode_FN01(in); CHIP8_NEXT();
+				CHIP8_OPCODE(F002) opcode_F002(in); CHIP8_NEXT();
+				CHIP8_OPCODE(FX3A) opcode_FX3A(in); CHIP8_NEXT();
+#if !CHIP8_COMPUTED_GOTO
+			}
+
+			if (--count == 0)
+				return;
+		}
+#endif
+	}
+
+	#undef CHIP8_FETCH
+	#undef CHIP8_OPCODE
+	#undef CHIP8_NEXT
+
+	#pragma endregion
+
+	#pragma region Decode Cache
+
+	const Chip8Processor::Opcode Chip8Processor::handlers[OP_COUNT] =
+	{
+		&Chip8Processor::opcode_NULL, &Chip8Processor::opcode_00E0, &Chip8Processor::opcode_00EE,
+		&Chip8Processor::opcode_1NNN, &Chip8Processor::opcode_2NNN, &Chip8Processor::opcode_3XNN,
+		&Chip8Processor::opcode_4XNN, &Chip8Processor::opcode_5XY0, &Chip8Processor::opcode_6XNN,
+		&Chip8Processor::opcode_7XNN, &Chip8Processor::opcode_8XY0, &Chip8Processor::opcode_8XY1,
+		&Chip8Processor::opcode_8XY2, &Chip8Processor::opcode_8XY3, &Chip8Processor::opcode_8XY4,
+		&Chip8Processor::opcode_8XY5, &Chip8Processor::opcode_8XY6, &Chip8Processor::opcode_8XY7,
+		&Chip8Processor::opcode_8XYE, &Chip8Processor::opcode_9XY0, &Chip8Processor::opcode_ANNN,
+		&Chip8Processor::opcode_BNNN, &Chip8Processor::opcode_CXNN, &Chip8Processor::opcode_DXYN,
+		&Chip8Processor::opcode_EX9E, &Chip8Processor::opcode_EXA1, &Chip8Processor::opcode_FX07,
+		&Chip8Processor::opcode_FX0A, &Chip8Processor::opcode_FX15, &Chip8Processor::opcode_FX18,
+		&Chip8Processor::opcode_FX1E, &Chip8Processor::opcode_FX29, &Chip8Processor::opcode_FX33,
+		&Chip8Processor::opcode_FX55, &Chip8Processor::opcode_FX65, &Chip8Processor::opcode_00CN,
+		&Chip8Processor::opcode_00FB, &Chip8Processor::opcode_00FC, &Chip8Processor::opcode_00FD,
+		&Chip8Processor::opcode_00FE, &Chip8Processor::opcode_00FF, &Chip8Processor::opcode_DXY0,
+		&Chip8Processor::opcode_FX30, &Chip8Processor::opcode_FX75, &Chip8Processor::opcode_FX85,
+		&Chip8Processor::opcode_00DN, &Chip8Processor::opcode_5XY2, &Chip8Processor::opcode_5XY3,
+		&Chip8Processor::opcode_F000, &Chip8Processor::opcode_FN01, &Chip8Processor::opcode_F002,
+		&Chip8Processor::opcode_FX3A
+	};
+
+	Instruction Chip8Processor::Decode(uint16_t opcode)
+	{
+		Instruction in;
+
+		in.id = OP_NULL;
+		in.x = (opcode & 0x0F00U) >> 8U;
+		in.y = (opcode & 0x00F0U) >> 4U;
+		in.n = opcode & 0x000FU;
+		in.nn = opcode & 0x00FFU;
+		in.nnn = opcode & 0x0FFFU;
+
+		/* Mirrors the layout of table, table0, table00F, table8, tableE and tableF */
+		switch ((opcode & 0xF000U) >> 12U)
+		{
+			case 0x0:
+			{
+				if ((opcode & 0x0FF0U) == 0x00C0U)
+					in.id = OP_00CN;
+				else if ((opcode & 0x0FF0U) == 0x00D0U)
+					in.id = OP_00DN;
+				else if (opcode >= 0x00FBU && opcode <= 0x00FFU)
+					in.id = OP_00FB + (opcode - 0x00FBU);
+				else if (in.n == 0x0)
+					in.id = OP_00E0;
+				else if (in.n == 0xE)
+					in.id = OP_00EE;
+			} break;
+
+			case 0x1: in.id = OP_1NNN; break;
+			case 0x2: in.id = OP_2NNN; break;
+			case 0x3: in.id = OP_3XNN; break;
+			case 0x4: in.id = OP_4XNN; break;
+			case 0x5: in.id = in.n == 0x2 ? OP_5XY2 : in.n == 0x3 ? OP_5XY3 : OP_5XY0; break;
+			case 0x6: in.id = OP_6XNN; break;
+			case 0x7: in.id = OP_7XNN; break;
+
+			case 0x8:
+			{
+				switch (in.n)
+				{
+					case 0x0: in.id = OP_8XY0; break;
+					case 0x1: in.id = OP_8XY1; break;
+					case 0x2: in.id = OP_8XY2; break;
+					case 0x3: in.id = OP_8XY3; break;
+					case 0x4: in.id = OP_8XY4; break;
+					case 0x5: in.id = OP_8XY5; break;
+					case 0x6: in.id = OP_8XY6; break;
+					case 0x7: in.id = OP_8XY7; break;
+					case 0xE: in.id = OP_8XYE; break;
+				}
+			} break;
+
+			case 0x9: in.id = OP_9XY0; break;
+			case 0xA: in.id = OP_ANNN; break;
+			case 0xB: in.id = OP_BNNN; break;
+			case 0xC: in.id = OP_CXNN; break;
+			case 0xD: in.id = in.n ? OP_DXYN : OP_DXY0; break;
+
+			case 0xE:
+			{
+				if (in.n == 0x1)
+					in.id = OP_EXA1;
+				else if (in.n == 0xE)
+					in.id = OP_EX9E;
+			} break;
+
+			case 0xF:
+			{
+				switch (in.nn)
+				{
+					case 0x00: in.id = OP_F000; break;
+					case 0x01: in.id = OP_FN01; break;
+					case 0x02: in.id = OP_F002; break;
+					case 0x07: in.id = OP_FX07; break;
+					case 0x0A: in.id = OP_FX0A; break;
+					case 0x15: in.id = OP_FX15; break;
+					case 0x18: in.id = OP_FX18; break;
+					case 0x1E: in.id = OP_FX1E; break;
+					case 0x29: in.id = OP_FX29; break;
+					case 0x30: in.id = OP_FX30; break;
+					case 0x33: in.id = OP_FX33; break;
+					case 0x3A: in.id = OP_FX3A; break;
+					case 0x55: in.id = OP_FX55; break;
+					case 0x65: in.id = OP_FX65; break;
+					case 0x75: in.id = OP_FX75; break;
+					case 0x85: in.id = OP_FX85; break;
+				}
+			} break;
+		}
+
+		return in;
+	}
+
+	void Chip8Processor::SetDecodeCache(bool enabled)
+	{
+		unsigned int i;
+
+		if (!enabled)
+		{
+			decode_cache.reset();
+			return;
+		}
+
+		if (!decode_cache)
+			decode_cache.reset(new Instruction[MEMORY_LOCATIONS]);
+
+		for (i = 0; i < MEMORY_LOCATIONS; i++)
+			decode_cache[i].id = OP_UNDECODED;
+	}
+
+	void Chip8Processor::ExecuteCached()
+	{
+		/* Only the first 4 KB are cached; past its last byte the opcode is decoded every time */
+		if (pc >= MEMORY_LOCATIONS - 1)
+		{
+			opcode = (memory[pc & memory_mask] << 8U) | memory[(pc + 1) & memory_mask];
+			pc += 2;
+
+			Instruction in = Decode(opcode);
+			((*this).*(handlers[in.id]))(in);
+			return;
+		}
+
+		Instruction& cached = decode_cache[pc];
+
+		if (cached.id == OP_UNDECODED)
+			cached = Decode((memory[pc] << 8U) | memory[pc + 1]);
+
+		pc += 2;
+
+		/* Copy first, the handler may invalidate the entry it is executing from */
+		Instruction in = cached;
+		((*this).*(handlers[in.id]))(in);
+	}
+
+	void Chip8Processor::MemoryWritten(uint16_t address, unsigned int length)
+	{
+		/* The stores wrap with memory_mask, so the part of a write past the end of memory lands at address 0 */
+		unsigned int first = address & memory_mask;
+		unsigned int wrapped = first + length > memory_mask + 1U ? first + length - (memory_mask + 1U) : 0U;
+
+		memory_writes++;
+
+		if (decode_cache)
+		{
+			InvalidateDecodeCache((uint16_t)first, length - wrapped);
+
+			if (wrapped)
+				InvalidateDecodeCache(0, wrapped);
+		}
+
+		if (jit)
+		{
+			jit->Invalidate((uint16_t)first, length - wrapped);
+
+			if (wrapped)
+				jit->Invalidate(0, wrapped);
+		}
+	}
+
+	void Chip8Processor::InvalidateDecodeCache(uint16_t address, unsigned int length)
+	{
+		/* An opcode starting one byte before the write also reads from the written range */
+		unsigned int first = address > 0 ? address - 1U : 0U;
+		unsigned int last = address + length;
+		unsigned int i;
+
+		if (last > MEMORY_LOCATIONS)
+			last = MEMORY_LOCATIONS;
+
+		for (i = first; i < last; i++)
+			decode_cache[i].id = OP_UNDECODED;
+	}
+
 	#pragma endregion
 
 	#pragma region opcodes
 
 	/* Null opcode */
-	void Chip8Processor::opcode_NULL()
+	void Chip8Processor::opcode_NULL(const Instruction&)
 	{
 
 	}
 
-	/* Clears the screen. */
-	void Chip8Processor::opcode_00E0()
+	/* Clears the screen, or under XO-CHIP the selected planes. */
+	void Chip8Processor::opcode_00E0(const Instruction&)
 	{
-		memset(video, 0, sizeof(video));
+		unsigned int plane;
+
+		for (plane = 0; plane < DISPLAY_PLANES; plane++)
+		{
+			if (plane_mask & (1U << plane))
+				memset(&video[plane * MAX_DISPLAY_WORDS], 0, MAX_DISPLAY_WORDS * sizeof(uint64_t));
+		}
+
+		MarkDirty(0, display_height - 1U);
 	}
 
 	/* Returns from a subroutine. */
-	void Chip8Processor::opcode_00EE()
+	void Chip8Processor::opcode_00EE(const Instruction&)
 	{
-		sp--;
+		sp = (sp - 1) & (STACK_LEVELS - 1);
 		pc = stack[sp];
+
+		PROFILE(OnReturn(sp));
 	}
 
 	/* Jumps to address at NNN. */
-	void Chip8Processor::opcode_1NNN()
+	void Chip8Processor::opcode_1NNN(const Instruction& in)
 	{
-		pc = opcode & 0x0FFFU;
+		pc = in.nnn;
 	}
 
 	/* Calls subroutine at NNN. */
-	void Chip8Processor::opcode_2NNN()
+	void Chip8Processor::opcode_2NNN(const Instruction& in)
 	{
 		stack[sp] = pc;
-		sp++;
-		pc = opcode & 0x0FFFU;
+		sp = (sp + 1) & (STACK_LEVELS - 1);
+		pc = in.nnn;
+
+		PROFILE(OnCall(sp, in.nnn));
 	}
 
 	/* Skips the next instruction if VX equals NN.*/
-	void Chip8Processor::opcode_3XNN()
+	void Chip8Processor::opcode_3XNN(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t nn = opcode & 0x00FFU;
-
-		if (V[x] == nn)
-			pc += 2;
+		if (V[in.x] == in.nn)
+			SkipNextInstruction();
 	}
 
 	/* Skips the next instruction if VX does not equal NN. */
-	void Chip8Processor::opcode_4XNN()
+	void Chip8Processor::opcode_4XNN(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t nn = opcode & 0x00FFU;
-
-		if (V[x] != nn)
-			pc += 2;
+		if (V[in.x] != in.nn)
+			SkipNextInstruction();
 	}
 
 	/* Skips the next instruction if VX equals VY. */
-	void Chip8Processor::opcode_5XY0()
+	void Chip8Processor::opcode_5XY0(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t y = (opcode & 0x00F0U) >> 4U;
-
-		if (V[x] == V[y])
-			pc += 2;
+		/* The table dispatcher sends XO-CHIP 5XY2 and 5XY3 here too */
+		if (in.n == 0x2)
+			opcode_5XY2(in);
+		else if (in.n == 0x3)
+			opcode_5XY3(in);
+		else if (V[in.x] == V[in.y])
+			SkipNextInstruction();
 	}
 
 	/* Sets VX to NN. */
-	void Chip8Processor::opcode_6XNN()
+	void Chip8Processor::opcode_6XNN(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t nn = opcode & 0x00FFU;
-
-		V[x] = nn;
+		V[in.x] = in.nn;
 	}
 
 	/* Adds NN to VX (Carry flag is not changed) */
-	void Chip8Processor::opcode_7XNN()
+	void Chip8Processor::opcode_7XNN(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t nn = opcode & 0x00FFU;
-
-		V[x] += nn;
+		V[in.x] += in.nn;
 	}
 
 	/* Sets VX to the value of VY */
-	void Chip8Processor::opcode_8XY0()
+	void Chip8Processor::opcode_8XY0(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t y = (opcode & 0x00F0U) >> 4U;
-
-		V[x] = V[y];
+		V[in.x] = V[in.y];
 	}
 
 	/* Sets VX to VX bitwise-or VY */
-	void Chip8Processor::opcode_8XY1()
+	void Chip8Processor::opcode_8XY1(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t y = (opcode & 0x00F0U) >> 4U;
-
-		V[x] |= V[y];
+		V[in.x] |= V[in.y];
 	}
 
 	/* Sets VX to VX bitwise-and VY */
-	void Chip8Processor::opcode_8XY2()
+	void Chip8Processor::opcode_8XY2(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t y = (opcode & 0x00F0U) >> 4U;
-
-		V[x] &= V[y];
+		V[in.x] &= V[in.y];
 	}
 
 	/* Sets VX to VX bitwise-xor VY */
-	void Chip8Processor::opcode_8XY3()
+	void Chip8Processor::opcode_8XY3(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t y = (opcode & 0x00F0U) >> 4U;
-
-		V[x] ^= V[y];
+		V[in.x] ^= V[in.y];
 	}
 
 	/* Adds VY to VX. VF is set to 1 when there's a carry, and to 0 when there is not */
-	void Chip8Processor::opcode_8XY4()
+	void Chip8Processor::opcode_8XY4(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t y = (opcode & 0x00F0U) >> 4U;
-
-		uint16_t sum = V[x] + V[y];
+		uint16_t sum = V[in.x] + V[in.y];
 		V[0xFU] = (sum > 255U) ? 1 : 0;
-		V[x] = sum & 0xFFU;
+		V[in.x] = sum & 0xFFU;
 	}
 
 	/* VY is subtracted from VX. VF is set to 0 when there's a borrow, and 1 when there is not. */
-	void Chip8Processor::opcode_8XY5()
+	void Chip8Processor::opcode_8XY5(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t y = (opcode & 0x00F0U) >> 4U;
-
-		V[0xFU] = (V[x] > V[y]) ? 1 : 0;
-		V[x] -= V[y];
+		V[0xFU] = (V[in.x] > V[in.y]) ? 1 : 0;
+		V[in.x] -= V[in.y];
 	}
 
 	/* Stores the least significant bit of VX in VF and then shifts VX to the right by 1. */
-	void Chip8Processor::opcode_8XY6()
+	void Chip8Processor::opcode_8XY6(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		V[0xFU] = V[x] & 0x1U;
-		V[x] >>= 1U;
+		V[0xFU] = V[in.x] & 0x1U;
+		V[in.x] >>= 1U;
 	}
 
 	/* Sets VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there is not. */
-	void Chip8Processor::opcode_8XY7()
+	void Chip8Processor::opcode_8XY7(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t y = (opcode & 0x00F0U) >> 4U;
+		uint16_t diff = V[in.y] - V[in.x];
 
-		uint16_t diff = V[y] - V[x];
-
-		V[0xFU] = (V[y] > V[x]) ? 1 : 0;
-		V[x] = diff & 0xFFU;
+		V[0xFU] = (V[in.y] > V[in.x]) ? 1 : 0;
+		V[in.x] = diff & 0xFFU;
 	}
 
 	/* Stores the most significant bit of VX in VF and then shifts VX to the left by 1. */
-	void Chip8Processor::opcode_8XYE()
+	void Chip8Processor::opcode_8XYE(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		V[0xFU] = (V[x] & 0x80U) >> 7U;
-		V[x] <<= 1;
+		V[0xFU] = (V[in.x] & 0x80U) >> 7U;
+		V[in.x] <<= 1;
 	}
 
 	/* Skips the next instruction if VX does not equal VY. */
-	void Chip8Processor::opcode_9XY0()
+	void Chip8Processor::opcode_9XY0(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t y = (opcode & 0x00F0U) >> 4U;
-
-		if (V[x] != V[y])
-			pc += 2;
+		if (V[in.x] != V[in.y])
+			SkipNextInstruction();
 	}
 
 	/* Sets the index register to the address NNN. */
-	void Chip8Processor::opcode_ANNN()
+	void Chip8Processor::opcode_ANNN(const Instruction& in)
 	{
-		uint16_t nnn = opcode & 0x0FFFU;
-		index = nnn;
+		index = in.nnn;
 	}
 
 	/* Jumps to the address NNN plus V0. */
-	void Chip8Processor::opcode_BNNN()
+	void Chip8Processor::opcode_BNNN(const Instruction& in)
 	{
-		uint16_t nnn = opcode & 0x0FFFU;
-		pc = V[0] + nnn;
+		pc = V[0] + in.nnn;
 	}
 
 	/* Sets VX to the result of a bitwise-and operation on a randomly generated number between 0 and 255 and NN. */
-	void Chip8Processor::opcode_CXNN()
+	void Chip8Processor::opcode_CXNN(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t nn = opcode & 0x00FFU;
-
-		uint8_t random = rand() % 256;
-		V[x] = random & nn;
+		uint8_t random = NextRandom();
+		V[in.x] = random & in.nn;
 	}
 
 	/*
@@ -375,69 +1031,134 @@ namespace CHIP8
 	 * 8 pixels is read as bit-coded starting from memory location I. I value does not change after the execution of this instruction.
 	 * As described above, VF is set to 1 if any screen pixels are flipped from set to unset when the sprite is drawn, and to 0 if that does not happen. 
 	 */
-	void Chip8Processor::opcode_DXYN()
+	void Chip8Processor::opcode_DXYN(const Instruction& in)
+	{
+		/* The table dispatcher sends DXY0 here too */
+		if (in.n == 0)
+		{
+			opcode_DXY0(in);
+			return;
+		}
+
+		DrawSprite(V[in.x], V[in.y], 8, in.n);
+	}
+
+	void Chip8Processor::DrawSprite(uint8_t x, uint8_t y, unsigned int width, unsigned int height)
+	{
+		unsigned int xPosition = x % display_width;
+		unsigned int yPosition = y % display_height;
+		uint16_t address = index;
+		uint64_t collision = 0;
+		unsigned int plane;
+
+		/* A wrapped sprite touches rows at both ends of the screen */
+		if (yPosition + height > display_height && sprite_wrap)
+			MarkDirty(0, display_height - 1U);
+		else
+			MarkDirty(yPosition, yPosition + height > display_height ? display_height - 1U : yPosition + height - 1U);
+
+		/* XO-CHIP: each selected plane takes the next height rows of sprite data, plane 0's first */
+		for (plane = 0; plane < DISPLAY_PLANES; plane++)
+		{
+			if (plane_mask & (1U << plane))
+			{
+				collision |= DrawPlane(&video[plane * MAX_DISPLAY_WORDS], address, xPosition, yPosition, width, height);
+				address += height * (width / 8U);
+			}
+		}
+
+		V[0xFU] = collision ? 1 : 0;
+
+		PROFILE(OnRead(index, (uint16_t)(address - index)));
+	}
+
+	uint64_t Chip8Processor::DrawPlane(uint64_t* plane, uint16_t address, unsigned int x, unsigned int y, unsigned int width, unsigned int height)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t y = (opcode & 0x00F0U) >> 4U;
-		uint8_t height = opcode & 0x000FU;
+		unsigned int words = display_width / 64U;
+		unsigned int bytes = width / 8U;
+
+		/* Word of the row the sprite starts in, and how far into it */
+		unsigned int word = x / 64U;
+		unsigned int shift = x % 64U;
 
-		uint8_t xPosition = V[x] % DISPLAY_WIDTH;
-		uint8_t yPosition = V[y] % DISPLAY_HEIGHT;
+		/* The part of the sprite past the end of its word lands in the next one, or wraps to the row's first */
+		bool spills = shift && (word + 1U < words || sprite_wrap);
+		unsigned int next = (word + 1U) & (words - 1U);
 
-		V[0xFU] = 0;
+		uint64_t collision = 0;
+		unsigned int row;
 
-		unsigned int row, column;
+		/*
+		 * Each sprite row is shifted into place as whole screen words, so drawing is one AND for collision and
+		 * one XOR per word touched. Shifting clips pixels past the right edge; wrapping moves them to the left edge.
+		 */
 		for (row = 0; row < height; row++)
 		{
-			uint8_t spriteByte = memory[index + row];
+			unsigned int line_y = y + row;
 
-			for (column = 0; column < 8; column++)
+			if (line_y >= display_height)
 			{
-				uint8_t spritePixel = spriteByte & (0x80 >> column);
-				uint32_t* screenPixel = &video[(yPosition + row) * DISPLAY_WIDTH + (xPosition + column)];
+				if (!sprite_wrap)
+					break;
 
-				if (spritePixel)
-				{
-					if (*screenPixel == 0xFFFFFFFF)
-						V[0xFU] = 1;
+				line_y -= display_height;
+			}
 
-					*screenPixel ^= 0xFFFFFFFFF;
-				}
+			uint64_t* line = &plane[line_y * words];
+			uint64_t sprite = (uint64_t)memory[(address + row * bytes) & memory_mask] << 56U;
+
+			if (bytes == 2)
+				sprite |= (uint64_t)memory[(address + row * 2U + 1U) & memory_mask] << 48U;
+
+			collision |= line[word] & (sprite >> shift);
+			line[word] ^= sprite >> shift;
+
+			if (spills)
+			{
+				collision |= line[next] & (sprite << (64U - shift));
+				line[next] ^= sprite << (64U - shift);
 			}
 		}
+
+		return collision;
+	}
+
+	void Chip8Processor::SkipNextInstruction()
+	{
+		pc += 2;
+
+		/* memory_mask is only wider than MEMORY_MASK under XO-CHIP, the one dialect with a four byte opcode */
+		if (memory_mask != MEMORY_MASK && memory[(pc - 2) & memory_mask] == 0xF0 && memory[(pc - 1) & memory_mask] == 0x00)
+			pc += 2;
 	}
 
 	/* Skips the next instruction if the key stored in VX is pressed. */
-	void Chip8Processor::opcode_EX9E()
+	void Chip8Processor::opcode_EX9E(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t key = V[x];
+		uint8_t key = V[in.x] & (INPUT_KEYS - 1);
 
 		if (keypad[key])
-			pc += 2;
+			SkipNextInstruction();
 	}
 
 	/* Skips the next instruction if the key stored in VX is not pressed. */
-	void Chip8Processor::opcode_EXA1()
+	void Chip8Processor::opcode_EXA1(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t key = V[x];
+		uint8_t key = V[in.x] & (INPUT_KEYS - 1);
 
 		if (!keypad[key])
-			pc += 2;
+			SkipNextInstruction();
 	}
 
 	/* Sets VX to the value of the delay timer. */
-	void Chip8Processor::opcode_FX07()
+	void Chip8Processor::opcode_FX07(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		V[x] = delay_timer;
+		V[in.x] = delay_timer;
 	}
 
 	/* A key press is awaited, and then stored in VX. */
-	void Chip8Processor::opcode_FX0A()
+	void Chip8Processor::opcode_FX0A(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
 		unsigned int i = 0;
 		bool found = false;
 
@@ -445,7 +1166,7 @@ namespace CHIP8
 		{
 			if (keypad[i])
 			{
-				V[x] = i;
+				V[in.x] = i;
 				found = true;
 			}
 
@@ -458,116 +1179,675 @@ namespace CHIP8
 	}
 
 	/* Sets the delay timer to VX */
-	void Chip8Processor::opcode_FX15()
+	void Chip8Processor::opcode_FX15(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		delay_timer = V[x];
+		delay_timer = V[in.x];
 	}
 
 	/* Sets the sound timer to VX */
-	void Chip8Processor::opcode_FX18()
+	void Chip8Processor::opcode_FX18(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		sound_timer = V[x];
+		sound_timer = V[in.x];
 	}
 
 	/* Adds VX to I. VF is not affected */
-	void Chip8Processor::opcode_FX1E()
+	void Chip8Processor::opcode_FX1E(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		index += V[x];
+		index += V[in.x];
 	}
 
 	/* Sets I to the location of the sprite for the character in VX. */
-	void Chip8Processor::opcode_FX29()
+	void Chip8Processor::opcode_FX29(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		index = FONTSET_START_ADDRESS + (5 * V[x]);
+		index = FONTSET_START_ADDRESS + (5 * V[in.x]);
 	}
 
 	/*
 	 * Stores the binary-coded decimal representation of VX, with the most significant of three digits at the address in I, the middle digit at I + 1, and the least 
 	 * significant digit at I + 2. 
 	 */
-	void Chip8Processor::opcode_FX33()
+	void Chip8Processor::opcode_FX33(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
-		uint8_t value = V[x];
+		uint8_t value = V[in.x];
 
 		/* Ones-place */
-		memory[index + 2] = value % 10;
+		memory[(index + 2) & memory_mask] = value % 10;
 		value /= 10;
 
 		/* Tens-place */
-		memory[index + 1] = value % 10;
+		memory[(index + 1) & memory_mask] = value % 10;
 		value /= 10;
 
 		/* Hundreds place */
-		memory[index] = value % 10;
+		memory[index & memory_mask] = value % 10;
+
+		MemoryWritten(index, 3);
+		PROFILE(OnWrite(index, 3));
 	}
 
 	/* Stores V0 to VX (including VX) in memory starting at address I. The offset from I is increased by 1 for each value written, but I itself is left unmodified */
-	void Chip8Processor::opcode_FX55()
+	void Chip8Processor::opcode_FX55(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
 		uint8_t i;
 
-		for (i = 0; i <= x; i++)
+		for (i = 0; i <= in.x; i++)
 		{
-			memory[index + i] = V[i];
+			memory[(index + i) & memory_mask] = V[i];
 		}
+
+		MemoryWritten(index, in.x + 1U);
+		PROFILE(OnWrite(index, in.x + 1U));
 	}
 
 	/* Fillx V0 to VX (including VX) with values from memory starting at address I. The offset from I is increased by 1 for each value written, but I itself is left unmodified */
-	void Chip8Processor::opcode_FX65()
+	void Chip8Processor::opcode_FX65(const Instruction& in)
 	{
-		uint8_t x = (opcode & 0x0F00U) >> 8U;
 		uint8_t i;
 
-		for (i = 0; i <= x; i++)
+		for (i = 0; i <= in.x; i++)
+		{
+			V[i] = memory[(index + i) & memory_mask];
+		}
+
+		PROFILE(OnRead(index, in.x + 1U));
+	}
+
+	/* SUPER-CHIP: Scrolls the screen down N pixels. Whole rows move, so this is one memmove per plane. */
+	void Chip8Processor::opcode_00CN(const Instruction& in)
+	{
+		unsigned int words = display_width / 64U;
+		unsigned int rows = in.n < display_height ? in.n : display_height;
+		unsigned int plane;
+
+		for (plane = 0; plane < DISPLAY_PLANES; plane++)
+		{
+			uint64_t* screen = &video[plane * MAX_DISPLAY_WORDS];
+
+			if (!(plane_mask & (1U << plane)))
+				continue;
+
+			memmove(&screen[rows * words], screen, (display_height - rows) * words * sizeof(uint64_t));
+			memset(screen, 0, rows * words * sizeof(uint64_t));
+		}
+
+		MarkDirty(0, display_height - 1U);
+	}
+
+	/* SUPER-CHIP: Scrolls the screen right 4 pixels, carrying bits from each row's left word into its right word */
+	void Chip8Processor::opcode_00FB(const Instruction&)
+	{
+		unsigned int row, plane;
+
+		for (plane = 0; plane < DISPLAY_PLANES; plane++)
+		{
+			uint64_t* screen = &video[plane * MAX_DISPLAY_WORDS];
+
+			if (!(plane_mask & (1U << plane)))
+				continue;
+
+			if (display_width == HIRES_WIDTH)
+			{
+				for (row = 0; row < display_height; row++)
+				{
+					screen[row * 2 + 1] = (screen[row * 2 + 1] >> 4U) | (screen[row * 2] << 60U);
+					screen[row * 2] >>= 4U;
+				}
+			}
+			else
+			{
+				for (row = 0; row < display_height; row++)
+					screen[row] >>= 4U;
+			}
+		}
+
+		MarkDirty(0, display_height - 1U);
+	}
+
+	/* SUPER-CHIP: Scrolls the screen left 4 pixels */
+	void Chip8Processor::opcode_00FC(const Instruction&)
+	{
+		unsigned int row, plane;
+
+		for (plane = 0; plane < DISPLAY_PLANES; plane++)
+		{
+			uint64_t* screen = &video[plane * MAX_DISPLAY_WORDS];
+
+			if (!(plane_mask & (1U << plane)))
+				continue;
+
+			if (display_width == HIRES_WIDTH)
+			{
+				for (row = 0; row < display_height; row++)
+				{
+					screen[row * 2] = (screen[row * 2] << 4U) | (screen[row * 2 + 1] >> 60U);
+					screen[row * 2 + 1] <<= 4U;
+				}
+			}
+			else
+			{
+				for (row = 0; row < display_height; row++)
+					screen[row] <<= 4U;
+			}
+		}
+
+		MarkDirty(0, display_height - 1U);
+	}
+
+	/* SUPER-CHIP: Exits the interpreter. The machine stops here, running this instruction forever. */
+	void Chip8Processor::opcode_00FD(const Instruction&)
+	{
+		pc -= 2;
+	}
+
+	/* SUPER-CHIP: Switches to the 64x32 low resolution screen and clears it */
+	void Chip8Processor::opcode_00FE(const Instruction&)
+	{
+		SetResolution(DISPLAY_WIDTH, DISPLAY_HEIGHT);
+	}
+
+	/* SUPER-CHIP: Switches to the 128x64 high resolution screen and clears it */
+	void Chip8Processor::opcode_00FF(const Instruction&)
+	{
+		SetResolution(HIRES_WIDTH, HIRES_HEIGHT);
+	}
+
+	/* SUPER-CHIP: Draws a 16x16 sprite at (VX, VY) from 32 bytes at I, two bytes per row, with DXYN's collision rule */
+	void Chip8Processor::opcode_DXY0(const Instruction& in)
+	{
+		DrawSprite(V[in.x], V[in.y], 16, 16);
+	}
+
+	/* SUPER-CHIP: Sets I to the location of the 8x10 sprite for the digit in VX */
+	void Chip8Processor::opcode_FX30(const Instruction& in)
+	{
+		index = BIG_FONTSET_START_ADDRESS + (10 * (V[in.x] & 0xFU));
+	}
+
+	/* SUPER-CHIP: Stores V0 to VX (including VX) in the RPL user flags */
+	void Chip8Processor::opcode_FX75(const Instruction& in)
+	{
+		memcpy(rpl, V, in.x + 1U);
+
+		/* The flags are state a loop can change, so idle loop detection has to see the write */
+		memory_writes++;
+	}
+
+	/* SUPER-CHIP: Fills V0 to VX (including VX) from the RPL user flags */
+	void Chip8Processor::opcode_FX85(const Instruction& in)
+	{
+		memcpy(V, rpl, in.x + 1U);
+	}
+
+	/* XO-CHIP: Scrolls the selected planes up N pixels */
+	void Chip8Processor::opcode_00DN(const Instruction& in)
+	{
+		unsigned int words = display_width / 64U;
+		unsigned int rows = in.n < display_height ? in.n : display_height;
+		unsigned int plane;
+
+		for (plane = 0; plane < DISPLAY_PLANES; plane++)
+		{
+			uint64_t* screen = &video[plane * MAX_DISPLAY_WORDS];
+
+			if (!(plane_mask & (1U << plane)))
+				continue;
+
+			memmove(screen, &screen[rows * words], (display_height - rows) * words * sizeof(uint64_t));
+			memset(&screen[(display_height - rows) * words], 0, rows * words * sizeof(uint64_t));
+		}
+
+		MarkDirty(0, display_height - 1U);
+	}
+
+	/* XO-CHIP: Stores VX to VY in memory starting at I, in reverse order if X is greater than Y. I is not changed. */
+	void Chip8Processor::opcode_5XY2(const Instruction& in)
+	{
+		unsigned int count = (in.x <= in.y ? in.y - in.x : in.x - in.y) + 1U;
+		unsigned int i;
+
+		/* Outside XO-CHIP mode this is the plain 5XY0 skip it always was */
+		if (!IsXoChip())
+		{
+			if (V[in.x] == V[in.y])
+				SkipNextInstruction();
+
+			return;
+		}
+
+		for (i = 0; i < count; i++)
+			memory[(index + i) & memory_mask] = V[in.x <= in.y ? in.x + i : in.x - i];
+
+		MemoryWritten(index, count);
+		PROFILE(OnWrite(index, count));
+	}
+
+	/* XO-CHIP: Fills VX to VY from memory starting at I, in reverse order if X is greater than Y. I is not changed. */
+	void Chip8Processor::opcode_5XY3(const Instruction& in)
+	{
+		unsigned int count = (in.x <= in.y ? in.y - in.x : in.x - in.y) + 1U;
+		unsigned int i;
+
+		if (!IsXoChip())
+		{
+			if (V[in.x] == V[in.y])
+				SkipNextInstruction();
+
+			return;
+		}
+
+		for (i = 0; i < count; i++)
+			V[in.x <= in.y ? in.x + i : in.x - i] = memory[(index + i) & memory_mask];
+
+		PROFILE(OnRead(index, count));
+	}
+
+	/* XO-CHIP: Sets I to the 16-bit address NNNN in the two bytes after the opcode, and skips them */
+	void Chip8Processor::opcode_F000(const Instruction&)
+	{
+		/* Not an opcode outside XO-CHIP mode, and a 16-bit I would point past the 4 KB memory */
+		if (!IsXoChip())
+			return;
+
+		index = (uint16_t)((memory[pc & memory_mask] << 8U) | memory[(pc + 1) & memory_mask]);
+		pc += 2;
+	}
+
+	/* XO-CHIP: Selects the planes, a mask of 1 to 3 in N, that drawing, clearing and scrolling apply to */
+	void Chip8Processor::opcode_FN01(const Instruction& in)
+	{
+		plane_mask = in.x & ((1U << DISPLAY_PLANES) - 1U);
+
+		/* The front end starts compositing plane 1 now, so every row has to be redrawn once */
+		if (plane_mask & ~planes_used)
 		{
-			V[i] = memory[index + i];
+			planes_used |= plane_mask;
+			MarkDirty(0, display_height - 1U);
 		}
 	}
 
+	/* XO-CHIP: Loads the 16-byte audio pattern from memory at I */
+	void Chip8Processor::opcode_F002(const Instruction&)
+	{
+		unsigned int i;
+
+		for (i = 0; i < AUDIO_PATTERN_SIZE; i++)
+			audio_pattern[i] = memory[(index + i) & memory_mask];
+
+		audio_pattern_loaded = true;
+
+		PROFILE(OnRead(index, AUDIO_PATTERN_SIZE));
+	}
+
+	/* XO-CHIP: Sets the audio pattern's playback pitch to VX */
+	void Chip8Processor::opcode_FX3A(const Instruction& in)
+	{
+		audio_pitch = V[in.x];
+	}
+
+	void Chip8Processor::SetResolution(unsigned int width, unsigned int height)
+	{
+		display_width = (uint8_t)width;
+		display_height = (uint8_t)height;
+
+		memset(video, 0, sizeof(video));
+		MarkDirty(0, display_height - 1U);
+	}
+
 	#pragma endregion
 
 	#pragma region Jump Table Helpers
 
-	void Chip8Processor::Table0()
+	void Chip8Processor::Table0(const Instruction& in)
 	{
-		((*this).*(table0[opcode & 0x000FU]))();
+		/*
+		 * SUPER-CHIP packs its screen opcodes into 00CN and 00FB to 00FF, XO-CHIP adds 00DN; the rest of group 0
+		 * decodes on the low nibble
+		 */
+		if ((opcode & 0x0FF0U) == 0x00C0U)
+			opcode_00CN(in);
+		else if ((opcode & 0x0FF0U) == 0x00D0U)
+			opcode_00DN(in);
+		else if ((opcode & 0x0FF0U) == 0x00F0U)
+			((*this).*(table00F[opcode & 0x000FU]))(in);
+		else
+			((*this).*(table0[opcode & 0x000FU]))(in);
 	}
 
-	void Chip8Processor::Table8()
+	void Chip8Processor::Table8(const Instruction& in)
 	{
-		((*this).*(table8[opcode & 0x000FU]))();
+		((*this).*(table8[opcode & 0x000FU]))(in);
 	}
 
-	void Chip8Processor::TableE()
+	void Chip8Processor::TableE(const Instruction& in)
 	{
-		((*this).*(tableE[opcode & 0x000FU]))();
+		((*this).*(tableE[opcode & 0x000FU]))(in);
 	}
 
-	void Chip8Processor::TableF()
+	void Chip8Processor::TableF(const Instruction& in)
 	{
-		((*this).*(tableF[opcode & 0x00FFU]))();
+		/* tableF only reaches up to FX85, anything above it is not a Chip-8, SUPER-CHIP or XO-CHIP opcode */
+		if ((opcode & 0x00FFU) > 0x85U)
+		{
+			opcode_NULL(in);
+			return;
+		}
+
+		((*this).*(tableF[opcode & 0x00FFU]))(in);
 	}
 
 	#pragma endregion
 
 	#pragma region States
 
-	uint32_t* Chip8Processor::GetDisplayState()
+	const uint64_t* Chip8Processor::GetDisplayState() const
 	{
 		return video;
 	}
 
+	const uint64_t* Chip8Processor::GetDisplayPlane(unsigned int plane) const
+	{
+		if (plane >= DISPLAY_PLANES || !(planes_used & (1U << plane)))
+			return NULL;
+
+		return &video[plane * MAX_DISPLAY_WORDS];
+	}
+
+	const uint8_t* Chip8Processor::GetAudioPattern() const
+	{
+		return audio_pattern_loaded ? audio_pattern : NULL;
+	}
+
+	uint8_t Chip8Processor::GetAudioPitch() const
+	{
+		return audio_pitch;
+	}
+
+	unsigned int Chip8Processor::GetDisplayWidth() const
+	{
+		return display_width;
+	}
+
+	unsigned int Chip8Processor::GetDisplayHeight() const
+	{
+		return display_height;
+	}
+
+	uint32_t Chip8Processor::GetFrameGeneration() const
+	{
+		return frame_generation;
+	}
+
+	bool Chip8Processor::ConsumeDirtyRows(unsigned int& first, unsigned int& last)
+	{
+		if (dirty_first > dirty_last)
+			return false;
+
+		first = dirty_first;
+		last = dirty_last;
+
+		dirty_first = HIRES_HEIGHT;
+		dirty_last = 0;
+
+		return true;
+	}
+
+	void Chip8Processor::MarkDirty(unsigned int first, unsigned int last)
+	{
+		frame_generation++;
+
+		if (first < dirty_first)
+			dirty_first = first;
+
+		if (last > dirty_last)
+			dirty_last = last;
+	}
+
+	void Chip8Processor::SetRandomSeed(uint32_t seed)
+	{
+		rng_state = seed ? seed : (uint32_t)DEFAULT_RANDOM_SEED;
+	}
+
+	uint8_t Chip8Processor::NextRandom()
+	{
+		rng_state ^= rng_state << 13;
+		rng_state ^= rng_state >> 17;
+		rng_state ^= rng_state << 5;
+
+		/* The high bits of xorshift32 are the better distributed ones */
+		return (uint8_t)(rng_state >> 24);
+	}
+
+	void Chip8Processor::SetSpriteWrap(bool enabled)
+	{
+		sprite_wrap = enabled;
+	}
+
 	uint8_t* Chip8Processor::GetKeypadState()
 	{
 		return keypad;
 	}
 
+	uint16_t Chip8Processor::GetKeypadMask() const
+	{
+		uint16_t keys = 0;
+		unsigned int i;
+
+		for (i = 0; i < INPUT_KEYS; i++)
+			keys |= (keypad[i] ? 1U : 0U) << i;
+
+		return keys;
+	}
+
+	void Chip8Processor::SetKeypadMask(uint16_t keys)
+	{
+		unsigned int i;
+
+		for (i = 0; i < INPUT_KEYS; i++)
+			keypad[i] = (keys >> i) & 1;
+	}
+
+	void Chip8Processor::GetRegisters(Chip8Registers& registers) const
+	{
+		memcpy(registers.V, V, sizeof(V));
+		registers.index = index;
+		registers.pc = pc;
+		memcpy(registers.stack, stack, sizeof(stack));
+		registers.sp = sp;
+		registers.delay_timer = delay_timer;
+		registers.sound_timer = sound_timer;
+	}
+
+	#pragma endregion
+
+	#pragma region Save State
+
+	/* Little-endian field writers and readers that advance the cursor */
+	static void PutLE(uint8_t*& out, uint64_t value, unsigned int bytes)
+	{
+		unsigned int i;
+
+		for (i = 0; i < bytes; i++)
+			*out++ = (uint8_t)(value >> (8 * i));
+	}
+
+	static uint64_t GetLE(const uint8_t*& in, unsigned int bytes)
+	{
+		uint64_t value = 0;
+		unsigned int i;
+
+		for (i = 0; i < bytes; i++)
+			value |= (uint64_t)*in++ << (8 * i);
+
+		return value;
+	}
+
+	/* FNV-1a over the payload, so a torn or corrupted blob is rejected instead of restored */
+	static uint32_t StateChecksum(const uint8_t* data, size_t size)
+	{
+		uint32_t hash = 2166136261U;
+		size_t i;
+
+		for (i = 0; i < size; i++)
+		{
+			hash ^= data[i];
+			hash *= 16777619U;
+		}
+
+		return hash;
+	}
+
+	/*
+	 * Layout, all little-endian: "C8ST", version, flags, payload size, payload checksum, then V, index, pc, stack,
+	 * sp, delay timer, sound timer, keypad as a 16-bit mask, RNG state, display width and height, RPL flags, plane
+	 * mask, planes used, audio pattern, pitch, every framebuffer word of both planes whatever the resolution, and
+	 * memory: 4 KB, or 64 KB with XO-CHIP. Flags: 1 for sprite wrap, 2 for XO-CHIP memory, 4 for a loaded pattern.
+	 */
+	size_t Chip8Processor::SaveState(uint8_t* buffer, size_t size) const
+	{
+		const size_t state_size = GetStateSize();
+		uint8_t* out = buffer;
+		uint16_t keys = 0;
+		unsigned int i;
+
+		if (size < state_size)
+			return 0;
+
+		memcpy(out, "C8ST", 4);
+		out += 4;
+		PutLE(out, STATE_VERSION, 2);
+		PutLE(out, (sprite_wrap ? 1 : 0) | (IsXoChip() ? 2 : 0) | (audio_pattern_loaded ? 4 : 0), 2);
+		PutLE(out, state_size - STATE_HEADER_SIZE, 4);
+		PutLE(out, 0, 4);
+
+		memcpy(out, V, NUM_REGISTERS);
+		out += NUM_REGISTERS;
+		PutLE(out, index, 2);
+		PutLE(out, pc, 2);
+
+		for (i = 0; i < STACK_LEVELS; i++)
+			PutLE(out, stack[i], 2);
+
+		PutLE(out, sp, 1);
+		PutLE(out, delay_timer, 1);
+		PutLE(out, sound_timer, 1);
+
+		for (i = 0; i < INPUT_KEYS; i++)
+			keys |= (keypad[i] ? 1U : 0U) << i;
+
+		PutLE(out, keys, 2);
+		PutLE(out, rng_state, 4);
+		PutLE(out, display_width, 1);
+		PutLE(out, display_height, 1);
+
+		memcpy(out, rpl, RPL_FLAGS);
+		out += RPL_FLAGS;
+		PutLE(out, plane_mask, 1);
+		PutLE(out, planes_used, 1);
+		memcpy(out, audio_pattern, AUDIO_PATTERN_SIZE);
+		out += AUDIO_PATTERN_SIZE;
+		PutLE(out, audio_pitch, 1);
+
+		for (i = 0; i < DISPLAY_PLANES * MAX_DISPLAY_WORDS; i++)
+			PutLE(out, video[i], 8);
+
+		memcpy(out, memory, memory_mask + 1U);
+
+		/* Fill in the checksum now that the payload is written */
+		out = buffer + 12;
+		PutLE(out, StateChecksum(buffer + STATE_HEADER_SIZE, state_size - STATE_HEADER_SIZE), 4);
+
+		return state_size;
+	}
+
+	size_t Chip8Processor::GetStateSize() const
+	{
+		return IsXoChip() ? XO_STATE_SIZE : STATE_SIZE;
+	}
+
+	bool Chip8Processor::LoadState(const uint8_t* buffer, size_t size)
+	{
+		const uint8_t* in = buffer + 4;
+		uint16_t version, flags, keys;
+		uint32_t payload_size, checksum, mask;
+		uint8_t width, height;
+		size_t state_size;
+		unsigned int i;
+
+		if (size < STATE_SIZE || memcmp(buffer, "C8ST", 4))
+			return false;
+
+		version = (uint16_t)GetLE(in, 2);
+		flags = (uint16_t)GetLE(in, 2);
+		payload_size = (uint32_t)GetLE(in, 4);
+		checksum = (uint32_t)GetLE(in, 4);
+
+		state_size = (flags & 2) ? (size_t)XO_STATE_SIZE : (size_t)STATE_SIZE;
+		mask = (flags & 2) ? (uint32_t)XO_MEMORY_MASK : (uint32_t)MEMORY_MASK;
+
+		if (version != STATE_VERSION || size < state_size || payload_size != state_size - STATE_HEADER_SIZE
+			|| checksum != StateChecksum(buffer + STATE_HEADER_SIZE, payload_size))
+			return false;
+
+		/* Only the three screens the machine can produce, so every row index stays inside video */
+		width = buffer[STATE_HEADER_SIZE + 61];
+		height = buffer[STATE_HEADER_SIZE + 62];
+
+		if (!(width == DISPLAY_WIDTH && (height == DISPLAY_HEIGHT || height == HIRES_HEIGHT))
+			&& !(width == HIRES_WIDTH && height == HIRES_HEIGHT))
+			return false;
+
+		sprite_wrap = (flags & 1) != 0;
+		audio_pattern_loaded = (flags & 4) != 0;
+		SetXoChip((flags & 2) != 0);
+
+		memcpy(V, in, NUM_REGISTERS);
+		in += NUM_REGISTERS;
+		index = (uint16_t)(GetLE(in, 2) & mask);
+		pc = (uint16_t)(GetLE(in, 2) & mask);
+
+		for (i = 0; i < STACK_LEVELS; i++)
+			stack[i] = (uint16_t)(GetLE(in, 2) & mask);
+
+		sp = (uint8_t)GetLE(in, 1) % STACK_LEVELS;
+		delay_timer = (uint8_t)GetLE(in, 1);
+		sound_timer = (uint8_t)GetLE(in, 1);
+
+		keys = (uint16_t)GetLE(in, 2);
+
+		for (i = 0; i < INPUT_KEYS; i++)
+			keypad[i] = (keys >> i) & 1;
+
+		SetRandomSeed((uint32_t)GetLE(in, 4));
+
+		display_width = (uint8_t)GetLE(in, 1);
+		display_height = (uint8_t)GetLE(in, 1);
+
+		memcpy(rpl, in, RPL_FLAGS);
+		in += RPL_FLAGS;
+		plane_mask = (uint8_t)GetLE(in, 1) & ((1U << DISPLAY_PLANES) - 1U);
+		planes_used = ((uint8_t)GetLE(in, 1) & ((1U << DISPLAY_PLANES) - 1U)) | 1U;
+		memcpy(audio_pattern, in, AUDIO_PATTERN_SIZE);
+		in += AUDIO_PATTERN_SIZE;
+		audio_pitch = (uint8_t)GetLE(in, 1);
+
+		for (i = 0; i < DISPLAY_PLANES * MAX_DISPLAY_WORDS; i++)
+			video[i] = GetLE(in, 8);
+
+		memcpy(memory, in, mask + 1U);
+
+		/* Memory was replaced wholesale, and the whole framebuffer needs to be redrawn */
+		if (decode_cache)
+			SetDecodeCache(true);
+
+		if (jit)
+			jit->Flush();
+
+		MarkDirty(0, display_height - 1U);
+		waiting_for_input = false;
+
+		return true;
+	}
+
 	#pragma endregion
 
 }
@@ -1,27 +1,146 @@
 #ifndef _CHIP8_H_
 #define _CHIP8_H_
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <random>
 
+/*
+ * Build with CHIP8_DISPATCH_THREADED=1 to make RunCycles use the threaded dispatch loop instead of the
+ * table dispatcher whenever the JIT and the decode cache are disabled.
+ */
+#ifndef CHIP8_DISPATCH_THREADED
+#define CHIP8_DISPATCH_THREADED 0
+#endif
+
+/*
+ * Build with CHIP8_PROFILE=1 to compile in the guest profiler hooks used by SetProfiler. Without it Cycle and
+ * the opcode handlers carry no profiling code at all.
+ */
+#ifndef CHIP8_PROFILE
+#define CHIP8_PROFILE 0
+#endif
+
 namespace CHIP8
 {
+	/* Identifies the handler of a decoded opcode */
+	enum OpcodeId : uint8_t
+	{
+		OP_NULL, OP_00E0, OP_00EE, OP_1NNN, OP_2NNN, OP_3XNN, OP_4XNN, OP_5XY0, OP_6XNN, OP_7XNN,
+		OP_8XY0, OP_8XY1, OP_8XY2, OP_8XY3, OP_8XY4, OP_8XY5, OP_8XY6, OP_8XY7, OP_8XYE, OP_9XY0,
+		OP_ANNN, OP_BNNN, OP_CXNN, OP_DXYN, OP_EX9E, OP_EXA1, OP_FX07, OP_FX0A, OP_FX15, OP_FX18,
+		OP_FX1E, OP_FX29, OP_FX33, OP_FX55, OP_FX65,
+
+		/* SUPER-CHIP */
+		OP_00CN, OP_00FB, OP_00FC, OP_00FD, OP_00FE, OP_00FF, OP_DXY0, OP_FX30, OP_FX75, OP_FX85,
+
+		/* XO-CHIP */
+		OP_00DN, OP_5XY2, OP_5XY3, OP_F000, OP_FN01, OP_F002, OP_FX3A,
+		OP_COUNT,
+
+		/* Marks a decode cache entry that has not been decoded yet or was invalidated */
+		OP_UNDECODED = 0xFF
+	};
+
+	class Chip8Jit;
+	class Chip8Lanes;
+	class Chip8Profiler;
+
+	/* A read-only view of bytes owned elsewhere, such as a ROM image inside a mapped bundle */
+	struct ByteSpan
+	{
+		const uint8_t* data;
+		size_t size;
+	};
+
+	/* The registers a program can see, copied out by Chip8Processor::GetRegisters */
+	struct Chip8Registers
+	{
+		uint8_t V[16];
+		uint16_t index;
+		uint16_t pc;
+		uint16_t stack[16];
+		uint8_t sp;
+		uint8_t delay_timer;
+		uint8_t sound_timer;
+	};
+
+	/* An opcode with its operands already extracted */
+	struct Instruction
+	{
+		uint8_t id;
+		uint8_t x;
+		uint8_t y;
+		uint8_t n;
+		uint8_t nn;
+		uint16_t nnn;
+	};
+
 	class Chip8Processor
 	{
+		friend class Chip8Jit;
+		friend class Chip8Lanes;
+
+		public:
+			/* Low resolution, the CHIP-8 screen. SUPER-CHIP 00FF and VIP hires ROMs switch to a larger one. */
+			static const unsigned int DISPLAY_WIDTH = 64;
+			static const unsigned int DISPLAY_HEIGHT = 32;
+
+			/* SUPER-CHIP high resolution, the largest screen. Rows are two words wide at this width. */
+			static const unsigned int HIRES_WIDTH = 128;
+			static const unsigned int HIRES_HEIGHT = 64;
+			static const unsigned int MAX_DISPLAY_WORDS = HIRES_WIDTH / 64 * HIRES_HEIGHT;
+
+			/* XO-CHIP bitplanes. Plane 0 is the only one Chip-8 and SUPER-CHIP draw to. */
+			static const unsigned int DISPLAY_PLANES = 2;
+
+			/* XO-CHIP address space, only allocated once a machine is switched to it */
+			static const unsigned int XO_MEMORY_LOCATIONS = 65536;
+
+			/* XO-CHIP F002 pattern: 128 one-bit samples played at the FX3A pitch */
+			static const unsigned int AUDIO_PATTERN_SIZE = 16;
+			static const uint8_t DEFAULT_AUDIO_PITCH = 64;
+
+			static const unsigned int INPUT_KEYS = 16;
+
+			/* CXNN seed of a new processor, also used in place of a zero seed */
+			static const uint32_t DEFAULT_RANDOM_SEED = 0x2545F491U;
+
+			/* Save state format written by SaveState. Bump STATE_VERSION whenever the layout changes. */
+			static const uint16_t STATE_VERSION = 3;
+			static const size_t STATE_HEADER_SIZE = 16;
+			static const size_t STATE_SIZE = STATE_HEADER_SIZE + 16 + 2 + 2 + 32 + 1 + 1 + 1 + 2 + 4 + 1 + 1 + 16
+				+ 1 + 1 + 16 + 1 + 2 * 128 * 8 + 4096;
+
+			/* A machine with XO-CHIP memory saves the 60 KB above the first 4 KB as well */
+			static const size_t XO_STATE_SIZE = STATE_SIZE + 65536 - 4096;
+
 		private:
 			static const unsigned int NUM_REGISTERS = 16;
 			static const unsigned int MEMORY_LOCATIONS = 4096;
+			static const unsigned int MEMORY_MASK = MEMORY_LOCATIONS - 1;
+			static const unsigned int XO_MEMORY_MASK = XO_MEMORY_LOCATIONS - 1;
 			static const unsigned int STACK_LEVELS = 16;
-			static const unsigned int INPUT_KEYS = 16;
-			static const unsigned int DISPLAY_WIDTH = 64;
-			static const unsigned int DISPLAY_HEIGHT = 32;
 			static const unsigned int START_ADDRESS = 0X200;
 			static const unsigned int FONTSET_SIZE = 80;
 			static const unsigned int FONTSET_START_ADDRESS = 0x50;
+			static const unsigned int BIG_FONTSET_SIZE = 160;
+			static const unsigned int BIG_FONTSET_START_ADDRESS = FONTSET_START_ADDRESS + FONTSET_SIZE;
+			static const unsigned int RPL_FLAGS = 16;
 
-			/* Memory layout */
+			/* A VIP two-page hires ROM starts with a jump over its interpreter patch; its CHIP-8 code starts here */
+			static const unsigned int VIP_HIRES_START_ADDRESS = 0x2C0;
+
+			/*
+			 * Memory layout. memory points at base_memory, or at xo_memory once XO-CHIP is enabled, and every access
+			 * wraps with memory_mask. A Chip-8 machine keeps its 4 KB inline and never touches the heap.
+			 */
 			uint8_t V[NUM_REGISTERS] { };
-			uint8_t memory[MEMORY_LOCATIONS]{ };
+			uint8_t* memory;
+			uint32_t memory_mask;
+			uint8_t base_memory[MEMORY_LOCATIONS]{ };
+			std::unique_ptr<uint8_t[]> xo_memory;
 			uint16_t index;
 			uint16_t pc;
 			uint16_t stack[STACK_LEVELS]{ };
@@ -31,94 +150,207 @@ namespace CHIP8
 			uint8_t delay_timer;
 			uint8_t sound_timer;
 
+			/* Whether the sound timer was running at the last tick. Not part of the saved state. */
+			bool sound_playing;
+
 			/* Keypad Inputs */
 			uint8_t keypad[INPUT_KEYS]{ };
 
-			/* Graphics Display */
-			uint32_t video[DISPLAY_WIDTH * DISPLAY_HEIGHT]{ };
+			/* xorshift32 state behind CXNN. Kept per instance so it can be saved and replayed. */
+			uint32_t rng_state;
+
+			uint8_t NextRandom();
+
+			/* SUPER-CHIP FX75/FX85 storage, the HP-48 RPL user flags */
+			uint8_t rpl[RPL_FLAGS]{ };
+
+			/*
+			 * Graphics Display. One bit per pixel, display_width / 64 words per row, leftmost pixel in the most
+			 * significant bit of the first word. Only the first display_height rows are in use. Plane p starts at
+			 * video[p * MAX_DISPLAY_WORDS].
+			 */
+			uint64_t video[DISPLAY_PLANES * MAX_DISPLAY_WORDS]{ };
+			uint8_t display_width;
+			uint8_t display_height;
+
+			/* XO-CHIP FN01 selection that drawing, clearing and scrolling apply to, and every plane ever selected */
+			uint8_t plane_mask;
+			uint8_t planes_used;
+
+			/* XO-CHIP audio: the F002 pattern, whether one was loaded, and the FX3A pitch */
+			uint8_t audio_pattern[AUDIO_PATTERN_SIZE]{ };
+			bool audio_pattern_loaded;
+			uint8_t audio_pitch;
+
+			/* Switch resolution and clear every plane */
+			void SetResolution(unsigned int width, unsigned int height);
+
+			/* XOR a sprite of width 8 or 16 pixels onto each selected plane at (x, y), setting VF on collision */
+			void DrawSprite(uint8_t x, uint8_t y, unsigned int width, unsigned int height);
+
+			/* Draw one plane's part of a sprite from address. Returns the pixels it turned off. */
+			uint64_t DrawPlane(uint64_t* plane, uint16_t address, unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+
+			/* Skip the instruction at pc; under XO-CHIP that is all four bytes of an F000 NNNN */
+			void SkipNextInstruction();
+
+			/* Quirk: wrap sprites around the screen edges instead of clipping them */
+			bool sprite_wrap;
+
+			/* Bumped on every framebuffer write, with the range of rows written since the last ConsumeDirtyRows */
+			uint32_t frame_generation;
+			uint8_t dirty_first;
+			uint8_t dirty_last;
+
+			void MarkDirty(unsigned int first, unsigned int last);
 
 			/* Pointer to current Opcode to be executed*/
 			uint16_t opcode;
 
-			uint8_t fontset[FONTSET_SIZE] =
-			{
-				0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-				0x20, 0x60, 0x20, 0x20, 0x70, // 1
-				0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-				0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-				0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-				0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-				0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-				0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-				0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-				0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-				0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-				0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-				0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-				0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-				0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-				0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-			};
+			/* Shared by every instance, copied into memory at FONTSET_START_ADDRESS and BIG_FONTSET_START_ADDRESS */
+			static const uint8_t fontset[FONTSET_SIZE];
+			static const uint8_t big_fontset[BIG_FONTSET_SIZE];
 
 			/*
-			 * Functions to execute each of the 35 Chip-8 opcodes. List of opcodes can be
-			 * found here: https://en.wikipedia.org/wiki/CHIP-8
+			 * Functions to execute each of the 35 Chip-8 opcodes, the 10 SUPER-CHIP ones and the 7 XO-CHIP ones. List
+			 * of opcodes can be found here: https://en.wikipedia.org/wiki/CHIP-8
 			 */
 
 			#pragma region opcodes
-			void opcode_NULL();
-			void opcode_00E0();
-			void opcode_00EE();
-			void opcode_1NNN();
-			void opcode_2NNN();
-			void opcode_3XNN();
-			void opcode_4XNN();
-			void opcode_5XY0();
-			void opcode_6XNN();
-			void opcode_7XNN();
-			void opcode_8XY0();
-			void opcode_8XY1();
-			void opcode_8XY2();
-			void opcode_8XY3();
-			void opcode_8XY4();
-			void opcode_8XY5();
-			void opcode_8XY6();
-			void opcode_8XY7();
-			void opcode_8XYE();
-			void opcode_9XY0();
-			void opcode_ANNN();
-			void opcode_BNNN();
-			void opcode_CXNN();
-			void opcode_DXYN();
-			void opcode_EX9E();
-			void opcode_EXA1();
-			void opcode_FX07();
-			void opcode_FX0A();
-			void opcode_FX15();
-			void opcode_FX18();
-			void opcode_FX1E();
-			void opcode_FX29();
-			void opcode_FX33();
-			void opcode_FX55();
-			void opcode_FX65();
+			void opcode_NULL(const Instruction& in);
+			void opcode_00E0(const Instruction& in);
+			void opcode_00EE(const Instruction& in);
+			void opcode_1NNN(const Instruction& in);
+			void opcode_2NNN(const Instruction& in);
+			void opcode_3XNN(const Instruction& in);
+			void opcode_4XNN(const Instruction& in);
+			void opcode_5XY0(const Instruction& in);
+			void opcode_6XNN(const Instruction& in);
+			void opcode_7XNN(const Instruction& in);
+			void opcode_8XY0(const Instruction& in);
+			void opcode_8XY1(const Instruction& in);
+			void opcode_8XY2(const Instruction& in);
+			void opcode_8XY3(const Instruction& in);
+			void opcode_8XY4(const Instruction& in);
+			void opcode_8XY5(const Instruction& in);
+			void opcode_8XY6(const Instruction& in);
+			void opcode_8XY7(const Instruction& in);
+			void opcode_8XYE(const Instruction& in);
+			void opcode_9XY0(const Instruction& in);
+			void opcode_ANNN(const Instruction& in);
+			void opcode_BNNN(const Instruction& in);
+			void opcode_CXNN(const Instruction& in);
+			void opcode_DXYN(const Instruction& in);
+			void opcode_EX9E(const Instruction& in);
+			void opcode_EXA1(const Instruction& in);
+			void opcode_FX07(const Instruction& in);
+			void opcode_FX0A(const Instruction& in);
+			void opcode_FX15(const Instruction& in);
+			void opcode_FX18(const Instruction& in);
+			void opcode_FX1E(const Instruction& in);
+			void opcode_FX29(const Instruction& in);
+			void opcode_FX33(const Instruction& in);
+			void opcode_FX55(const Instruction& in);
+			void opcode_FX65(const Instruction& in);
+			void opcode_00CN(const Instruction& in);
+			void opcode_00FB(const Instruction& in);
+			void opcode_00FC(const Instruction& in);
+			void opcode_00FD(const Instruction& in);
+			void opcode_00FE(const Instruction& in);
+			void opcode_00FF(const Instruction& in);
+			void opcode_DXY0(const Instruction& in);
+			void opcode_FX30(const Instruction& in);
+			void opcode_FX75(const Instruction& in);
+			void opcode_FX85(const Instruction& in);
+			void opcode_00DN(const Instruction& in);
+			void opcode_5XY2(const Instruction& in);
+			void opcode_5XY3(const Instruction& in);
+			void opcode_F000(const Instruction& in);
+			void opcode_FN01(const Instruction& in);
+			void opcode_F002(const Instruction& in);
+			void opcode_FX3A(const Instruction& in);
 			#pragma endregion
 
-			typedef void (Chip8Processor::*Opcode)();
+			typedef void (Chip8Processor::*Opcode)(const Instruction& in);
 			
-			void Table0();
-			void Table8();
-			void TableE();
-			void TableF();
+			void Table0(const Instruction& in);
+			void Table8(const Instruction& in);
+			void TableE(const Instruction& in);
+			void TableF(const Instruction& in);
+
+			/* Shared by every instance */
+			static const Opcode table[0xF + 1];
+			static const Opcode table0[0xF + 1];
+			static const Opcode table00F[0xF + 1];
+			static const Opcode table8[0xF + 1];
+			static const Opcode tableE[0xF + 1];
+			static const Opcode tableF[0x85 + 1];
+
+			/* Leaf handler for every OpcodeId, used by the predecoded engine to dispatch with a single indirect call */
+			static const Opcode handlers[OP_COUNT];
 
-			Opcode table[0xF + 1];
-			Opcode table0[0xE + 1];
-			Opcode table8[0xE + 1];
-			Opcode tableE[0xE + 1];
-			Opcode tableF[0x65 + 1];
+			/* Predecoded instructions indexed by address. Only allocated while the decode cache is enabled. */
+			std::unique_ptr<Instruction[]> decode_cache;
+
+			/* Fetch, decode and execute one instruction through the decode cache */
+			void ExecuteCached();
+
+			/* Drop cached decodes overlapping a write of length bytes at address */
+			void InvalidateDecodeCache(uint16_t address, unsigned int length);
+
+			/* Native code translator. Only allocated while the JIT is enabled. */
+			std::unique_ptr<Chip8Jit> jit;
+
+			/* Bumped by every write to memory, so idle loop detection can tell that memory did not change */
+			uint32_t memory_writes;
+
+			/* Everything a loop could change, captured when control branches backwards to pc */
+			struct IdleState
+			{
+				/* Instructions into the current RunCycles when captured, zero for an empty snapshot */
+				uint64_t cycle;
+				uint32_t rng_state;
+				uint32_t frame_generation;
+				uint32_t memory_writes;
+				uint16_t pc;
+				uint16_t index;
+				uint16_t stack[STACK_LEVELS];
+				uint8_t V[NUM_REGISTERS];
+				uint8_t sp;
+				uint8_t delay_timer;
+				uint8_t sound_timer;
+
+				/* Backward branches to let pass before the next check, doubled while the loop keeps making progress */
+				uint32_t interval;
+				uint32_t countdown;
+
+				/* Backward branches to other heads seen while waiting for this one */
+				uint32_t stale;
+			};
+
+			static const uint32_t MAX_IDLE_CHECK_INTERVAL = 64;
+
+			bool idle_skip;
+			bool waiting_for_input;
+			uint64_t idle_skipped;
+
+			/*
+			 * Called after a backward branch. If the machine is back at the head of the previous backward branch
+			 * in exactly the same state, the loop in between changes nothing until the next timer tick or key
+			 * change, so whole iterations of it are skipped. Returns the number of instructions skipped.
+			 */
+			uint64_t SkipIdleLoop(IdleState& head, uint64_t cycle, uint64_t remaining);
+
+			/* Guest profiler fed by Cycle and the opcode handlers. Not owned. */
+			Chip8Profiler* profiler;
+
+			/* Tell the decode cache and the JIT that length bytes at address were overwritten */
+			void MemoryWritten(uint16_t address, unsigned int length);
 
 		public:
 			/* Constructor initializes memory */
 			Chip8Processor();
+			~Chip8Processor();
 
 			/* 
 			 * Load a Chip-8 ROM into main memory. On success,
@@ -126,11 +358,149 @@ namespace CHIP8
 			 */
 			int LoadROM(const char *filename);
 
-			/* Emulate one Chip-8 "Cycle" */
+			/*
+			 * Load a Chip-8 ROM image that is already in memory. Returns zero if it does not fit. A VIP two-page
+			 * hires ROM (one that starts with 1260) switches the screen to 64x64 and starts at its CHIP-8 code.
+			 */
+			int LoadROM(const uint8_t* data, size_t size);
+
+			/* Load a ROM image from a span, copying it straight into main memory. Returns zero if it does not fit. */
+			int LoadROM(ByteSpan rom);
+
+			/*
+			 * Switch to XO-CHIP's 64 KB address space, or back to 4 KB. The first 4 KB of memory are kept. Under
+			 * XO-CHIP skips step over all of F000 NNNN. LoadROM switches on its own for a ROM too big for 4 KB.
+			 */
+			void SetXoChip(bool enabled);
+			bool IsXoChip() const;
+
+			/* Emulate one Chip-8 "Cycle". Timers are not touched, they tick once per frame in TickTimers. */
 			void Cycle();
 
-			uint32_t* GetDisplayState();
+			/*
+			 * Enable or disable the predecoded instruction cache. When enabled, each address is decoded once into
+			 * an Instruction and later cycles dispatch straight to its handler. Writes to memory made by FX33 and
+			 * FX55 invalidate the affected entries, so self-modifying ROMs behave the same as with the table dispatcher.
+			 */
+			void SetDecodeCache(bool enabled);
+
+			/*
+			 * Enable or disable the x86-64 JIT used by RunCycles. Returns false, leaving the interpreter in
+			 * charge, if native code cannot be generated on this host.
+			 */
+			bool SetJit(bool enabled);
+
+			/*
+			 * Attach a profiler, or detach it with NULL. While attached, RunCycles bypasses the JIT and the
+			 * threaded loop so every instruction goes through Cycle. Returns false if the build has no
+			 * profiling hooks (CHIP8_PROFILE=0).
+			 */
+			bool SetProfiler(Chip8Profiler* profiler);
+
+			/*
+			 * Enable or disable idle loop skipping in RunCycles (enabled by default). A loop that comes back to
+			 * the same state every iteration, such as FX0A waiting for a key, a jump to itself or an FX07/3XNN/1NNN
+			 * delay timer poll, cannot change anything before the next frame, so the rest of the frame's
+			 * iterations are skipped. The machine ends up exactly where running them would have left it.
+			 */
+			void SetIdleSkip(bool enabled);
+
+			/* Instructions skipped by idle loop detection so far */
+			uint64_t GetIdleSkipped() const;
+
+			/*
+			 * True if the last RunCycles ended in an idle loop with both timers stopped. Every later frame will be
+			 * the same until the keypad changes, so an interactive host can sleep until input arrives.
+			 */
+			bool IsWaitingForInput() const;
+
+			/* Emulate count cycles. Uses translated blocks when the JIT is enabled and the interpreter otherwise. */
+			void RunCycles(uint64_t count);
+
+			/* Emulate one 60 Hz frame: run the given number of instructions, then tick the timers */
+			void RunFrame(uint64_t instructions);
+
+			/* Decrement the delay timer and the sound timer. Called at 60 Hz. */
+			void TickTimers();
+
+			/* True if the buzzer sounded through the last frame: the sound timer was nonzero when it last ticked */
+			bool IsSoundPlaying() const;
+
+			/*
+			 * Emulate count cycles in a single dispatch loop with every opcode handler inlined. Uses computed
+			 * goto where the compiler supports it and a dense switch otherwise. Produces the same results as
+			 * calling Cycle count times with the table dispatcher.
+			 */
+			void RunThreaded(uint64_t count);
+
+			/*
+			 * Seed the CXNN random number generator. A zero seed is replaced by DEFAULT_RANDOM_SEED. New processors
+			 * start from DEFAULT_RANDOM_SEED and LoadROM does not reseed, so runs are reproducible unless reseeded.
+			 */
+			void SetRandomSeed(uint32_t seed);
+
+			/*
+			 * Serialize the complete machine state (registers, memory, stack, timers, keypad, framebuffer and RNG)
+			 * into buffer. Returns the number of bytes written, GetStateSize(), or zero if buffer is too small.
+			 * Does not allocate.
+			 */
+			size_t SaveState(uint8_t* buffer, size_t size) const;
+
+			/* STATE_SIZE, or XO_STATE_SIZE with XO-CHIP memory */
+			size_t GetStateSize() const;
+
+			/*
+			 * Restore a state written by SaveState, switching XO-CHIP memory on or off to match it. Returns false,
+			 * leaving the machine untouched, if the blob is truncated, corrupt or from another format version.
+			 */
+			bool LoadState(const uint8_t* buffer, size_t size);
+
+			/* Decode an opcode into its handler and operands */
+			static Instruction Decode(uint16_t opcode);
+
+			/*
+			 * Quirk: when enabled, DXYN wraps sprites that cross the right or bottom edge to the other side of the
+			 * screen. By default they are clipped.
+			 */
+			void SetSpriteWrap(bool enabled);
+
+			/* Incremented whenever 00E0, DXYN, a scroll or a resolution switch writes to the framebuffer */
+			uint32_t GetFrameGeneration() const;
+
+			/*
+			 * Get the range of rows written since the last call and reset it. Returns false, leaving first and
+			 * last untouched, if the framebuffer has not changed.
+			 */
+			bool ConsumeDirtyRows(unsigned int& first, unsigned int& last);
+
+			/*
+			 * The framebuffer, GetDisplayHeight() rows of GetDisplayWidth() / 64 words, one bit per pixel. Use
+			 * ExpandFramebuffer to turn it into pixels. This is plane 0.
+			 */
+			const uint64_t* GetDisplayState() const;
+
+			/*
+			 * An XO-CHIP bitplane laid out like GetDisplayState, or NULL for plane 1 until a ROM selects it. With
+			 * both planes ExpandPlanes composites them into four colours.
+			 */
+			const uint64_t* GetDisplayPlane(unsigned int plane) const;
+
+			/* The F002 pattern, or NULL until one is loaded and the sound timer should play a plain beep */
+			const uint8_t* GetAudioPattern() const;
+
+			/* FX3A pitch: the pattern plays at 4000 * 2^((pitch - 64) / 48) samples per second */
+			uint8_t GetAudioPitch() const;
+
+			/* Current resolution: 64x32, 64x64 for a VIP hires ROM or 128x64 after SUPER-CHIP 00FF */
+			unsigned int GetDisplayWidth() const;
+			unsigned int GetDisplayHeight() const;
 			uint8_t* GetKeypadState();
+
+			/* Pressed keys as one bit per key, key 0 in the least significant bit */
+			uint16_t GetKeypadMask() const;
+			void SetKeypadMask(uint16_t keys);
+
+			void GetRegisters(Chip8Registers& registers) const;
 	};
 }
 
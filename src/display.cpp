@@ -1,11 +1,20 @@
 #include "SDL.h"
 #include "display.h"
+#include "framebuffer.h"
+#include <cctype>
+#include <cstring>
 
 namespace CHIP8
 {
+	static const char* const DEFAULT_KEYMAP = "x123qweasdzc4rfv";
+
 	Chip8Display::Chip8Display(const char* title, int window_width, int window_height, int texture_width, int texture_height)
+		: audio_device(0), frame_event_pending(false), texture_width(texture_width), texture_height(texture_height), pixels(texture_width * texture_height),
+		scaled_texture(NULL), scaled_width(0), scaled_height(0), keypad(KeypadState{ 0, 0 }), turbo_held(false), rewind_held(false)
 	{
 		SDL_Init(SDL_INIT_VIDEO);
+		frame_event = SDL_RegisterEvents(1);
+		SetKeymap(DEFAULT_KEYMAP);
 
 		window = SDL_CreateWindow(title, 0, 0, window_width, window_height, SDL_WINDOW_SHOWN);
 		renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
@@ -14,214 +23,272 @@ namespace CHIP8
 
 	Chip8Display::~Chip8Display()
 	{
+		/* Waits for a callback in progress to return */
+		if (audio_device)
+			SDL_CloseAudioDevice(audio_device);
+
+		if (scaled_texture)
+			SDL_DestroyTexture(scaled_texture);
+
 		SDL_DestroyTexture(texture);
 		SDL_DestroyRenderer(renderer);
 		SDL_DestroyWindow(window);
 		SDL_Quit();
 	}
 
-	void Chip8Display::UpdateDisplay(const void* display_state, int pitch)
+	/* Background, plane 0, plane 1 and both, RGBA */
+	static const uint32_t PALETTE[4] = { 0x00000000, 0xFFFFFFFF, 0xFF6600FF, 0x662200FF };
+
+	void Chip8Display::UpdateDisplay(const uint64_t* plane0, const uint64_t* plane1, unsigned int width, unsigned int height,
+		unsigned int first_row, unsigned int last_row)
+	{
+		unsigned int words = width / 64;
+		SDL_Rect rect;
+
+		if (post_process)
+		{
+			post_process->Process(plane0, plane1, width, height, PALETTE);
+			UploadProcessed();
+			return;
+		}
+
+		/* A SUPER-CHIP resolution switch; the texture keeps filling the window, so pixels just get smaller */
+		if ((int)width != texture_width || (int)height != texture_height)
+		{
+			texture_width = width;
+			texture_height = height;
+			pixels.assign(width * height, 0);
+
+			SDL_DestroyTexture(texture);
+			texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, texture_width, texture_height);
+		}
+
+		uint32_t* first_pixel = pixels.data() + first_row * texture_width;
+
+		if (last_row >= (unsigned int)texture_height)
+			last_row = texture_height - 1;
+
+		if (first_row > last_row)
+			return;
+
+		rect.x = 0;
+		rect.y = first_row;
+		rect.w = texture_width;
+		rect.h = last_row - first_row + 1;
+
+		/* Only the rows that changed are expanded and sent to the GPU */
+		if (plane1)
+			ExpandPlanes(plane0 + first_row * words, plane1 + first_row * words, texture_width, rect.h, first_pixel, texture_width, PALETTE);
+		else
+			ExpandFramebuffer(plane0 + first_row * words, texture_width, rect.h, first_pixel, texture_width, PALETTE[1], PALETTE[0]);
+		SDL_UpdateTexture(texture, &rect, first_pixel, texture_width * sizeof(uint32_t));
+	}
+
+	/* Runs on SDL's audio thread. Only copies out of the ring: no locks, no allocation. */
+	static void SDLCALL AudioCallback(void* userdata, Uint8* stream, int len)
+	{
+		static_cast<Chip8Beeper*>(userdata)->Read(reinterpret_cast<int16_t*>(stream), len / sizeof(int16_t));
+	}
+
+	bool Chip8Display::OpenAudio(Chip8Beeper& beeper)
+	{
+		SDL_AudioSpec want = { }, have;
+
+		if (audio_device || SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+			return false;
+
+		/* Without SDL_AUDIO_ALLOW_* flags SDL converts for the device, so the callback always gets this format */
+		want.freq = beeper.GetSampleRate();
+		want.format = AUDIO_S16SYS;
+		want.channels = 1;
+		want.samples = (Uint16)beeper.GetBufferSamples();
+		want.callback = AudioCallback;
+		want.userdata = &beeper;
+
+		if ((audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0)) == 0)
+			return false;
+
+		SDL_PauseAudioDevice(audio_device, 0);
+		return true;
+	}
+
+	void Chip8Display::SetPostProcess(const PostProcessSettings& settings)
+	{
+		int width, height;
+
+		post_process.reset(new Chip8PostProcess(settings));
+
+		if (SDL_GetRendererOutputSize(renderer, &width, &height) == 0)
+			post_process->SetTargetSize(width, height);
+	}
+
+	void Chip8Display::UploadProcessed()
+	{
+		/* Checked on every upload so the image follows the window when it is resized */
+		int width, height;
+
+		if (SDL_GetRendererOutputSize(renderer, &width, &height) == 0)
+			post_process->SetTargetSize(width, height);
+
+		if ((int)post_process->GetOutputWidth() != scaled_width || (int)post_process->GetOutputHeight() != scaled_height)
+		{
+			scaled_width = post_process->GetOutputWidth();
+			scaled_height = post_process->GetOutputHeight();
+
+			if (scaled_texture)
+				SDL_DestroyTexture(scaled_texture);
+
+			scaled_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, scaled_width, scaled_height);
+		}
+
+		SDL_UpdateTexture(scaled_texture, NULL, post_process->GetOutput(), scaled_width * sizeof(uint32_t));
+	}
+
+	bool Chip8Display::IsFading() const
+	{
+		return post_process && post_process->IsFading();
+	}
+
+	void Chip8Display::Refresh()
+	{
+		if (!post_process)
+			return;
+
+		post_process->Refresh();
+		UploadProcessed();
+	}
+
+	void Chip8Display::Present(uint16_t input_serial)
 	{
-		SDL_UpdateTexture(texture, NULL, display_state, pitch);
 		SDL_RenderClear(renderer);
-		SDL_RenderCopy(renderer, texture, NULL, NULL);
+
+		if (post_process)
+		{
+			SDL_Rect rect;
+			int width, height;
+
+			/* The processed image is already at its final size: centre it, letterboxed */
+			SDL_GetRendererOutputSize(renderer, &width, &height);
+			rect.w = scaled_width;
+			rect.h = scaled_height;
+			rect.x = (width - scaled_width) / 2;
+			rect.y = (height - scaled_height) / 2;
+			SDL_RenderCopy(renderer, scaled_texture, NULL, &rect);
+		}
+		else
+			SDL_RenderCopy(renderer, texture, NULL, NULL);
+
 		SDL_RenderPresent(renderer);
+
+		latency.Presented(input_serial);
 	}
 
-	bool Chip8Display::HandleInput(uint8_t* keys_state)
+	bool Chip8Display::SetKeymap(const char* keys)
 	{
+		int8_t lookup[KEYMAP_SIZE];
+		unsigned int key;
+
+		memset(lookup, -1, sizeof(lookup));
+
+		if (strlen(keys) != Chip8Processor::INPUT_KEYS)
+			return false;
+
+		for (key = 0; key < Chip8Processor::INPUT_KEYS; key++)
+		{
+			/* SDL keycodes for printable keys are their unshifted ASCII characters */
+			unsigned char code = (unsigned char)tolower((unsigned char)keys[key]);
+
+			if (!isgraph(code) || code >= KEYMAP_SIZE || lookup[code] >= 0)
+				return false;
+
+			lookup[code] = (int8_t)key;
+		}
+
+		memcpy(key_lookup, lookup, sizeof(key_lookup));
+		return true;
+	}
+
+	bool Chip8Display::HandleInput()
+	{
+		KeypadState state = keypad.load(std::memory_order_relaxed);
+		uint16_t mask;
 		bool quit = false;
 
 		SDL_Event event;
 
 		while (SDL_PollEvent(&event))
 		{
-			switch (event.type)
+			/* Cleared before the caller looks for the frame, so a frame published after this queues a new wakeup */
+			if ((Uint32)event.type == frame_event)
+				frame_event_pending.store(false, std::memory_order_relaxed);
+
+			if (event.type != SDL_KEYDOWN && event.type != SDL_KEYUP)
+			{
+				quit |= event.type == SDL_QUIT;
+				continue;
+			}
+
+			bool down = event.type == SDL_KEYDOWN;
+			SDL_Keycode code = event.key.keysym.sym;
+
+			if (code == SDLK_ESCAPE)
+				quit |= down;
+			else if (code == SDLK_TAB)
+				turbo_held.store(down, std::memory_order_relaxed);
+			else if (code == SDLK_BACKSPACE)
+				rewind_held.store(down, std::memory_order_relaxed);
+			else if (code >= 0 && code < (SDL_Keycode)KEYMAP_SIZE && key_lookup[code] >= 0)
 			{
-			    case SDL_QUIT:
-			    {
-				    quit = true;
-			    } break;
-
-			    case SDL_KEYDOWN:
-			    {
-				    switch (event.key.keysym.sym)
-				    {
-				        case SDLK_ESCAPE:
-				        {
-					        quit = true;
-				        } break;
-
-				        case SDLK_x:
-				        {
-					        keys_state[0] = 1;
-				        } break;
-
-				        case SDLK_1:
-				        {
-					        keys_state[1] = 1;
-				        } break;
-
-				        case SDLK_2:
-				        {
-					        keys_state[2] = 1;
-				        } break;
-
-				        case SDLK_3:
-				        {
-					        keys_state[3] = 1;
-				        } break;
-
-				        case SDLK_q:
-				        {
-					        keys_state[4] = 1;
-				        } break;
-
-				        case SDLK_w:
-				        {
-					        keys_state[5] = 1;
-				        } break;
-
-				        case SDLK_e:
-				        {
-					        keys_state[6] = 1;
-				        } break;
-
-				        case SDLK_a:
-				        {
-					        keys_state[7] = 1;
-				        } break;
-
-				        case SDLK_s:
-				        {
-					        keys_state[8] = 1;
-				        } break;
-
-				        case SDLK_d:
-				        {
-					        keys_state[9] = 1;
-				        } break;
-
-				        case SDLK_z:
-				        {
-					        keys_state[0xA] = 1;
-				        } break;
-
-				        case SDLK_c:
-				        {
-					        keys_state[0xB] = 1;
-				        } break;
-
-				        case SDLK_4:
-				        {
-					        keys_state[0xC] = 1;
-				        } break;
-
-				        case SDLK_r:
-				        {
-					        keys_state[0xD] = 1;
-				        } break;
-
-				        case SDLK_f:
-				        {
-					        keys_state[0xE] = 1;
-				        } break;
-
-				        case SDLK_v:
-				        {
-					        keys_state[0xF] = 1;
-				        } break;
-				    }
-			    } break;
-
-			    case SDL_KEYUP:
-			    {
-				    switch (event.key.keysym.sym)
-				    {
-				        case SDLK_x:
-				        {
-					        keys_state[0] = 0;
-				        } break;
-
-				        case SDLK_1:
-				        {
-					        keys_state[1] = 0;
-				        } break;
-
-				        case SDLK_2:
-				        {
-					        keys_state[2] = 0;
-				        } break;
-
-				        case SDLK_3:
-				        {
-					        keys_state[3] = 0;
-				        } break;
-
-				        case SDLK_q:
-				        {
-					        keys_state[4] = 0;
-				        } break;
-
-				        case SDLK_w:
-				        {
-					        keys_state[5] = 0;
-				        } break;
-
-				        case SDLK_e:
-				        {
-					        keys_state[6] = 0;
-				        } break;
-
-				        case SDLK_a:
-				        {
-					        keys_state[7] = 0;
-				        } break;
-
-						case SDLK_s:
-						{
-							keys_state[8] = 0;
-						} break;
-
-						case SDLK_d:
-						{
-							keys_state[9] = 0;
-						} break;
-
-						case SDLK_z:
-						{
-							keys_state[0xA] = 0;
-						} break;
-
-						case SDLK_c:
-						{
-							keys_state[0xB] = 0;
-						} break;
-
-						case SDLK_4:
-						{
-							keys_state[0xC] = 0;
-						} break;
-
-						case SDLK_r:
-						{
-							keys_state[0xD] = 0;
-						} break;
-
-						case SDLK_f:
-						{
-							keys_state[0xE] = 0;
-						} break;
-
-						case SDLK_v:
-						{
-							keys_state[0xF] = 0;
-						} break;
-					}
-				} break;
+				mask = down ? state.mask | (1U << key_lookup[code]) : state.mask & ~(1U << key_lookup[code]);
+
+				/* Key repeat and releases of keys that were not down are not changes, and are not timed */
+				if (mask != state.mask)
+				{
+					state.mask = mask;
+					state.serial = latency.KeyChanged();
+					keypad.store(state, std::memory_order_release);
+				}
 			}
 		}
 
 		return quit;
 	}
+
+	bool Chip8Display::WaitForInput(int timeout_ms)
+	{
+		return SDL_WaitEventTimeout(NULL, timeout_ms) != 0;
+	}
+
+	void Chip8Display::PostFrameReady()
+	{
+		SDL_Event event = { };
+
+		if (frame_event == (Uint32)-1 || frame_event_pending.exchange(true, std::memory_order_relaxed))
+			return;
+
+		event.type = frame_event;
+
+		if (SDL_PushEvent(&event) < 1)
+			frame_event_pending.store(false, std::memory_order_relaxed);
+	}
+
+	KeypadState Chip8Display::GetKeypad() const
+	{
+		return keypad.load(std::memory_order_acquire);
+	}
+
+	bool Chip8Display::IsTurboHeld() const
+	{
+		return turbo_held.load(std::memory_order_relaxed);
+	}
+
+	bool Chip8Display::IsRewindHeld() const
+	{
+		return rewind_held.load(std::memory_order_relaxed);
+	}
+
+	LatencyStats Chip8Display::GetInputLatency() const
+	{
+		return latency.GetStats();
+	}
 }
@@ -1,21 +1,136 @@
 #include "SDL.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "beeper.h"
+#include "latency.h"
+#include "postprocess.h"
 
 namespace CHIP8 
 {
+	/* The keypad as one atomic word: a bit per key, and the serial of the change that produced it */
+	struct KeypadState
+	{
+		uint16_t mask;
+		uint16_t serial;
+	};
+
 	class Chip8Display
 	{
 		private:
 
+			static const unsigned int KEYMAP_SIZE = 128;
+
 			SDL_Window* window;
 			SDL_Renderer* renderer;
 			SDL_Texture* texture;
 
+			/* Zero until OpenAudio succeeds */
+			SDL_AudioDeviceID audio_device;
+
+			/* User event PostFrameReady queues, and whether one is queued and not yet handled */
+			Uint32 frame_event;
+			std::atomic<bool> frame_event_pending;
+
+			int texture_width;
+			int texture_height;
+
+			/* RGBA staging buffer the packed framebuffer is expanded into before upload */
+			std::vector<uint32_t> pixels;
+
+			/* Set when post-processing is on. Its output goes to scaled_texture, created at the output size. */
+			std::unique_ptr<Chip8PostProcess> post_process;
+			SDL_Texture* scaled_texture;
+			int scaled_width;
+			int scaled_height;
+
+			/* Fit the post-processor to the window, then upload its output */
+			void UploadProcessed();
+
+			/* Keycodes below KEYMAP_SIZE (ASCII) that drive keypad keys, mapped to the key, or -1 */
+			int8_t key_lookup[KEYMAP_SIZE];
+
+			/* Written by HandleInput, read by the emulation thread */
+			std::atomic<KeypadState> keypad;
+
+			/* Fast-forward (Tab) and rewind (Backspace) key state as of the last HandleInput */
+			std::atomic<bool> turbo_held;
+			std::atomic<bool> rewind_held;
+
+			Chip8InputLatency latency;
+
 		public:
 
 			Chip8Display(const char* title, int window_width, int window_height, int texture_width, int texture_height);
 			~Chip8Display();
 
-			void UpdateDisplay(const void* display_state, int pitch);
-			bool HandleInput(uint8_t* keys_state);
+			/*
+			 * Expand rows first_row to last_row of a width x height 1bpp framebuffer (width / 64 words per row) and
+			 * upload them. With an XO-CHIP second plane the two are composited in four colours, otherwise plane0 is
+			 * drawn white on black. The texture is recreated when the resolution changes; the caller redraws every
+			 * row then. With post-processing on, the whole frame is processed whatever rows changed.
+			 */
+			void UpdateDisplay(const uint64_t* plane0, const uint64_t* plane1, unsigned int width, unsigned int height,
+				unsigned int first_row, unsigned int last_row);
+
+			/*
+			 * Start playing beeper on the default output at its sample rate, with a device buffer of its
+			 * GetBufferSamples(). The SDL callback only reads the beeper's ring, so beeper must outlive the display.
+			 * Returns false if there is no audio device.
+			 */
+			bool OpenAudio(Chip8Beeper& beeper);
+
+			/*
+			 * Run every frame through phosphor persistence, upscaling and scanlines on the CPU from now on. Without a
+			 * call none of it runs, and frames go to the GPU at native resolution as before.
+			 */
+			void SetPostProcess(const PostProcessSettings& settings);
+
+			/* True while the phosphor is still fading towards the last frame, so Refresh and Present would change the picture */
+			bool IsFading() const;
+
+			/* Fade the last frame one step further and upload it */
+			void Refresh();
+
+			/*
+			 * Draw the texture to the window. input_serial is the KeypadState serial the frame was emulated with;
+			 * every keypad change up to it is timed as on screen once this returns.
+			 */
+			void Present(uint16_t input_serial);
+
+			/*
+			 * Bind keypad keys 0 to F to the 16 characters of keys. The default, "x123qweasdzc4rfv", lays them out on
+			 * the left of a QWERTY keyboard like the COSMAC VIP's hex keypad. Returns false, keeping the current map,
+			 * unless keys is 16 different letters, digits or punctuation.
+			 */
+			bool SetKeymap(const char* keys);
+
+			/* Drain queued events into the keypad and hotkey state. Returns true if the user asked to quit. */
+			bool HandleInput();
+
+			/*
+			 * Block until an event is queued, leaving it for HandleInput, or timeout_ms passes. Returns false if
+			 * nothing arrived.
+			 */
+			bool WaitForInput(int timeout_ms);
+
+			/*
+			 * Wake WaitForInput because a new frame is ready. Safe to call from any thread; only one wakeup is
+			 * queued at a time, however often it is called.
+			 */
+			void PostFrameReady();
+
+			/* The keypad as of the last HandleInput. Safe to call from any thread. */
+			KeypadState GetKeypad() const;
+
+			/* True while the fast-forward key is held down. Safe to call from any thread, as is IsRewindHeld. */
+			bool IsTurboHeld() const;
+
+			/* True while the rewind key is held down */
+			bool IsRewindHeld() const;
+
+			/* Input-to-photon latency of the keypad changes presented so far */
+			LatencyStats GetInputLatency() const;
 	};
 }
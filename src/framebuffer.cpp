@@ -0,0 +1,115 @@
+#include "framebuffer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHIP8_FRAMEBUFFER_SSE2 1
+#include <emmintrin.h>
+#else
+#define CHIP8_FRAMEBUFFER_SSE2 0
+#endif
+
+namespace CHIP8
+{
+	void ExpandFramebuffer(const uint64_t* rows, unsigned int width, unsigned int height,
+		uint32_t* pixels, size_t pitch, uint32_t on, uint32_t off)
+	{
+		unsigned int words = (width + 63) / 64;
+		unsigned int row, column;
+
+		for (row = 0; row < height; row++)
+		{
+			const uint64_t* bits = rows + row * words;
+			uint32_t* out = pixels + row * pitch;
+
+			column = 0;
+
+#if CHIP8_FRAMEBUFFER_SSE2
+			const __m128i on_pixels = _mm_set1_epi32((int)on);
+			const __m128i off_pixels = _mm_set1_epi32((int)off);
+			const __m128i high_bits = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+			const __m128i low_bits = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+
+			/* Eight pixels per step: broadcast the byte, then turn each lane's bit into an all-ones mask */
+			for (; column + 8 <= width; column += 8)
+			{
+				__m128i byte = _mm_set1_epi32((int)((bits[column / 64] >> (56 - column % 64)) & 0xFFU));
+				__m128i high = _mm_cmpeq_epi32(_mm_and_si128(byte, high_bits), high_bits);
+				__m128i low = _mm_cmpeq_epi32(_mm_and_si128(byte, low_bits), low_bits);
+
+				_mm_storeu_si128((__m128i*)(out + column),
+					_mm_or_si128(_mm_and_si128(high, on_pixels), _mm_andnot_si128(high, off_pixels)));
+				_mm_storeu_si128((__m128i*)(out + column + 4),
+					_mm_or_si128(_mm_and_si128(low, on_pixels), _mm_andnot_si128(low, off_pixels)));
+			}
+#endif
+
+			for (; column < width; column++)
+				out[column] = (bits[column / 64] >> (63 - column % 64)) & 1U ? on : off;
+		}
+	}
+
+#if CHIP8_FRAMEBUFFER_SSE2
+	/* All-ones in each 32-bit lane whose bit of byte is set: high nibble for the first four pixels, low for the rest */
+	static inline void ExpandMasks(unsigned int byte, __m128i& high, __m128i& low)
+	{
+		const __m128i high_bits = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+		const __m128i low_bits = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+		__m128i value = _mm_set1_epi32((int)byte);
+
+		high = _mm_cmpeq_epi32(_mm_and_si128(value, high_bits), high_bits);
+		low = _mm_cmpeq_epi32(_mm_and_si128(value, low_bits), low_bits);
+	}
+
+	/* Pick palette[a | b << 1] per lane from the two planes' masks */
+	static inline __m128i SelectColours(__m128i a, __m128i b, const __m128i colours[4])
+	{
+		__m128i first = _mm_or_si128(_mm_and_si128(a, colours[1]), _mm_andnot_si128(a, colours[0]));
+		__m128i second = _mm_or_si128(_mm_and_si128(a, colours[3]), _mm_andnot_si128(a, colours[2]));
+
+		return _mm_or_si128(_mm_and_si128(b, second), _mm_andnot_si128(b, first));
+	}
+#endif
+
+	void ExpandPlanes(const uint64_t* plane0, const uint64_t* plane1, unsigned int width, unsigned int height,
+		uint32_t* pixels, size_t pitch, const uint32_t palette[4])
+	{
+		unsigned int words = (width + 63) / 64;
+		unsigned int row, column;
+
+#if CHIP8_FRAMEBUFFER_SSE2
+		const __m128i colours[4] =
+		{
+			_mm_set1_epi32((int)palette[0]), _mm_set1_epi32((int)palette[1]),
+			_mm_set1_epi32((int)palette[2]), _mm_set1_epi32((int)palette[3])
+		};
+#endif
+
+		for (row = 0; row < height; row++)
+		{
+			const uint64_t* bits0 = plane0 + row * words;
+			const uint64_t* bits1 = plane1 + row * words;
+			uint32_t* out = pixels + row * pitch;
+
+			column = 0;
+
+#if CHIP8_FRAMEBUFFER_SSE2
+			for (; column + 8 <= width; column += 8)
+			{
+				__m128i high0, low0, high1, low1;
+
+				ExpandMasks((unsigned int)(bits0[column / 64] >> (56 - column % 64)) & 0xFFU, high0, low0);
+				ExpandMasks((unsigned int)(bits1[column / 64] >> (56 - column % 64)) & 0xFFU, high1, low1);
+
+				_mm_storeu_si128((__m128i*)(out + column), SelectColours(high0, high1, colours));
+				_mm_storeu_si128((__m128i*)(out + column + 4), SelectColours(low0, low1, colours));
+			}
+#endif
+
+			for (; column < width; column++)
+			{
+				unsigned int shift = 63 - column % 64;
+
+				out[column] = palette[((bits0[column / 64] >> shift) & 1U) | (((bits1[column / 64] >> shift) & 1U) << 1)];
+			}
+		}
+	}
+}
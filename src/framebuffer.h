@@ -0,0 +1,26 @@
+#ifndef _FRAMEBUFFER_H_
+#define _FRAMEBUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace CHIP8
+{
+	/*
+	 * Expand a 1bpp framebuffer into 32-bit pixels. Each row is (width + 63) / 64 consecutive 64-bit words with
+	 * the leftmost pixel in the most significant bit of the first. Set pixels become on and clear pixels become off.
+	 * pitch is the distance between output rows in pixels. Uses SSE2 where available.
+	 */
+	void ExpandFramebuffer(const uint64_t* rows, unsigned int width, unsigned int height,
+		uint32_t* pixels, size_t pitch, uint32_t on, uint32_t off);
+
+	/*
+	 * Composite two XO-CHIP bitplanes laid out like ExpandFramebuffer's rows into 32-bit pixels. A pixel's colour
+	 * is palette[plane0 bit | plane1 bit << 1], so palette[0] is the background and palette[3] where both overlap.
+	 * Each step selects eight pixels' colours with masks, the SSE2 path as above.
+	 */
+	void ExpandPlanes(const uint64_t* plane0, const uint64_t* plane1, unsigned int width, unsigned int height,
+		uint32_t* pixels, size_t pitch, const uint32_t palette[4]);
+}
+
+#endif
@@ -0,0 +1,405 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "batch.h"
+#include "rombundle.h"
+
+/*
+ * Golden regression harness. Runs every ROM for a fixed number of frames with a fixed seed and scripted input
+ * across all cores, hashes the framebuffer at regular checkpoints and compares the hashes and each ROM's
+ * instructions/sec against a golden file. Any hash that differs fails the run, and so does a ROM (or the
+ * corpus as a whole) running more than --max-slowdown percent slower than its baseline. With --update, or
+ * when GOLDEN does not exist yet, the results are written to GOLDEN instead.
+ *
+ * Usage: chip8-golden [--frames N] [--ipf N] [--every N] [--repeat N] [--threads N] [--engine table|cached|jit]
+ *                     [--input LOG] [--max-slowdown PCT] [--update] GOLDEN ROM|DIR|BUNDLE...
+ *
+ * GOLDEN is plain text: a header line with the run settings, then one line per ROM of tab-separated
+ * checkpoint hashes, baseline instructions/sec and name. Hashes do not depend on the engine, so a golden
+ * file written with one engine checks all of them.
+ */
+
+static const int GOLDEN_VERSION = 1;
+
+static const uint32_t RNG_SEED = 1;
+
+/* ROMs whose baseline run took less than this are too quick to time reliably and only count in the total */
+static const double MIN_TIMED_SECONDS = 0.01;
+
+struct GoldenSettings
+{
+	uint64_t frames;
+	uint64_t instructions_per_frame;
+	uint64_t every;
+	uint32_t seed;
+	uint64_t input_hash;
+};
+
+struct GoldenEntry
+{
+	std::vector<uint64_t> hashes;
+	double ips;
+};
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: chip8-golden [--frames N] [--ipf N] [--every N] [--repeat N] [--threads N] [--engine table|cached|jit]" << std::endl;
+	std::cerr << "                    [--input LOG] [--max-slowdown PCT] [--update] GOLDEN ROM|DIR|BUNDLE..." << std::endl;
+}
+
+/* Every 30 frames press the next key for 5 frames, the same script as chip8-bench */
+static void BuildDefaultInput(CHIP8::Chip8InputLog& input, uint64_t frames)
+{
+	uint64_t frame;
+
+	input.Start(RNG_SEED, 0, 0);
+
+	for (frame = 0; frame < frames; frame++)
+		input.Record(frame, frame % 30 < 5 ? (uint16_t)(1U << ((frame / 30) % CHIP8::Chip8Processor::INPUT_KEYS)) : 0);
+}
+
+/* Fingerprint of the keys held in every frame, so a golden file is never checked against different input */
+static uint64_t HashInput(CHIP8::Chip8InputLog& input, uint64_t frames)
+{
+	std::vector<uint8_t> keys;
+	uint64_t frame;
+
+	for (frame = 0; frame < frames; frame++)
+	{
+		uint16_t mask = input.GetKeys(frame);
+
+		keys.push_back((uint8_t)mask);
+		keys.push_back((uint8_t)(mask >> 8));
+	}
+
+	return CHIP8::HashRom(keys.data(), keys.size());
+}
+
+static std::string FormatSettings(const GoldenSettings& settings)
+{
+	char line[192];
+
+	snprintf(line, sizeof(line), "chip8-golden %d frames=%llu ipf=%llu every=%llu seed=%08x input=%016llx", GOLDEN_VERSION,
+		(unsigned long long)settings.frames, (unsigned long long)settings.instructions_per_frame,
+		(unsigned long long)settings.every, settings.seed, (unsigned long long)settings.input_hash);
+
+	return line;
+}
+
+/* Returns false if the file cannot be read. settings_line is left empty if the file is malformed. */
+static bool ReadGolden(const char* path, std::string& settings_line, std::map<std::string, GoldenEntry>& entries)
+{
+	std::ifstream file(path);
+	std::string line;
+
+	if (!file)
+		return false;
+
+	std::getline(file, settings_line);
+
+	while (std::getline(file, line))
+	{
+		size_t first = line.find('\t');
+		size_t second = first == std::string::npos ? first : line.find('\t', first + 1);
+
+		if (second == std::string::npos)
+		{
+			settings_line.clear();
+			break;
+		}
+
+		GoldenEntry& entry = entries[line.substr(second + 1)];
+		std::istringstream hashes(line.substr(0, first));
+		std::string hash;
+
+		while (hashes >> hash)
+			entry.hashes.push_back(strtoull(hash.c_str(), NULL, 16));
+
+		entry.ips = strtod(line.c_str() + first + 1, NULL);
+	}
+
+	return true;
+}
+
+static bool WriteGolden(const char* path, const GoldenSettings& settings, const std::map<std::string, GoldenEntry>& entries)
+{
+	std::ofstream file(path);
+	char hash[32];
+
+	file << FormatSettings(settings) << "\n";
+
+	for (const auto& rom : entries)
+	{
+		size_t i;
+
+		for (i = 0; i < rom.second.hashes.size(); i++)
+		{
+			snprintf(hash, sizeof(hash), "%s%016llx", i ? " " : "", (unsigned long long)rom.second.hashes[i]);
+			file << hash;
+		}
+
+		file << "\t" << (uint64_t)rom.second.ips << "\t" << rom.first << "\n";
+	}
+
+	return (bool)file.flush();
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<CHIP8::BatchJob> roms;
+	std::vector<std::unique_ptr<CHIP8::Chip8RomBundle>> bundles;
+	GoldenSettings settings = { 3600, 12, 300, RNG_SEED, 0 };
+	unsigned int threads = 0;
+	unsigned int repeat = 3;
+	double max_slowdown = 20.0;
+	bool update = false;
+	CHIP8::BatchEngine engine = CHIP8::ENGINE_TABLE;
+	const char* golden = NULL;
+	const char* input_file = NULL;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		bool has_value = i + 1 < argc;
+
+		if (!strcmp(argv[i], "--frames") && has_value)
+			settings.frames = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--ipf") && has_value)
+			settings.instructions_per_frame = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--every") && has_value)
+			settings.every = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--repeat") && has_value)
+			repeat = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--threads") && has_value)
+			threads = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--input") && has_value)
+			input_file = argv[++i];
+		else if (!strcmp(argv[i], "--max-slowdown") && has_value)
+			max_slowdown = strtod(argv[++i], NULL);
+		else if (!strcmp(argv[i], "--update"))
+			update = true;
+		else if (!strcmp(argv[i], "--engine") && has_value)
+		{
+			const char* name = argv[++i];
+
+			if (!strcmp(name, "table"))
+				engine = CHIP8::ENGINE_TABLE;
+			else if (!strcmp(name, "cached"))
+				engine = CHIP8::ENGINE_DECODE_CACHE;
+			else if (!strcmp(name, "jit"))
+				engine = CHIP8::ENGINE_JIT;
+			else
+			{
+				PrintUsage();
+				return EXIT_FAILURE;
+			}
+		}
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+		else if (!golden)
+			golden = argv[i];
+		else if (CHIP8::IsRomBundle(argv[i]))
+		{
+			bundles.emplace_back(new CHIP8::Chip8RomBundle());
+
+			if (!bundles.back()->Open(argv[i]))
+			{
+				std::cerr << "Error: Unable to open bundle " << argv[i] << std::endl;
+				return EXIT_FAILURE;
+			}
+
+			for (size_t e = 0; e < bundles.back()->GetCount(); e++)
+				roms.push_back({ bundles.back()->GetEntry(e).name, 0, bundles.back()->GetEntry(e).image });
+		}
+		else
+		{
+			std::vector<std::string> files;
+
+			CHIP8::CollectRoms(argv[i], files);
+
+			for (const std::string& file : files)
+				roms.push_back({ file, 0, { NULL, 0 } });
+		}
+	}
+
+	if (!golden || roms.empty() || settings.frames == 0 || settings.instructions_per_frame == 0 || settings.every == 0 || repeat == 0)
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	CHIP8::Chip8InputLog input;
+
+	if (input_file && !input.Load(input_file))
+	{
+		std::cerr << "Error: Unable to read input " << input_file << std::endl;
+		return EXIT_FAILURE;
+	}
+	else if (!input_file)
+		BuildDefaultInput(input, settings.frames);
+
+	/* A recorded session replays with the seed it was recorded with */
+	settings.seed = input.GetSeed();
+	settings.input_hash = HashInput(input, settings.frames);
+
+	CHIP8::BatchScript script = { settings.seed, &input, {} };
+	uint64_t checkpoint;
+
+	for (checkpoint = settings.every; checkpoint <= settings.frames; checkpoint += settings.every)
+		script.checkpoints.push_back(checkpoint);
+
+	/* Every ROM runs repeat times and keeps its fastest run, with the copies spread over the pool like any other job */
+	std::vector<CHIP8::BatchJob> jobs;
+	std::vector<CHIP8::BatchResult> results;
+	std::vector<CHIP8::BatchWorkerStats> workers;
+
+	for (const CHIP8::BatchJob& rom : roms)
+	{
+		unsigned int copy;
+
+		for (copy = 0; copy < repeat; copy++)
+			jobs.push_back({ rom.rom, copy, rom.image });
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	CHIP8::RunBatch(jobs, settings.frames, settings.instructions_per_frame, engine, threads, script, results, workers);
+	double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::map<std::string, GoldenEntry> current;
+	size_t failures = 0;
+
+	for (const CHIP8::BatchResult& result : results)
+	{
+		if (!result.loaded)
+		{
+			if (result.copy == 0)
+				failures++;
+
+			continue;
+		}
+
+		GoldenEntry& entry = current[result.rom];
+		double ips = result.seconds > 0.0 ? result.cycles / result.seconds : 0.0;
+
+		if (result.copy == 0)
+			entry = { result.checkpoint_hashes, ips };
+		else if (result.checkpoint_hashes != entry.hashes)
+		{
+			std::cout << "FAIL nondeterministic " << result.rom << std::endl;
+			failures++;
+		}
+		else if (ips > entry.ips)
+			entry.ips = ips;
+	}
+
+	std::string settings_line;
+	std::map<std::string, GoldenEntry> baseline;
+
+	if (update || !ReadGolden(golden, settings_line, baseline))
+	{
+		if (failures)
+		{
+			std::cerr << "Error: " << failures << " ROMs failed to load or ran nondeterministically, not writing " << golden << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		if (!WriteGolden(golden, settings, current))
+		{
+			std::cerr << "Error: Unable to write " << golden << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		std::cerr << "Wrote " << current.size() << " ROMs to " << golden << " in " << wall_seconds << " s" << std::endl;
+		return EXIT_SUCCESS;
+	}
+
+	if (settings_line != FormatSettings(settings))
+	{
+		std::cerr << "Error: " << golden << " was written with different settings or is malformed, rerun with --update" << std::endl;
+		std::cerr << "  golden:  " << settings_line << std::endl;
+		std::cerr << "  current: " << FormatSettings(settings) << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	double baseline_seconds = 0.0;
+	double current_seconds = 0.0;
+	size_t mismatches = 0;
+	size_t slowdowns = 0;
+	size_t missing = 0;
+	double work = (double)(settings.frames * settings.instructions_per_frame);
+
+	for (const auto& rom : current)
+	{
+		auto found = baseline.find(rom.first);
+
+		if (found == baseline.end())
+		{
+			std::cout << "NEW " << rom.first << std::endl;
+			continue;
+		}
+
+		const GoldenEntry& expected = found->second;
+		size_t c;
+
+		for (c = 0; c < rom.second.hashes.size() && c < expected.hashes.size(); c++)
+		{
+			if (rom.second.hashes[c] != expected.hashes[c])
+				break;
+		}
+
+		if (c < rom.second.hashes.size() || c < expected.hashes.size())
+		{
+			std::cout << "FAIL render " << rom.first << ": framebuffer differs at frame "
+				<< (c < script.checkpoints.size() ? script.checkpoints[c] : settings.frames) << std::endl;
+			mismatches++;
+		}
+
+		if (expected.ips <= 0.0 || rom.second.ips <= 0.0)
+			continue;
+
+		baseline_seconds += work / expected.ips;
+		current_seconds += work / rom.second.ips;
+
+		if (work / expected.ips >= MIN_TIMED_SECONDS && rom.second.ips < expected.ips * (1.0 - max_slowdown / 100.0))
+		{
+			std::cout << "FAIL slow " << rom.first << ": " << (uint64_t)rom.second.ips << " ips, baseline "
+				<< (uint64_t)expected.ips << " (" << (int)(100.0 - 100.0 * rom.second.ips / expected.ips) << "% slower)" << std::endl;
+			slowdowns++;
+		}
+	}
+
+	for (const auto& rom : baseline)
+	{
+		if (!current.count(rom.first))
+		{
+			std::cout << "MISSING " << rom.first << std::endl;
+			missing++;
+		}
+	}
+
+	/* Total time over the ROMs both runs timed, which still catches a slowdown spread thinly over many short ROMs */
+	double total_change = baseline_seconds > 0.0 ? 100.0 * (current_seconds - baseline_seconds) / baseline_seconds : 0.0;
+
+	if (total_change > max_slowdown)
+	{
+		std::cout << "FAIL slow corpus: " << current_seconds << " s, baseline " << baseline_seconds << " s" << std::endl;
+		slowdowns++;
+	}
+
+	std::cout << current.size() << " ROMs, " << mismatches << " render mismatches, " << slowdowns << " slowdowns, "
+		<< missing << " missing, " << failures << " other failures; corpus time " << (total_change >= 0.0 ? "+" : "")
+		<< total_change << "%, wall " << wall_seconds << " s on " << workers.size() << " threads" << std::endl;
+
+	return mismatches || slowdowns || missing || failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
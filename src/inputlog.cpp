@@ -0,0 +1,207 @@
+#include "inputlog.h"
+#include <cstdio>
+#include <cstring>
+
+namespace CHIP8
+{
+	static void PutLE(std::vector<uint8_t>& out, uint64_t value, unsigned int bytes)
+	{
+		unsigned int i;
+
+		for (i = 0; i < bytes; i++)
+			out.push_back((uint8_t)(value >> (8 * i)));
+	}
+
+	static uint64_t GetLE(const uint8_t* in, unsigned int bytes)
+	{
+		uint64_t value = 0;
+		unsigned int i;
+
+		for (i = 0; i < bytes; i++)
+			value |= (uint64_t)in[i] << (8 * i);
+
+		return value;
+	}
+
+	static void PutVarint(std::vector<uint8_t>& out, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+
+		out.push_back((uint8_t)value);
+	}
+
+	/* Returns false if the input ends in the middle of the varint or it does not fit in 64 bits */
+	static bool GetVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value)
+	{
+		unsigned int shift = 0;
+
+		value = 0;
+
+		while (in < end && shift < 64)
+		{
+			uint8_t byte = *in++;
+
+			value |= (uint64_t)(byte & 0x7F) << shift;
+
+			if (!(byte & 0x80))
+				return true;
+
+			shift += 7;
+		}
+
+		return false;
+	}
+
+	#pragma region Chip8InputLog
+
+	Chip8InputLog::Chip8InputLog()
+	{
+		Start(0, 0, 0);
+	}
+
+	void Chip8InputLog::Start(uint32_t seed, uint32_t instructions_per_second, uint64_t rom_hash)
+	{
+		this->seed = seed;
+		this->instructions_per_second = instructions_per_second;
+		this->rom_hash = rom_hash;
+		frames = 0;
+		events.clear();
+		cursor = 0;
+	}
+
+	void Chip8InputLog::Record(uint64_t frame, uint16_t keys)
+	{
+		/* Only changes are stored; the keypad starts out released */
+		if (events.empty() ? keys != 0 : keys != events.back().keys)
+			events.push_back({ frame, keys });
+
+		if (frame + 1 > frames)
+			frames = frame + 1;
+	}
+
+	uint16_t Chip8InputLog::GetKeys(uint64_t frame)
+	{
+		if (events.empty() || frame < events[0].frame)
+			return 0;
+
+		if (cursor >= events.size() || frame < events[cursor].frame)
+			cursor = 0;
+
+		while (cursor + 1 < events.size() && events[cursor + 1].frame <= frame)
+			cursor++;
+
+		return events[cursor].keys;
+	}
+
+	uint32_t Chip8InputLog::GetSeed() const
+	{
+		return seed;
+	}
+
+	uint32_t Chip8InputLog::GetInstructionsPerSecond() const
+	{
+		return instructions_per_second;
+	}
+
+	uint64_t Chip8InputLog::GetRomHash() const
+	{
+		return rom_hash;
+	}
+
+	uint64_t Chip8InputLog::GetFrameCount() const
+	{
+		return frames;
+	}
+
+	size_t Chip8InputLog::GetEventCount() const
+	{
+		return events.size();
+	}
+
+	#pragma endregion
+
+	#pragma region Files
+
+	bool Chip8InputLog::Save(const char* path) const
+	{
+		std::vector<uint8_t> data;
+		uint64_t previous = 0;
+		FILE* file;
+		bool written;
+
+		data.insert(data.end(), { 'C', '8', 'I', 'R' });
+		PutLE(data, VERSION, 2);
+		PutLE(data, 0, 2);
+		PutLE(data, seed, 4);
+		PutLE(data, instructions_per_second, 4);
+		PutLE(data, rom_hash, 8);
+		PutLE(data, frames, 8);
+
+		for (const Event& event : events)
+		{
+			PutVarint(data, event.frame - previous);
+			PutLE(data, event.keys, 2);
+			previous = event.frame;
+		}
+
+		if ((file = fopen(path, "wb")) == NULL)
+			return false;
+
+		written = fwrite(data.data(), 1, data.size(), file) == data.size();
+
+		return fclose(file) == 0 && written;
+	}
+
+	bool Chip8InputLog::Load(const char* path)
+	{
+		std::vector<uint8_t> data;
+		uint8_t buffer[4096];
+		uint64_t frame = 0;
+		FILE* file;
+		size_t size;
+
+		Start(0, 0, 0);
+
+		if ((file = fopen(path, "rb")) == NULL)
+			return false;
+
+		while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			data.insert(data.end(), buffer, buffer + size);
+
+		fclose(file);
+
+		if (data.size() < HEADER_SIZE || memcmp(data.data(), "C8IR", 4) || GetLE(&data[4], 2) != VERSION)
+			return false;
+
+		const uint8_t* in = data.data() + HEADER_SIZE;
+		const uint8_t* end = data.data() + data.size();
+
+		while (in < end)
+		{
+			uint64_t delta;
+
+			if (!GetVarint(in, end, delta) || end - in < 2)
+			{
+				Start(0, 0, 0);
+				return false;
+			}
+
+			frame += delta;
+			events.push_back({ frame, (uint16_t)GetLE(in, 2) });
+			in += 2;
+		}
+
+		seed = (uint32_t)GetLE(&data[8], 4);
+		instructions_per_second = (uint32_t)GetLE(&data[12], 4);
+		rom_hash = GetLE(&data[16], 8);
+		frames = GetLE(&data[24], 8);
+
+		return true;
+	}
+
+	#pragma endregion
+}
@@ -0,0 +1,72 @@
+#ifndef _INPUTLOG_H_
+#define _INPUTLOG_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace CHIP8
+{
+	/*
+	 * A recorded session: the CXNN seed, the instruction rate and a hash of the ROM it was played on, plus the
+	 * keypad as a stream of changes indexed by emulated frame. A machine booted from the same ROM and seed and
+	 * fed the same keys before the same frames retraces the session exactly, whatever engine runs it.
+	 *
+	 * File layout, little-endian: a 32-byte header ("C8IR", version, seed, instructions per second, ROM hash,
+	 * frame count), then one event per keypad change: a varint of frames since the previous change followed by
+	 * the 16-bit key mask. A 10-minute session is typically a few hundred bytes.
+	 */
+	class Chip8InputLog
+	{
+		public:
+			static const uint16_t VERSION = 1;
+
+		private:
+			static const size_t HEADER_SIZE = 32;
+
+			/* The keys held from frame onwards */
+			struct Event
+			{
+				uint64_t frame;
+				uint16_t keys;
+			};
+
+			uint32_t seed;
+			uint32_t instructions_per_second;
+			uint64_t rom_hash;
+			uint64_t frames;
+			std::vector<Event> events;
+
+			/* Playback position: index of the event in effect at the last frame asked for */
+			size_t cursor;
+
+		public:
+			Chip8InputLog();
+
+			/* Drop any events and start a recording with the given session parameters */
+			void Start(uint32_t seed, uint32_t instructions_per_second, uint64_t rom_hash);
+
+			/* Note the keys held while frame runs. Frames must be recorded in increasing order. */
+			void Record(uint64_t frame, uint16_t keys);
+
+			/* Keys held while frame runs. Fastest when frames are asked for in increasing order. */
+			uint16_t GetKeys(uint64_t frame);
+
+			uint32_t GetSeed() const;
+			uint32_t GetInstructionsPerSecond() const;
+			uint64_t GetRomHash() const;
+
+			/* Number of frames recorded */
+			uint64_t GetFrameCount() const;
+
+			/* Number of keypad changes recorded */
+			size_t GetEventCount() const;
+
+			bool Save(const char* path) const;
+
+			/* Returns false, leaving the log empty, if the file is missing, truncated or from another version */
+			bool Load(const char* path);
+	};
+}
+
+#endif
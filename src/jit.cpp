@@ -0,0 +1,345 @@
+#include "jit.h"
+#include <cstring>
+
+#if CHIP8_JIT_AVAILABLE
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+namespace CHIP8
+{
+	/* Marks an address whose first instruction cannot be translated, so it is not retried every cycle */
+	static const uint8_t UNTRANSLATABLE = 0xFF;
+
+	/* x86-64 register numbers used in ModRM encodings */
+	static const uint8_t REG_AL = 0;
+	static const uint8_t REG_CL = 1;
+
+	#pragma region Chip8Jit
+
+	Chip8Jit::Chip8Jit(Chip8Processor& chip8) : chip8(chip8), code(NULL), code_used(0), out(NULL)
+	{
+		const uint8_t* base = reinterpret_cast<const uint8_t*>(&chip8);
+
+		v_offset = (int32_t)(reinterpret_cast<const uint8_t*>(chip8.V) - base);
+		index_offset = (int32_t)(reinterpret_cast<const uint8_t*>(&chip8.index) - base);
+		pc_offset = (int32_t)(reinterpret_cast<const uint8_t*>(&chip8.pc) - base);
+
+#if CHIP8_JIT_AVAILABLE
+#if defined(_WIN32)
+		code = (uint8_t*)VirtualAlloc(NULL, CODE_BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+		void* mapping = mmap(NULL, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		code = mapping == MAP_FAILED ? NULL : (uint8_t*)mapping;
+#endif
+#endif
+
+		Flush();
+	}
+
+	Chip8Jit::~Chip8Jit()
+	{
+#if CHIP8_JIT_AVAILABLE
+		if (code)
+		{
+#if defined(_WIN32)
+			VirtualFree(code, 0, MEM_RELEASE);
+#else
+			munmap(code, CODE_BUFFER_SIZE);
+#endif
+		}
+#endif
+	}
+
+	bool Chip8Jit::Available() const
+	{
+		return code != NULL;
+	}
+
+	bool Chip8Jit::Protect(bool writable)
+	{
+#if CHIP8_JIT_AVAILABLE
+#if defined(_WIN32)
+		DWORD previous;
+
+		return VirtualProtect(code, CODE_BUFFER_SIZE, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &previous) != 0;
+#else
+		return mprotect(code, CODE_BUFFER_SIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) == 0;
+#endif
+#else
+		return false;
+#endif
+	}
+
+	void Chip8Jit::Flush()
+	{
+		memset(blocks, 0, sizeof(blocks));
+		memset(block_lengths, 0, sizeof(block_lengths));
+		memset(translated, 0, sizeof(translated));
+		code_used = 0;
+	}
+
+	void Chip8Jit::Invalidate(uint16_t address, unsigned int length)
+	{
+		unsigned int i;
+
+		for (i = address; i < (unsigned int)address + length && i < MEMORY_LOCATIONS; i++)
+		{
+			if (translated[i])
+			{
+				Flush();
+				return;
+			}
+		}
+	}
+
+	uint32_t Chip8Jit::Run(uint64_t budget)
+	{
+		uint16_t pc = chip8.pc;
+
+		if (!code || pc >= MEMORY_LOCATIONS - 1)
+			return 0;
+
+		if (!blocks[pc])
+		{
+			if (block_lengths[pc] == UNTRANSLATABLE)
+				return 0;
+
+			Compile(pc);
+
+			if (!blocks[pc])
+				return 0;
+		}
+
+		/* Blocks cannot stop part way through, so a block longer than the budget is left to the interpreter */
+		if (block_lengths[pc] > budget)
+			return 0;
+
+		return blocks[pc](&chip8);
+	}
+
+	void Chip8Jit::Execute(Chip8Processor* chip8, uint64_t packed)
+	{
+		Instruction in;
+
+		memcpy(&in, &packed, sizeof(in));
+		((*chip8).*(Chip8Processor::handlers[in.id]))(in);
+	}
+
+	#pragma endregion
+
+	#pragma region Compile
+
+	void Chip8Jit::Compile(uint16_t address)
+	{
+		const uint8_t* memory = chip8.memory;
+		uint16_t pc = address;
+		uint32_t count = 0;
+		bool ended = false;
+
+		if (code_used + MAX_INSTRUCTION_BYTES * (MAX_BLOCK_INSTRUCTIONS + 2) > CODE_BUFFER_SIZE)
+			Flush();
+
+		if (!Protect(true))
+			return;
+
+		out = code + code_used;
+		uint8_t* entry = out;
+
+		/* push rbx; sub rsp, 32; mov rbx, <first argument> */
+		Emit8(0x53);
+		Emit8(0x48); Emit8(0x83); Emit8(0xEC); Emit8(0x20);
+#if defined(_WIN32)
+		Emit8(0x48); Emit8(0x89); Emit8(0xCB);
+#else
+		Emit8(0x48); Emit8(0x89); Emit8(0xFB);
+#endif
+
+		while (!ended && count < MAX_BLOCK_INSTRUCTIONS && pc < MEMORY_LOCATIONS - 1)
+		{
+			Instruction in = Chip8Processor::Decode((memory[pc] << 8U) | memory[pc + 1]);
+
+			translated[pc] = 1;
+			translated[pc + 1] = 1;
+			pc += 2;
+			count++;
+
+			switch (in.id)
+			{
+				case OP_6XNN:
+				{
+					/* mov byte [rbx + VX], NN */
+					Emit8(0xC6); EmitMemoryOperand(0, v_offset + in.x); Emit8(in.nn);
+				} break;
+
+				case OP_7XNN:
+				{
+					/* add byte [rbx + VX], NN */
+					Emit8(0x80); EmitMemoryOperand(0, v_offset + in.x); Emit8(in.nn);
+				} break;
+
+				case OP_8XY0:
+				{
+					/* mov al, [rbx + VY]; mov [rbx + VX], al */
+					Emit8(0x8A); EmitMemoryOperand(REG_AL, v_offset + in.y);
+					Emit8(0x88); EmitMemoryOperand(REG_AL, v_offset + in.x);
+				} break;
+
+				case OP_8XY1:
+				case OP_8XY2:
+				case OP_8XY3:
+				{
+					/* mov al, [rbx + VY]; or/and/xor [rbx + VX], al */
+					Emit8(0x8A); EmitMemoryOperand(REG_AL, v_offset + in.y);
+					Emit8(in.id == OP_8XY1 ? 0x08 : in.id == OP_8XY2 ? 0x20 : 0x30);
+					EmitMemoryOperand(REG_AL, v_offset + in.x);
+				} break;
+
+				case OP_8XY4:
+				{
+					/* mov al, [rbx + VX]; add al, [rbx + VY]; setc cl; mov [rbx + VF], cl; mov [rbx + VX], al */
+					Emit8(0x8A); EmitMemoryOperand(REG_AL, v_offset + in.x);
+					Emit8(0x02); EmitMemoryOperand(REG_AL, v_offset + in.y);
+					Emit8(0x0F); Emit8(0x92); Emit8(0xC1);
+					Emit8(0x88); EmitMemoryOperand(REG_CL, v_offset + 0xF);
+					Emit8(0x88); EmitMemoryOperand(REG_AL, v_offset + in.x);
+				} break;
+
+				case OP_ANNN:
+				{
+					/* mov word [rbx + index], NNN */
+					Emit8(0x66); Emit8(0xC7); EmitMemoryOperand(0, index_offset); Emit16(in.nnn);
+				} break;
+
+				case OP_1NNN:
+				{
+					EmitStorePC(in.nnn);
+					ended = true;
+				} break;
+
+				case OP_00EE:
+				case OP_00FD:
+				case OP_2NNN:
+				case OP_3XNN:
+				case OP_4XNN:
+				case OP_5XY0:
+				case OP_9XY0:
+				case OP_BNNN:
+				case OP_EX9E:
+				case OP_EXA1:
+				case OP_FX0A:
+				case OP_FX33:
+				case OP_FX55:
+				case OP_5XY2:
+				case OP_5XY3:
+				case OP_F000:
+				{
+					/* Control flow and stores end the block; the handler sees pc as the interpreter would */
+					EmitStorePC(pc);
+					EmitCall(in);
+					ended = true;
+				} break;
+
+				default:
+				{
+					EmitCall(in);
+				} break;
+			}
+		}
+
+		if (count == 0)
+		{
+			block_lengths[address] = UNTRANSLATABLE;
+			translated[address] = 1;
+			Protect(false);
+			return;
+		}
+
+		if (!ended)
+			EmitStorePC(pc);
+
+		EmitReturn(count);
+
+		code_used = out - code;
+
+		if (!Protect(false))
+			return;
+
+		blocks[address] = reinterpret_cast<Block>(entry);
+		block_lengths[address] = (uint8_t)count;
+	}
+
+	#pragma endregion
+
+	#pragma region Emitters
+
+	void Chip8Jit::Emit8(uint8_t value)
+	{
+		*out++ = value;
+	}
+
+	void Chip8Jit::Emit16(uint16_t value)
+	{
+		Emit8(value & 0xFFU);
+		Emit8(value >> 8U);
+	}
+
+	void Chip8Jit::Emit32(uint32_t value)
+	{
+		Emit16(value & 0xFFFFU);
+		Emit16(value >> 16U);
+	}
+
+	void Chip8Jit::Emit64(uint64_t value)
+	{
+		Emit32(value & 0xFFFFFFFFU);
+		Emit32(value >> 32U);
+	}
+
+	/* ModRM for [rbx + disp32] with the given register field */
+	void Chip8Jit::EmitMemoryOperand(uint8_t reg, int32_t offset)
+	{
+		Emit8(0x80 | (reg << 3) | 0x3);
+		Emit32((uint32_t)offset);
+	}
+
+	void Chip8Jit::EmitCall(const Instruction& in)
+	{
+		uint64_t packed = 0;
+		memcpy(&packed, &in, sizeof(in));
+
+#if defined(_WIN32)
+		/* mov rcx, rbx; mov rdx, packed */
+		Emit8(0x48); Emit8(0x89); Emit8(0xD9);
+		Emit8(0x48); Emit8(0xBA); Emit64(packed);
+#else
+		/* mov rdi, rbx; mov rsi, packed */
+		Emit8(0x48); Emit8(0x89); Emit8(0xDF);
+		Emit8(0x48); Emit8(0xBE); Emit64(packed);
+#endif
+
+		/* mov rax, Execute; call rax */
+		Emit8(0x48); Emit8(0xB8); Emit64((uint64_t)(uintptr_t)&Chip8Jit::Execute);
+		Emit8(0xFF); Emit8(0xD0);
+	}
+
+	void Chip8Jit::EmitStorePC(uint16_t address)
+	{
+		/* mov word [rbx + pc], address */
+		Emit8(0x66); Emit8(0xC7); EmitMemoryOperand(0, pc_offset); Emit16(address);
+	}
+
+	void Chip8Jit::EmitReturn(uint32_t count)
+	{
+		/* mov eax, count; add rsp, 32; pop rbx; ret */
+		Emit8(0xB8); Emit32(count);
+		Emit8(0x48); Emit8(0x83); Emit8(0xC4); Emit8(0x20);
+		Emit8(0x5B);
+		Emit8(0xC3);
+	}
+
+	#pragma endregion
+}
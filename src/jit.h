@@ -0,0 +1,103 @@
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "chip8.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CHIP8_JIT_AVAILABLE 1
+#else
+#define CHIP8_JIT_AVAILABLE 0
+#endif
+
+namespace CHIP8
+{
+	/*
+	 * Translates straight-line Chip-8 basic blocks into x86-64 code. A block ends at a jump, call, return,
+	 * skip, FX0A or a store into memory (FX33/FX55). Simple ALU and load opcodes are emitted inline, everything
+	 * else calls back into the interpreter's handler.
+	 *
+	 * Each translated block returns the number of instructions it executed. Writes that land on translated
+	 * code flush every block; the interpreter in chip8.cpp stays the fallback for anything not translated.
+	 */
+	class Chip8Jit
+	{
+		private:
+			static const unsigned int MEMORY_LOCATIONS = 4096;
+			static const unsigned int MAX_BLOCK_INSTRUCTIONS = 64;
+			static const size_t CODE_BUFFER_SIZE = 1024 * 1024;
+
+			/* Worst case size of one translated instruction plus the block epilogue */
+			static const size_t MAX_INSTRUCTION_BYTES = 48;
+
+			typedef uint32_t (*Block)(Chip8Processor* chip8);
+
+			Chip8Processor& chip8;
+
+			/*
+			 * Memory that blocks are emitted into, bump allocated and flushed as a whole. It is never writable and
+			 * executable at once: Compile maps it read-write while it emits and read-execute again before any block
+			 * runs. Flush only resets the bookkeeping, since a store inside a running block can call it.
+			 */
+			uint8_t* code;
+			size_t code_used;
+
+			/* Entry point and instruction count of the block starting at each address */
+			Block blocks[MEMORY_LOCATIONS];
+			uint8_t block_lengths[MEMORY_LOCATIONS];
+
+			/* Nonzero for each address that was read while translating a block still in the cache */
+			uint8_t translated[MEMORY_LOCATIONS];
+
+			/* Offsets of the processor's registers from the Chip8Processor object */
+			int32_t v_offset;
+			int32_t index_offset;
+			int32_t pc_offset;
+
+			/* Switch the code buffer between read-write and read-execute; false if the host refuses */
+			bool Protect(bool writable);
+
+			/* Translate the block starting at address. Leaves blocks[address] null if nothing could be translated. */
+			void Compile(uint16_t address);
+
+			/* Called by translated code for every opcode that is not emitted inline */
+			static void Execute(Chip8Processor* chip8, uint64_t packed);
+
+			#pragma region Emitters
+			uint8_t* out;
+			void Emit8(uint8_t value);
+			void Emit16(uint16_t value);
+			void Emit32(uint32_t value);
+			void Emit64(uint64_t value);
+			void EmitMemoryOperand(uint8_t reg, int32_t offset);
+			void EmitCall(const Instruction& in);
+			void EmitStorePC(uint16_t address);
+			void EmitReturn(uint32_t count);
+			#pragma endregion
+
+		public:
+			explicit Chip8Jit(Chip8Processor& chip8);
+			~Chip8Jit();
+
+			Chip8Jit(const Chip8Jit&) = delete;
+			Chip8Jit& operator=(const Chip8Jit&) = delete;
+
+			/* False when executable memory could not be allocated or the host is not x86-64 */
+			bool Available() const;
+
+			/*
+			 * Run the block at the current pc if it is no longer than budget instructions. Returns the number
+			 * of instructions executed, or zero if the caller should interpret the next instruction itself.
+			 */
+			uint32_t Run(uint64_t budget);
+
+			/* Flush translated code if a write of length bytes at address touches it */
+			void Invalidate(uint16_t address, unsigned int length);
+
+			/* Drop every translated block */
+			void Flush();
+	};
+}
+
+#endif
@@ -0,0 +1,618 @@
+#include "lanes.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#define CHIP8_LANES_AVX2 1
+#define CHIP8_LANES_SSE2 0
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHIP8_LANES_AVX2 0
+#define CHIP8_LANES_SSE2 1
+#include <emmintrin.h>
+#else
+#define CHIP8_LANES_AVX2 0
+#define CHIP8_LANES_SSE2 0
+#endif
+
+namespace CHIP8
+{
+	#pragma region Lane Vectors
+
+	/*
+	 * Byte-wise operations on as many lanes as one vector register holds. The scalar fallback treats a single
+	 * lane as a one-byte vector so the opcode bodies below are written once.
+	 */
+#if CHIP8_LANES_AVX2
+	typedef __m256i LaneVector;
+	static const unsigned int VECTOR_LANES = 32;
+
+	static inline LaneVector VLoad(const uint8_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	static inline void VStore(uint8_t* p, LaneVector v) { _mm256_storeu_si256((__m256i*)p, v); }
+	static inline LaneVector VSet(uint8_t b) { return _mm256_set1_epi8((char)b); }
+	static inline LaneVector VAdd(LaneVector a, LaneVector b) { return _mm256_add_epi8(a, b); }
+	static inline LaneVector VSub(LaneVector a, LaneVector b) { return _mm256_sub_epi8(a, b); }
+	static inline LaneVector VAddSaturate(LaneVector a, LaneVector b) { return _mm256_adds_epu8(a, b); }
+	static inline LaneVector VSubSaturate(LaneVector a, LaneVector b) { return _mm256_subs_epu8(a, b); }
+	static inline LaneVector VAnd(LaneVector a, LaneVector b) { return _mm256_and_si256(a, b); }
+	static inline LaneVector VAndNot(LaneVector a, LaneVector b) { return _mm256_andnot_si256(a, b); }
+	static inline LaneVector VOr(LaneVector a, LaneVector b) { return _mm256_or_si256(a, b); }
+	static inline LaneVector VXor(LaneVector a, LaneVector b) { return _mm256_xor_si256(a, b); }
+	static inline LaneVector VEqual(LaneVector a, LaneVector b) { return _mm256_cmpeq_epi8(a, b); }
+	static inline LaneVector VShiftRight(LaneVector a, int n) { return _mm256_and_si256(_mm256_srli_epi16(a, n), VSet((uint8_t)(0xFF >> n))); }
+#elif CHIP8_LANES_SSE2
+	typedef __m128i LaneVector;
+	static const unsigned int VECTOR_LANES = 16;
+
+	static inline LaneVector VLoad(const uint8_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+	static inline void VStore(uint8_t* p, LaneVector v) { _mm_storeu_si128((__m128i*)p, v); }
+	static inline LaneVector VSet(uint8_t b) { return _mm_set1_epi8((char)b); }
+	static inline LaneVector VAdd(LaneVector a, LaneVector b) { return _mm_add_epi8(a, b); }
+	static inline LaneVector VSub(LaneVector a, LaneVector b) { return _mm_sub_epi8(a, b); }
+	static inline LaneVector VAddSaturate(LaneVector a, LaneVector b) { return _mm_adds_epu8(a, b); }
+	static inline LaneVector VSubSaturate(LaneVector a, LaneVector b) { return _mm_subs_epu8(a, b); }
+	static inline LaneVector VAnd(LaneVector a, LaneVector b) { return _mm_and_si128(a, b); }
+	static inline LaneVector VAndNot(LaneVector a, LaneVector b) { return _mm_andnot_si128(a, b); }
+	static inline LaneVector VOr(LaneVector a, LaneVector b) { return _mm_or_si128(a, b); }
+	static inline LaneVector VXor(LaneVector a, LaneVector b) { return _mm_xor_si128(a, b); }
+	static inline LaneVector VEqual(LaneVector a, LaneVector b) { return _mm_cmpeq_epi8(a, b); }
+	static inline LaneVector VShiftRight(LaneVector a, int n) { return _mm_and_si128(_mm_srli_epi16(a, n), VSet((uint8_t)(0xFF >> n))); }
+#else
+	typedef uint8_t LaneVector;
+	static const unsigned int VECTOR_LANES = 1;
+
+	static inline LaneVector VLoad(const uint8_t* p) { return *p; }
+	static inline void VStore(uint8_t* p, LaneVector v) { *p = v; }
+	static inline LaneVector VSet(uint8_t b) { return b; }
+	static inline LaneVector VAdd(LaneVector a, LaneVector b) { return (uint8_t)(a + b); }
+	static inline LaneVector VSub(LaneVector a, LaneVector b) { return (uint8_t)(a - b); }
+	static inline LaneVector VAddSaturate(LaneVector a, LaneVector b) { return a + b > 0xFF ? 0xFF : (uint8_t)(a + b); }
+	static inline LaneVector VSubSaturate(LaneVector a, LaneVector b) { return a > b ? (uint8_t)(a - b) : 0; }
+	static inline LaneVector VAnd(LaneVector a, LaneVector b) { return a & b; }
+	static inline LaneVector VAndNot(LaneVector a, LaneVector b) { return (uint8_t)(~a & b); }
+	static inline LaneVector VOr(LaneVector a, LaneVector b) { return a | b; }
+	static inline LaneVector VXor(LaneVector a, LaneVector b) { return a ^ b; }
+	static inline LaneVector VEqual(LaneVector a, LaneVector b) { return a == b ? 0xFF : 0x00; }
+	static inline LaneVector VShiftRight(LaneVector a, int n) { return (uint8_t)(a >> n); }
+#endif
+
+	/* Take update where mask is set and keep old elsewhere */
+	static inline LaneVector VSelect(LaneVector mask, LaneVector update, LaneVector old)
+	{
+		return VOr(VAnd(mask, update), VAndNot(mask, old));
+	}
+
+	/* 1 where a > b (unsigned), 0 elsewhere */
+	static inline LaneVector VGreater(LaneVector a, LaneVector b)
+	{
+		return VAndNot(VEqual(VSubSaturate(a, b), VSet(0)), VSet(1));
+	}
+
+	const char* Chip8Lanes::GetVectorIsa()
+	{
+#if CHIP8_LANES_AVX2
+		return "avx2";
+#elif CHIP8_LANES_SSE2
+		return "sse2";
+#else
+		return "scalar";
+#endif
+	}
+
+	#pragma endregion
+
+	#pragma region Chip8Lanes
+
+	Chip8Lanes::Chip8Lanes(unsigned int lanes)
+		: lanes(lanes), padded_lanes((lanes + LANE_PADDING - 1) / LANE_PADDING * LANE_PADDING), sprite_wrap(false),
+		V(NUM_REGISTERS * padded_lanes), index(padded_lanes), pc(padded_lanes), stack(STACK_LEVELS * padded_lanes),
+		sp(padded_lanes), delay_timer(padded_lanes), sound_timer(padded_lanes), rng_state(padded_lanes),
+		keypad(padded_lanes), memory((size_t)lanes * MEMORY_LOCATIONS), video((size_t)lanes * DISPLAY_HEIGHT),
+		opcodes(padded_lanes), group(padded_lanes), done(padded_lanes)
+	{
+		LoadROM(NULL, 0);
+	}
+
+	unsigned int Chip8Lanes::GetLaneCount() const
+	{
+		return lanes;
+	}
+
+	uint8_t* Chip8Lanes::Register(unsigned int x)
+	{
+		return &V[x * padded_lanes];
+	}
+
+	int Chip8Lanes::LoadROM(const uint8_t* data, size_t size)
+	{
+		unsigned int lane;
+
+		if (size > MEMORY_LOCATIONS - START_ADDRESS)
+			return 0;
+
+		std::fill(V.begin(), V.end(), 0);
+		std::fill(index.begin(), index.end(), 0);
+		std::fill(pc.begin(), pc.end(), (uint16_t)START_ADDRESS);
+		std::fill(stack.begin(), stack.end(), 0);
+		std::fill(sp.begin(), sp.end(), 0);
+		std::fill(delay_timer.begin(), delay_timer.end(), 0);
+		std::fill(sound_timer.begin(), sound_timer.end(), 0);
+		std::fill(keypad.begin(), keypad.end(), 0);
+		std::fill(memory.begin(), memory.end(), 0);
+		std::fill(video.begin(), video.end(), 0);
+
+		for (lane = 0; lane < lanes; lane++)
+		{
+			uint8_t* lane_memory = &memory[(size_t)lane * MEMORY_LOCATIONS];
+
+			memcpy(lane_memory + Chip8Processor::FONTSET_START_ADDRESS, Chip8Processor::fontset, Chip8Processor::FONTSET_SIZE);
+			memcpy(lane_memory + Chip8Processor::BIG_FONTSET_START_ADDRESS, Chip8Processor::big_fontset, Chip8Processor::BIG_FONTSET_SIZE);
+
+			if (size)
+				memcpy(lane_memory + START_ADDRESS, data, size);
+
+			SetRandomSeed(lane, lane + 1);
+		}
+
+		return 1;
+	}
+
+	void Chip8Lanes::SetRandomSeed(unsigned int lane, uint32_t seed)
+	{
+		/* Same substitution for a zero seed as Chip8Processor::SetRandomSeed */
+		rng_state[lane] = seed ? seed : (uint32_t)Chip8Processor::DEFAULT_RANDOM_SEED;
+	}
+
+	void Chip8Lanes::SetSpriteWrap(bool enabled)
+	{
+		sprite_wrap = enabled;
+	}
+
+	void Chip8Lanes::SetKeypad(unsigned int lane, uint16_t keys)
+	{
+		keypad[lane] = keys;
+	}
+
+	const uint64_t* Chip8Lanes::GetDisplayState(unsigned int lane) const
+	{
+		return &video[(size_t)lane * DISPLAY_HEIGHT];
+	}
+
+	void Chip8Lanes::StoreLane(unsigned int lane, Chip8Processor& chip8) const
+	{
+		unsigned int i;
+
+		for (i = 0; i < NUM_REGISTERS; i++)
+			chip8.V[i] = V[i * padded_lanes + lane];
+
+		for (i = 0; i < STACK_LEVELS; i++)
+			chip8.stack[i] = stack[i * padded_lanes + lane];
+
+		for (i = 0; i < Chip8Processor::INPUT_KEYS; i++)
+			chip8.keypad[i] = (keypad[lane] >> i) & 1;
+
+		chip8.index = index[lane];
+		chip8.pc = pc[lane];
+		chip8.sp = sp[lane];
+		chip8.delay_timer = delay_timer[lane];
+		chip8.sound_timer = sound_timer[lane];
+		chip8.rng_state = rng_state[lane];
+		chip8.sprite_wrap = sprite_wrap;
+
+		memcpy(chip8.memory, &memory[(size_t)lane * MEMORY_LOCATIONS], MEMORY_LOCATIONS);
+		chip8.SetXoChip(false);
+		chip8.display_width = DISPLAY_WIDTH;
+		chip8.display_height = DISPLAY_HEIGHT;
+		chip8.plane_mask = 1;
+		chip8.planes_used = 1;
+		memset(chip8.video, 0, sizeof(chip8.video));
+		memcpy(chip8.video, GetDisplayState(lane), DISPLAY_HEIGHT * sizeof(uint64_t));
+
+		/* Same bookkeeping as LoadState: memory was replaced and the whole screen needs redrawing */
+		chip8.MemoryWritten(0, MEMORY_LOCATIONS);
+		chip8.MarkDirty(0, DISPLAY_HEIGHT - 1);
+	}
+
+	void Chip8Lanes::LoadLane(unsigned int lane, const Chip8Processor& chip8)
+	{
+		unsigned int i;
+
+		for (i = 0; i < NUM_REGISTERS; i++)
+			V[i * padded_lanes + lane] = chip8.V[i];
+
+		for (i = 0; i < STACK_LEVELS; i++)
+			stack[i * padded_lanes + lane] = chip8.stack[i];
+
+		keypad[lane] = 0;
+
+		for (i = 0; i < Chip8Processor::INPUT_KEYS; i++)
+			keypad[lane] |= (chip8.keypad[i] ? 1U : 0U) << i;
+
+		index[lane] = chip8.index;
+		pc[lane] = chip8.pc;
+		sp[lane] = chip8.sp;
+		delay_timer[lane] = chip8.delay_timer;
+		sound_timer[lane] = chip8.sound_timer;
+		rng_state[lane] = chip8.rng_state;
+
+		memcpy(&memory[(size_t)lane * MEMORY_LOCATIONS], chip8.memory, MEMORY_LOCATIONS);
+		memcpy(&video[(size_t)lane * DISPLAY_HEIGHT], chip8.video, DISPLAY_HEIGHT * sizeof(uint64_t));
+	}
+
+	#pragma endregion
+
+	#pragma region Step
+
+	void Chip8Lanes::Step()
+	{
+		unsigned int lane, other, vector_groups = 0;
+		bool uniform = true;
+
+		/* Fetch, exactly as Chip8Processor::Cycle does */
+		for (lane = 0; lane < lanes; lane++)
+		{
+			const uint8_t* lane_memory = &memory[(size_t)lane * MEMORY_LOCATIONS];
+			uint16_t address = pc[lane];
+
+			opcodes[lane] = (lane_memory[address & MEMORY_MASK] << 8U) | lane_memory[(address + 1) & MEMORY_MASK];
+			pc[lane] = address + 2;
+			uniform = uniform && opcodes[lane] == opcodes[0];
+		}
+
+		if (!lanes)
+			return;
+
+		/* Lockstep: every lane runs the same opcode */
+		if (uniform)
+		{
+			Instruction in = Chip8Processor::Decode(opcodes[0]);
+
+			if (IsVectorOpcode(in.id))
+			{
+				ExecuteVector(in, NULL);
+			}
+			else
+			{
+				for (lane = 0; lane < lanes; lane++)
+					ExecuteLane(lane, in);
+			}
+
+			return;
+		}
+
+		/* Diverged: group lanes by opcode, vectorize the large ALU groups and run the rest lane by lane */
+		memset(done.data(), 0, lanes);
+
+		for (lane = 0; lane < lanes; lane++)
+		{
+			if (done[lane])
+				continue;
+
+			Instruction in = Chip8Processor::Decode(opcodes[lane]);
+
+			if (!IsVectorOpcode(in.id) || vector_groups >= MAX_VECTOR_GROUPS)
+			{
+				ExecuteLane(lane, in);
+				continue;
+			}
+
+			unsigned int members = 0;
+
+			memset(group.data(), 0, padded_lanes);
+
+			for (other = lane; other < lanes; other++)
+			{
+				if (opcodes[other] == opcodes[lane])
+				{
+					group[other] = 0xFF;
+					done[other] = 1;
+					members++;
+				}
+			}
+
+			if (members >= MIN_VECTOR_GROUP)
+			{
+				ExecuteVector(in, group.data());
+				vector_groups++;
+			}
+			else
+			{
+				for (other = lane; other < lanes; other++)
+				{
+					if (group[other])
+						ExecuteLane(other, in);
+				}
+			}
+		}
+	}
+
+	void Chip8Lanes::RunCycles(uint64_t count)
+	{
+		while (count--)
+			Step();
+	}
+
+	void Chip8Lanes::TickTimers()
+	{
+		unsigned int lane;
+
+		for (lane = 0; lane < padded_lanes; lane += VECTOR_LANES)
+		{
+			VStore(&delay_timer[lane], VSubSaturate(VLoad(&delay_timer[lane]), VSet(1)));
+			VStore(&sound_timer[lane], VSubSaturate(VLoad(&sound_timer[lane]), VSet(1)));
+		}
+	}
+
+	void Chip8Lanes::RunFrame(uint64_t instructions)
+	{
+		RunCycles(instructions);
+		TickTimers();
+	}
+
+	#pragma endregion
+
+	#pragma region Vector Opcodes
+
+	bool Chip8Lanes::IsVectorOpcode(uint8_t id)
+	{
+		return id == OP_6XNN || id == OP_7XNN || (id >= OP_8XY0 && id <= OP_8XYE);
+	}
+
+	/*
+	 * Each opcode writes VF and VX in the same order as its Chip8Processor handler, reloading registers in
+	 * between, so X or Y being F gives the same result as the scalar code.
+	 */
+	void Chip8Lanes::ExecuteVector(const Instruction& in, const uint8_t* group)
+	{
+		uint8_t* vx = Register(in.x);
+		uint8_t* vy = Register(in.y);
+		uint8_t* vf = Register(0xF);
+		const LaneVector ones = VSet(1);
+		unsigned int lane;
+
+		for (lane = 0; lane < padded_lanes; lane += VECTOR_LANES)
+		{
+			LaneVector mask = group ? VLoad(group + lane) : VSet(0xFF);
+			LaneVector x = VLoad(vx + lane);
+			LaneVector y = VLoad(vy + lane);
+			LaneVector result;
+
+			switch (in.id)
+			{
+				case OP_6XNN: result = VSet(in.nn); break;
+				case OP_7XNN: result = VAdd(x, VSet(in.nn)); break;
+				case OP_8XY0: result = y; break;
+				case OP_8XY1: result = VOr(x, y); break;
+				case OP_8XY2: result = VAnd(x, y); break;
+				case OP_8XY3: result = VXor(x, y); break;
+
+				case OP_8XY4:
+				{
+					/* Carry where the saturating sum differs from the wrapping one */
+					result = VAdd(x, y);
+					VStore(vf + lane, VSelect(mask, VAndNot(VEqual(VAddSaturate(x, y), result), ones), VLoad(vf + lane)));
+				} break;
+
+				case OP_8XY5:
+				{
+					VStore(vf + lane, VSelect(mask, VGreater(x, y), VLoad(vf + lane)));
+					x = VLoad(vx + lane);
+					y = VLoad(vy + lane);
+					result = VSub(x, y);
+				} break;
+
+				case OP_8XY6:
+				{
+					VStore(vf + lane, VSelect(mask, VAnd(x, ones), VLoad(vf + lane)));
+					x = VLoad(vx + lane);
+					result = VShiftRight(x, 1);
+				} break;
+
+				case OP_8XY7:
+				{
+					result = VSub(y, x);
+					VStore(vf + lane, VSelect(mask, VGreater(y, x), VLoad(vf + lane)));
+				} break;
+
+				case OP_8XYE:
+				{
+					VStore(vf + lane, VSelect(mask, VShiftRight(x, 7), VLoad(vf + lane)));
+					x = VLoad(vx + lane);
+					result = VAdd(x, x);
+				} break;
+
+				default:
+					return;
+			}
+
+			/* Reload X, the VF store above may have changed it */
+			VStore(vx + lane, VSelect(mask, result, VLoad(vx + lane)));
+		}
+	}
+
+	#pragma endregion
+
+	#pragma region Scalar Opcodes
+
+	/* Same semantics as the Chip8Processor opcode handlers, on one lane's slice of the arrays */
+	void Chip8Lanes::ExecuteLane(unsigned int lane, const Instruction& in)
+	{
+		uint8_t* lane_memory = &memory[(size_t)lane * MEMORY_LOCATIONS];
+		uint64_t* lane_video = &video[(size_t)lane * DISPLAY_HEIGHT];
+		uint8_t& x = V[in.x * padded_lanes + lane];
+		uint8_t& y = V[in.y * padded_lanes + lane];
+		uint8_t& f = V[0xF * padded_lanes + lane];
+		unsigned int i;
+
+		switch (in.id)
+		{
+			case OP_00E0:
+			{
+				memset(lane_video, 0, DISPLAY_HEIGHT * sizeof(uint64_t));
+			} break;
+
+			case OP_00EE:
+			{
+				sp[lane] = (sp[lane] - 1) & (STACK_LEVELS - 1);
+				pc[lane] = stack[sp[lane] * padded_lanes + lane];
+			} break;
+
+			case OP_1NNN: pc[lane] = in.nnn; break;
+
+			case OP_2NNN:
+			{
+				stack[sp[lane] * padded_lanes + lane] = pc[lane];
+				sp[lane] = (sp[lane] + 1) & (STACK_LEVELS - 1);
+				pc[lane] = in.nnn;
+			} break;
+
+			case OP_3XNN: if (x == in.nn) pc[lane] += 2; break;
+			case OP_4XNN: if (x != in.nn) pc[lane] += 2; break;
+
+			/* Lanes are never XO-CHIP, and on a 4 KB machine 5XY2 and 5XY3 skip like 5XY0 */
+			case OP_5XY0:
+			case OP_5XY2:
+			case OP_5XY3: if (x == y) pc[lane] += 2; break;
+
+			case OP_6XNN: x = in.nn; break;
+			case OP_7XNN: x += in.nn; break;
+			case OP_8XY0: x = y; break;
+			case OP_8XY1: x |= y; break;
+			case OP_8XY2: x &= y; break;
+			case OP_8XY3: x ^= y; break;
+
+			case OP_8XY4:
+			{
+				uint16_t sum = x + y;
+				f = (sum > 255U) ? 1 : 0;
+				x = sum & 0xFFU;
+			} break;
+
+			case OP_8XY5:
+			{
+				f = (x > y) ? 1 : 0;
+				x -= y;
+			} break;
+
+			case OP_8XY6:
+			{
+				f = x & 0x1U;
+				x >>= 1U;
+			} break;
+
+			case OP_8XY7:
+			{
+				uint16_t diff = y - x;
+				f = (y > x) ? 1 : 0;
+				x = diff & 0xFFU;
+			} break;
+
+			case OP_8XYE:
+			{
+				f = (x & 0x80U) >> 7U;
+				x <<= 1;
+			} break;
+
+			case OP_9XY0: if (x != y) pc[lane] += 2; break;
+			case OP_ANNN: index[lane] = in.nnn; break;
+			case OP_BNNN: pc[lane] = Register(0)[lane] + in.nnn; break;
+
+			case OP_CXNN:
+			{
+				uint32_t state = rng_state[lane];
+
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+				rng_state[lane] = state;
+
+				x = (uint8_t)(state >> 24) & in.nn;
+			} break;
+
+			case OP_DXYN:
+			{
+				uint8_t xPosition = x % DISPLAY_WIDTH;
+				uint8_t yPosition = y % DISPLAY_HEIGHT;
+				uint64_t collision = 0;
+				unsigned int row;
+
+				for (row = 0; row < in.n; row++)
+				{
+					unsigned int line_y = yPosition + row;
+
+					if (line_y >= DISPLAY_HEIGHT)
+					{
+						if (!sprite_wrap)
+							break;
+
+						line_y -= DISPLAY_HEIGHT;
+					}
+
+					uint64_t sprite = (uint64_t)lane_memory[(index[lane] + row) & MEMORY_MASK] << 56U;
+					uint64_t line = sprite >> xPosition;
+
+					if (sprite_wrap && xPosition)
+						line |= sprite << (DISPLAY_WIDTH - xPosition);
+
+					collision |= lane_video[line_y] & line;
+					lane_video[line_y] ^= line;
+				}
+
+				f = collision ? 1 : 0;
+			} break;
+
+			case OP_EX9E: if (keypad[lane] & (1U << (x & 0xF))) pc[lane] += 2; break;
+			case OP_EXA1: if (!(keypad[lane] & (1U << (x & 0xF)))) pc[lane] += 2; break;
+			case OP_FX07: x = delay_timer[lane]; break;
+
+			case OP_FX0A:
+			{
+				/* The lowest pressed key wins, as in the scalar scan */
+				if (keypad[lane])
+				{
+					for (i = 0; !(keypad[lane] & (1U << i)); i++)
+						;
+
+					x = (uint8_t)i;
+				}
+				else
+				{
+					pc[lane] -= 2;
+				}
+			} break;
+
+			case OP_FX15: delay_timer[lane] = x; break;
+			case OP_FX18: sound_timer[lane] = x; break;
+			case OP_FX1E: index[lane] += x; break;
+			case OP_FX29: index[lane] = Chip8Processor::FONTSET_START_ADDRESS + (5 * x); break;
+
+			case OP_FX33:
+			{
+				uint8_t value = x;
+
+				lane_memory[(index[lane] + 2) & MEMORY_MASK] = value % 10;
+				value /= 10;
+				lane_memory[(index[lane] + 1) & MEMORY_MASK] = value % 10;
+				value /= 10;
+				lane_memory[index[lane] & MEMORY_MASK] = value % 10;
+			} break;
+
+			case OP_FX55:
+			{
+				for (i = 0; i <= in.x; i++)
+					lane_memory[(index[lane] + i) & MEMORY_MASK] = V[i * padded_lanes + lane];
+			} break;
+
+			case OP_FX65:
+			{
+				for (i = 0; i <= in.x; i++)
+					V[i * padded_lanes + lane] = lane_memory[(index[lane] + i) & MEMORY_MASK];
+			} break;
+
+			default:
+				break;
+		}
+	}
+
+	#pragma endregion
+}
@@ -0,0 +1,117 @@
+#ifndef _LANES_H_
+#define _LANES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "chip8.h"
+
+namespace CHIP8
+{
+	/*
+	 * Steps many independent Chip-8 machines in lockstep. Registers, pc, index, stack and timers are stored
+	 * structure-of-arrays, one lane-wide array per register, so an ALU opcode (6XNN, 7XNN, 8XY*) that several
+	 * lanes are about to execute runs across all of them at once with AVX2 or SSE2. Each step fetches every
+	 * lane's opcode, groups lanes by opcode, runs each ALU group as one masked vector operation and every
+	 * other opcode lane by lane.
+	 *
+	 * Every lane behaves exactly like a Chip8Processor running Cycle, so StoreLane followed by SaveState is
+	 * byte-identical to a scalar machine fed the same ROM, seed and keys.
+	 *
+	 * Lanes model the original 64x32 Chip-8 only. SUPER-CHIP and XO-CHIP opcodes are not executed, except that
+	 * 5XY2/5XY3 skip like 5XY0 as they do on a 4 KB Chip8Processor. LoadLane keeps the first 64x32 of plane 0
+	 * and the first 4 KB of memory, and StoreLane leaves a 4 KB machine.
+	 */
+	class Chip8Lanes
+	{
+		public:
+			/* Lane arrays are padded to a multiple of this, the widest vector in bytes */
+			static const unsigned int LANE_PADDING = 32;
+
+		private:
+			static const unsigned int NUM_REGISTERS = 16;
+			static const unsigned int MEMORY_LOCATIONS = 4096;
+			static const unsigned int MEMORY_MASK = MEMORY_LOCATIONS - 1;
+			static const unsigned int STACK_LEVELS = 16;
+			static const unsigned int DISPLAY_WIDTH = Chip8Processor::DISPLAY_WIDTH;
+			static const unsigned int DISPLAY_HEIGHT = Chip8Processor::DISPLAY_HEIGHT;
+			static const unsigned int START_ADDRESS = 0x200;
+
+			/* A divergent step runs at most this many vector groups; smaller groups run lane by lane */
+			static const unsigned int MAX_VECTOR_GROUPS = 8;
+			static const unsigned int MIN_VECTOR_GROUP = 4;
+
+			unsigned int lanes;
+			unsigned int padded_lanes;
+			bool sprite_wrap;
+
+			/* Lane-wide register files: V[x * padded_lanes + lane], stack[level * padded_lanes + lane] */
+			std::vector<uint8_t> V;
+			std::vector<uint16_t> index;
+			std::vector<uint16_t> pc;
+			std::vector<uint16_t> stack;
+			std::vector<uint8_t> sp;
+			std::vector<uint8_t> delay_timer;
+			std::vector<uint8_t> sound_timer;
+			std::vector<uint32_t> rng_state;
+
+			/* One bit per key */
+			std::vector<uint16_t> keypad;
+
+			/* Per-lane blocks: memory[lane * MEMORY_LOCATIONS + address], video[lane * DISPLAY_HEIGHT + row] */
+			std::vector<uint8_t> memory;
+			std::vector<uint64_t> video;
+
+			/* Opcode fetched by each lane this step, and the membership mask of the group being executed */
+			std::vector<uint16_t> opcodes;
+			std::vector<uint8_t> group;
+			std::vector<uint8_t> done;
+
+			uint8_t* Register(unsigned int x);
+
+			static bool IsVectorOpcode(uint8_t id);
+
+			/* Run an ALU opcode on every lane whose group byte is set, or on all lanes if group is null */
+			void ExecuteVector(const Instruction& in, const uint8_t* group);
+
+			/* Run any opcode on a single lane */
+			void ExecuteLane(unsigned int lane, const Instruction& in);
+
+		public:
+			explicit Chip8Lanes(unsigned int lanes);
+
+			unsigned int GetLaneCount() const;
+
+			/* Reset every lane and load the same ROM into each. Lane i's RNG is seeded with i + 1. */
+			int LoadROM(const uint8_t* data, size_t size);
+
+			void SetRandomSeed(unsigned int lane, uint32_t seed);
+			void SetSpriteWrap(bool enabled);
+
+			/* Pressed keys of a lane, one bit per key */
+			void SetKeypad(unsigned int lane, uint16_t keys);
+
+			/* Run one instruction on every lane */
+			void Step();
+
+			/* Run count instructions on every lane */
+			void RunCycles(uint64_t count);
+
+			/* Decrement every lane's delay and sound timers */
+			void TickTimers();
+
+			/* Run the given number of instructions, then tick the timers */
+			void RunFrame(uint64_t instructions);
+
+			const uint64_t* GetDisplayState(unsigned int lane) const;
+
+			/* Copy a lane to or from a scalar processor, e.g. to save it or to start a lane from a save state */
+			void StoreLane(unsigned int lane, Chip8Processor& chip8) const;
+			void LoadLane(unsigned int lane, const Chip8Processor& chip8);
+
+			/* Name of the vector instruction set compiled in: "avx2", "sse2" or "scalar" */
+			static const char* GetVectorIsa();
+	};
+}
+
+#endif
@@ -0,0 +1,57 @@
+#include "latency.h"
+
+namespace CHIP8
+{
+	#pragma region Chip8InputLatency
+
+	Chip8InputLatency::Chip8InputLatency()
+		: serial(0), presented(0), samples(0), dropped(0), total_ms(0.0), max_ms(0.0)
+	{
+
+	}
+
+	uint16_t Chip8InputLatency::KeyChanged()
+	{
+		pending[++serial % MAX_PENDING] = Clock::now();
+
+		/* Give up on the oldest change rather than overwrite its timestamp */
+		if ((uint16_t)(serial - presented) > MAX_PENDING)
+		{
+			presented++;
+			dropped++;
+		}
+
+		return serial;
+	}
+
+	void Chip8InputLatency::Presented(uint16_t frame_serial)
+	{
+		Clock::time_point now = Clock::now();
+
+		/* Serials wrap, so compare by signed distance; an older frame than the last one measured changes nothing */
+		while ((int16_t)(frame_serial - presented) > 0)
+		{
+			double latency = std::chrono::duration<double, std::milli>(now - pending[++presented % MAX_PENDING]).count();
+
+			total_ms += latency;
+			samples++;
+
+			if (latency > max_ms)
+				max_ms = latency;
+		}
+	}
+
+	LatencyStats Chip8InputLatency::GetStats() const
+	{
+		LatencyStats stats;
+
+		stats.samples = samples;
+		stats.dropped = dropped;
+		stats.mean_ms = samples ? total_ms / samples : 0.0;
+		stats.max_ms = max_ms;
+
+		return stats;
+	}
+
+	#pragma endregion
+}
@@ -0,0 +1,56 @@
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include <chrono>
+#include <cstdint>
+
+namespace CHIP8
+{
+	/* Time from a keypad change to the return of the first present emulated with it */
+	struct LatencyStats
+	{
+		uint64_t samples;
+		uint64_t dropped;
+		double mean_ms;
+		double max_ms;
+	};
+
+	/*
+	 * Input-to-photon instrumentation. Every keypad change gets a 16-bit serial and a timestamp. The serial
+	 * travels with the key mask to the emulation thread and back with the frame it produced. When that frame
+	 * has been presented, every change up to its serial is timed. Only the thread that handles input and
+	 * presents calls this class.
+	 */
+	class Chip8InputLatency
+	{
+		private:
+			typedef std::chrono::steady_clock Clock;
+
+			/* Changes not yet on screen. Once more are outstanding, the oldest are dropped from the statistics. */
+			static const unsigned int MAX_PENDING = 64;
+
+			Clock::time_point pending[MAX_PENDING];
+
+			/* Serial of the latest change, and of the latest one that has been presented */
+			uint16_t serial;
+			uint16_t presented;
+
+			uint64_t samples;
+			uint64_t dropped;
+			double total_ms;
+			double max_ms;
+
+		public:
+			Chip8InputLatency();
+
+			/* Timestamp a keypad change. Returns its serial. */
+			uint16_t KeyChanged();
+
+			/* A frame emulated with keypad changes up to frame_serial has just been presented */
+			void Presented(uint16_t frame_serial);
+
+			LatencyStats GetStats() const;
+	};
+}
+
+#endif
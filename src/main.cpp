@@ -1,37 +1,325 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
 #include <time.h>
+#include <vector>
+#include "beeper.h"
 #include "chip8.h"
 #include "display.h"
+#include "inputlog.h"
+#include "profiler.h"
+#include "rewind.h"
+#include "rombundle.h"
+#include "scheduler.h"
+#include "statefile.h"
+#include "triplebuffer.h"
 
+/* The render thread sleeps on SDL events; the timeout only bounds how long a lost frame wakeup could hold a frame back */
+static const int IDLE_WAIT_MS = 100;
+
+/* Interval between phosphor fade steps while no new frames arrive */
+static const int FADE_STEP_MS = 16;
+
+/*
+ * Usage: chip8 [--ips N] [--turbo] [--turbo-speed N|max] [--state FILE] [--rewind-mb N] [--profile FILE]
+ *              [--seed N] [--record FILE] [--xo-chip] [--audio-buffer N] [--keymap KEYS]
+ *              [--phosphor N] [--scale integer|sharp] [--scanlines] ROM
+ *
+ * With --state the latest machine state is kept in FILE and restored on the next start, so the ROM
+ * resumes where it was left instead of booting again. Holding Backspace rewinds through the last
+ * --rewind-mb megabytes of history (default 8, 0 disables it). With --profile, in a CHIP8_PROFILE=1
+ * build, a guest profile is written to FILE and its call stacks to FILE.folded at exit.
+ *
+ * The random generator is seeded from the clock unless --seed is given. With --record the seed and
+ * every keypad change are written to FILE at exit for chip8-replay; a recording always boots the ROM
+ * fresh and runs without rewind, since neither a resumed state nor rewound history is in the log.
+ *
+ * --xo-chip gives the machine XO-CHIP's 64 KB of memory from the start. A ROM bigger than 3.5 KB gets it anyway.
+ *
+ * The sound timer plays through the default audio device with a buffer of --audio-buffer samples at 48 kHz
+ * (default 512, about 11 ms). Smaller buffers lower the latency but underrun sooner; 0 turns sound off.
+ *
+ * The machine runs on its own thread and hands finished frames to this one through a triple buffer, so a
+ * present blocked on vsync never holds up emulation and an emulation spike never holds up input.
+ *
+ * --keymap binds keypad keys 0 to F to the 16 characters of KEYS (default x123qweasdzc4rfv). The time from
+ * each keypad change to the first presented frame emulated with it is printed at exit.
+ *
+ * --phosphor, --scale and --scanlines turn on CPU post-processing: pixels that go dark keep N percent of their
+ * brightness each frame (try 60) so XOR flicker fades out, the image is scaled by a whole factor or with sharp
+ * bilinear filtering to fill the window, and scanlines darken the bottom of every emulated row. Without any of
+ * them frames are drawn exactly as before.
+ */
 int main(int argc, char** argv)
 {
-	
-	if (argc == 2)
+	char const* romFile = NULL;
+	char const* stateFile = NULL;
+	char const* profileFile = NULL;
+	char const* recordFile = NULL;
+	char const* keymap = NULL;
+	uint32_t seed = (uint32_t)time(NULL);
+	unsigned int instructions_per_second = CHIP8::Chip8Scheduler::DEFAULT_INSTRUCTIONS_PER_SECOND;
+	unsigned int turbo_speed = CHIP8::Chip8Scheduler::DEFAULT_TURBO_SPEED;
+	size_t rewind_bytes = CHIP8::Chip8Rewind::DEFAULT_CAPACITY;
+	unsigned int audio_buffer = CHIP8::Chip8Beeper::DEFAULT_BUFFER_SAMPLES;
+	bool turbo = false;
+	bool xo_chip = false;
+	bool post_process = false;
+	CHIP8::PostProcessSettings post_settings = { 0, CHIP8::SCALE_INTEGER, false };
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--ips") && i + 1 < argc)
+			instructions_per_second = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--state") && i + 1 < argc)
+			stateFile = argv[++i];
+		else if (!strcmp(argv[i], "--rewind-mb") && i + 1 < argc)
+			rewind_bytes = (size_t)strtoul(argv[++i], NULL, 10) * 1024 * 1024;
+		else if (!strcmp(argv[i], "--profile") && i + 1 < argc)
+			profileFile = argv[++i];
+		else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+			seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+			recordFile = argv[++i];
+		else if (!strcmp(argv[i], "--phosphor") && i + 1 < argc)
+		{
+			post_settings.phosphor_decay = (unsigned int)strtoul(argv[++i], NULL, 10) * 256 / 100;
+			post_process = true;
+		}
+		else if (!strcmp(argv[i], "--scale") && i + 1 < argc)
+		{
+			post_settings.filter = !strcmp(argv[++i], "sharp") ? CHIP8::SCALE_SHARP_BILINEAR : CHIP8::SCALE_INTEGER;
+			post_process = true;
+		}
+		else if (!strcmp(argv[i], "--scanlines"))
+		{
+			post_settings.scanlines = true;
+			post_process = true;
+		}
+		else if (!strcmp(argv[i], "--keymap") && i + 1 < argc)
+			keymap = argv[++i];
+		else if (!strcmp(argv[i], "--audio-buffer") && i + 1 < argc)
+			audio_buffer = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--turbo"))
+			turbo = true;
+		else if (!strcmp(argv[i], "--xo-chip"))
+			xo_chip = true;
+		else if (!strcmp(argv[i], "--turbo-speed") && i + 1 < argc)
+		{
+			i++;
+			turbo_speed = !strcmp(argv[i], "max") ? CHIP8::Chip8Scheduler::TURBO_UNCAPPED : (unsigned int)strtoul(argv[i], NULL, 10);
+		}
+		else
+			romFile = argv[i];
+	}
+
+	if (romFile)
 	{
-		char const* romFile = argv[1];
 		CHIP8::Chip8Processor chip8;
-		chip8.LoadROM(romFile);
+		std::vector<uint8_t> rom;
+
+		CHIP8::ReadRomFile(romFile, rom);
+		chip8.SetXoChip(xo_chip);
+		chip8.LoadROM({ rom.data(), rom.size() });
+		chip8.SetRandomSeed(seed);
+
+		if (recordFile)
+		{
+			if (stateFile)
+				std::cerr << "Ignoring --state " << stateFile << ", a recording starts from a fresh boot" << std::endl;
+
+			stateFile = NULL;
+			rewind_bytes = 0;
+		}
+
+		CHIP8::Chip8StateFile state;
+
+		if (stateFile && !state.Open(stateFile))
+			std::cerr << "Unable to open state file " << stateFile << std::endl;
+
+		if (state.IsOpen() && state.Restore(chip8))
+			std::cerr << "Resumed from " << stateFile << std::endl;
+
+		/* Profiling sees the whole run, so it is attached after a resumed state is restored */
+		std::unique_ptr<CHIP8::Chip8Profiler> profiler;
+
+		if (profileFile)
+		{
+			profiler.reset(new CHIP8::Chip8Profiler());
+
+			if (!chip8.SetProfiler(profiler.get()))
+			{
+				std::cerr << "Profiling is not available, rebuild with CHIP8_PROFILE=1" << std::endl;
+				profiler.reset();
+			}
+		}
+
+		/* Declared before the display so it outlives the audio callback */
+		CHIP8::Chip8Beeper beeper(CHIP8::Chip8Beeper::DEFAULT_SAMPLE_RATE, audio_buffer);
 
 		CHIP8::Chip8Display display("Chip 8 Emulator", 1000, 500, 64, 32);
+		CHIP8::Chip8Scheduler scheduler(chip8, instructions_per_second);
+		scheduler.SetTurboSpeed(turbo_speed);
+
+		bool audio = audio_buffer && display.OpenAudio(beeper);
+
+		if (post_process)
+			display.SetPostProcess(post_settings);
 
-		const float TIME_PER_CYCLE = 1.0f / 500.0f;
+		if (keymap && !display.SetKeymap(keymap))
+			std::cerr << "Ignoring --keymap " << keymap << ", it needs 16 different keys for 0 to F" << std::endl;
 
-		bool running = true;
-		clock_t start = clock();
-		clock_t end;
+		if (audio)
+			scheduler.SetBeeper(&beeper);
+		else if (audio_buffer)
+			std::cerr << "Unable to open an audio device, running without sound" << std::endl;
 
-		while (running)
+		CHIP8::Chip8InputLog input_log;
+
+		if (recordFile)
 		{
-			running = !display.HandleInput(chip8.GetKeypadState());
-			end = clock();
-			float dt = (float)(end - start);
+			input_log.Start(seed, instructions_per_second, CHIP8::HashRom(rom.data(), rom.size()));
+			scheduler.SetInputLog(&input_log);
+		}
+
+		CHIP8::Chip8Rewind rewind(rewind_bytes);
+		CHIP8::Chip8TripleBuffer frames;
+
+		/* Cleared when the window closes. Keys and hotkeys reach the emulation thread through the display's atomics. */
+		std::atomic<bool> running(true);
 
-			if (dt > TIME_PER_CYCLE)
+		/* Emulation, audio, rewind and the state file run here, paced by the scheduler whatever presenting costs */
+		std::thread emulation([&]()
+		{
+			CHIP8::KeypadState keypad;
+			bool rewinding;
+			unsigned int frames_run;
+			unsigned int first_row, last_row;
+
+			while (running.load(std::memory_order_relaxed))
+			{
+				keypad = display.GetKeypad();
+				chip8.SetKeypadMask(keypad.mask);
+
+				/* Holding Tab flips fast-forward for as long as it is held */
+				scheduler.SetTurbo(turbo != display.IsTurboHeld());
+
+				/* Holding Backspace pauses emulation and steps back one recorded frame per host frame */
+				rewinding = rewind_bytes && display.IsRewindHeld();
+				scheduler.SetPaused(rewinding);
+				frames_run = scheduler.Update();
+
+				if (rewinding ? rewind.StepBack(chip8) : frames_run != 0)
+				{
+					/* Keeping the mapped state current costs one full state copy, GetStateSize() bytes, per host frame */
+					if (state.IsOpen())
+						state.Save(chip8);
+
+					if (rewind_bytes && !rewinding)
+						rewind.Capture(chip8);
+
+					/* Publish at most once per host frame, and only if the framebuffer changed */
+					if (chip8.ConsumeDirtyRows(first_row, last_row))
+					{
+						frames.Publish(chip8, first_row, last_row, keypad.serial);
+						display.PostFrameReady();
+					}
+				}
+
+				/* A machine idling with its timers stopped only changes on input, so just check the keys once a frame */
+				if (!rewinding && chip8.IsWaitingForInput())
+				{
+					while (running.load(std::memory_order_relaxed) && !display.IsRewindHeld() && display.GetKeypad().mask == chip8.GetKeypadMask())
+						std::this_thread::sleep_for(std::chrono::microseconds(1000000 / CHIP8::Chip8Scheduler::FRAMES_PER_SECOND));
+
+					scheduler.Resync();
+				}
+				else
+					scheduler.WaitForNextFrame();
+			}
+		});
+
+		/* This thread only handles input and presents, and sleeps in between until either is needed */
+		const CHIP8::Chip8Frame* frame;
+		uint16_t input_serial = 0;
+
+		while (!display.HandleInput())
+		{
+			/* Always the newest frame; any finished while the last one was presenting are skipped */
+			if ((frame = frames.Acquire()) != NULL)
 			{
-				start = end;
-				chip8.Cycle();
-				display.UpdateDisplay(chip8.GetDisplayState(), 256);
+				display.UpdateDisplay(frame->planes, frame->has_plane1 ? &frame->planes[CHIP8::Chip8Processor::MAX_DISPLAY_WORDS] : NULL,
+					frame->width, frame->height, frame->first_row, frame->last_row);
+				input_serial = frame->input_serial;
+				display.Present(input_serial);
 			}
+			else if (display.IsFading())
+			{
+				/* Keep the phosphor decaying at about 60 Hz until it settles, unless something arrives first */
+				if (!display.WaitForInput(FADE_STEP_MS))
+				{
+					display.Refresh();
+					display.Present(input_serial);
+				}
+			}
+			else
+				display.WaitForInput(IDLE_WAIT_MS);
+		}
+
+		running.store(false, std::memory_order_relaxed);
+		emulation.join();
+
+		CHIP8::FrameTiming timing = scheduler.GetFrameTiming();
+		CHIP8::RewindStats history = rewind.GetStats();
+		CHIP8::LatencyStats input = display.GetInputLatency();
+
+		std::cerr << "Frames: " << timing.frames << ", emulated: " << timing.emulated_frames << ", dropped: " << timing.dropped_frames
+			<< ", idle instructions skipped: " << chip8.GetIdleSkipped() << ", jitter mean: " << timing.mean_jitter_ms << " ms, max: " << timing.max_jitter_ms << " ms" << std::endl;
+
+		std::cerr << "Input latency: " << input.samples << " keypad changes, mean: " << input.mean_ms << " ms, max: " << input.max_ms
+			<< " ms, " << input.dropped << " not timed" << std::endl;
+
+		if (rewind_bytes)
+		{
+			std::cerr << "Rewind: " << history.frames << " frames in " << history.bytes_used << " of " << history.capacity
+				<< " bytes, capture mean: " << history.mean_capture_us << " us, max: " << history.max_capture_us << " us" << std::endl;
+		}
+
+		if (audio)
+		{
+			CHIP8::AudioStats sound = beeper.GetStats();
+
+			std::cerr << "Audio: " << sound.frames << " frames, " << sound.underruns << " underruns (" << sound.underrun_samples
+				<< " samples) in " << sound.callbacks << " callbacks, dropped: " << sound.dropped_samples << " samples, buffer: "
+				<< beeper.GetBufferSamples() << " samples" << std::endl;
+		}
+
+		if (recordFile)
+		{
+			if (input_log.Save(recordFile))
+				std::cerr << "Recorded " << input_log.GetFrameCount() << " frames, " << input_log.GetEventCount() << " keypad changes to " << recordFile << std::endl;
+			else
+				std::cerr << "Unable to write recording " << recordFile << std::endl;
+		}
+
+		if (profiler)
+		{
+			std::ofstream report(profileFile);
+			std::ofstream folded(std::string(profileFile) + ".folded");
+
+			chip8.SetProfiler(NULL);
+			profiler->WriteReport(report);
+			profiler->WriteFoldedStacks(folded);
+
+			if (!report || !folded)
+				std::cerr << "Unable to write profile " << profileFile << std::endl;
 		}
 	}
 	else
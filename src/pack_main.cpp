@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "batch.h"
+#include "rombundle.h"
+
+/*
+ * ROM bundle packer. Writes every ROM given (directories are searched recursively for .ch8 files) into one
+ * indexed .c8b file with a content hash, size and detected platform per ROM, or lists the catalog of an
+ * existing bundle.
+ *
+ * Usage: chip8-pack BUNDLE ROM|DIR...
+ *        chip8-pack --list BUNDLE
+ */
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: chip8-pack BUNDLE ROM|DIR..." << std::endl;
+	std::cerr << "       chip8-pack --list BUNDLE" << std::endl;
+}
+
+static int List(const char* path)
+{
+	CHIP8::Chip8RomBundle bundle;
+	char line[64];
+	size_t i;
+
+	if (!bundle.Open(path))
+	{
+		std::cerr << "Error: Unable to open bundle " << path << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "hash\tsize\tplatform\tname" << std::endl;
+
+	for (i = 0; i < bundle.GetCount(); i++)
+	{
+		const CHIP8::RomEntry& entry = bundle.GetEntry(i);
+
+		snprintf(line, sizeof(line), "%016llx\t%zu\t%s", (unsigned long long)entry.hash, entry.image.size,
+			CHIP8::GetPlatformName(entry.platform));
+		std::cout << line << "\t" << entry.name << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> roms;
+	int packed;
+	int i;
+
+	if (argc == 3 && !strcmp(argv[1], "--list"))
+		return List(argv[2]);
+
+	if (argc < 3 || argv[1][0] == '-')
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	for (i = 2; i < argc; i++)
+		CHIP8::CollectRoms(argv[i], roms);
+
+	packed = CHIP8::Chip8RomBundle::Pack(argv[1], roms);
+
+	if (packed < 0)
+		return EXIT_FAILURE;
+
+	std::cerr << "Packed " << packed << " of " << roms.size() << " ROMs into " << argv[1] << std::endl;
+
+	return (size_t)packed == roms.size() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
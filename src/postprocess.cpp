@@ -0,0 +1,437 @@
+#include "postprocess.h"
+#include "framebuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#define CHIP8_POSTPROCESS_AVX2 1
+#include <immintrin.h>
+#else
+#define CHIP8_POSTPROCESS_AVX2 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHIP8_POSTPROCESS_SSE2 1
+#include <emmintrin.h>
+#else
+#define CHIP8_POSTPROCESS_SSE2 0
+#endif
+
+namespace CHIP8
+{
+	/* Scanline rows keep half their brightness */
+	static const uint32_t SCANLINE_MASK = 0x7F7F7F7FU;
+
+	/* Per channel: the larger of source and persist * decay / 256. Returns true if any byte differs from source. */
+	static bool BlendPixels(const uint32_t* source, uint32_t* persist, size_t count, unsigned int decay)
+	{
+		size_t i = 0;
+		bool fading = false;
+
+#if CHIP8_POSTPROCESS_AVX2
+		const __m256i zero8 = _mm256_setzero_si256();
+		const __m256i factor8 = _mm256_set1_epi16((short)decay);
+
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256i old = _mm256_loadu_si256((const __m256i*)(persist + i));
+			__m256i fresh = _mm256_loadu_si256((const __m256i*)(source + i));
+			__m256i low = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(old, zero8), factor8), 8);
+			__m256i high = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(old, zero8), factor8), 8);
+			__m256i blended = _mm256_max_epu8(fresh, _mm256_packus_epi16(low, high));
+
+			_mm256_storeu_si256((__m256i*)(persist + i), blended);
+			fading |= _mm256_movemask_epi8(_mm256_cmpeq_epi8(blended, fresh)) != -1;
+		}
+#endif
+
+#if CHIP8_POSTPROCESS_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i factor = _mm_set1_epi16((short)decay);
+
+		/* Widen to 16 bits, multiply, keep the high byte and narrow back */
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i old = _mm_loadu_si128((const __m128i*)(persist + i));
+			__m128i fresh = _mm_loadu_si128((const __m128i*)(source + i));
+			__m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(old, zero), factor), 8);
+			__m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(old, zero), factor), 8);
+			__m128i blended = _mm_max_epu8(fresh, _mm_packus_epi16(low, high));
+
+			_mm_storeu_si128((__m128i*)(persist + i), blended);
+			fading |= _mm_movemask_epi8(_mm_cmpeq_epi8(blended, fresh)) != 0xFFFF;
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			uint32_t blended = 0;
+			unsigned int shift;
+
+			for (shift = 0; shift < 32; shift += 8)
+			{
+				uint32_t fresh = (source[i] >> shift) & 0xFFU;
+				uint32_t old = (((persist[i] >> shift) & 0xFFU) * decay) >> 8;
+
+				blended |= std::max(fresh, old) << shift;
+			}
+
+			persist[i] = blended;
+			fading |= blended != source[i];
+		}
+
+		return fading;
+	}
+
+	/* out = (a * (256 - weight) + b * weight) / 256 per channel, weight 0 to 256 */
+	static void LerpRows(const uint32_t* a, const uint32_t* b, unsigned int weight, uint32_t* out, size_t count)
+	{
+		size_t i = 0;
+
+		if (weight == 0 || weight == 256)
+		{
+			memcpy(out, weight ? b : a, count * sizeof(uint32_t));
+			return;
+		}
+
+#if CHIP8_POSTPROCESS_AVX2
+		const __m256i zero8 = _mm256_setzero_si256();
+		const __m256i keep8 = _mm256_set1_epi16((short)(256 - weight));
+		const __m256i take8 = _mm256_set1_epi16((short)weight);
+
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256i first = _mm256_loadu_si256((const __m256i*)(a + i));
+			__m256i second = _mm256_loadu_si256((const __m256i*)(b + i));
+			__m256i low = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(first, zero8), keep8),
+				_mm256_mullo_epi16(_mm256_unpacklo_epi8(second, zero8), take8));
+			__m256i high = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(first, zero8), keep8),
+				_mm256_mullo_epi16(_mm256_unpackhi_epi8(second, zero8), take8));
+
+			_mm256_storeu_si256((__m256i*)(out + i), _mm256_packus_epi16(_mm256_srli_epi16(low, 8), _mm256_srli_epi16(high, 8)));
+		}
+#endif
+
+#if CHIP8_POSTPROCESS_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i keep = _mm_set1_epi16((short)(256 - weight));
+		const __m128i take = _mm_set1_epi16((short)weight);
+
+		/* The weighted sum of two bytes fits 16 bits unsigned, and the shift is logical */
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i first = _mm_loadu_si128((const __m128i*)(a + i));
+			__m128i second = _mm_loadu_si128((const __m128i*)(b + i));
+			__m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(first, zero), keep),
+				_mm_mullo_epi16(_mm_unpacklo_epi8(second, zero), take));
+			__m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(first, zero), keep),
+				_mm_mullo_epi16(_mm_unpackhi_epi8(second, zero), take));
+
+			_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_mm_srli_epi16(low, 8), _mm_srli_epi16(high, 8)));
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			/* Red/blue and green/alpha in alternate bytes, so each product has 16 bits to itself */
+			uint32_t even = ((a[i] & 0x00FF00FFU) * (256 - weight) + (b[i] & 0x00FF00FFU) * weight) >> 8;
+			uint32_t odd = (((a[i] >> 8) & 0x00FF00FFU) * (256 - weight) + ((b[i] >> 8) & 0x00FF00FFU) * weight) >> 8;
+
+			out[i] = (even & 0x00FF00FFU) | ((odd & 0x00FF00FFU) << 8);
+		}
+	}
+
+	static void DarkenRow(uint32_t* row, size_t count)
+	{
+		size_t i = 0;
+
+#if CHIP8_POSTPROCESS_AVX2
+		const __m256i mask8 = _mm256_set1_epi32((int)SCANLINE_MASK);
+
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256i pixels = _mm256_loadu_si256((const __m256i*)(row + i));
+
+			_mm256_storeu_si256((__m256i*)(row + i), _mm256_and_si256(_mm256_srli_epi32(pixels, 1), mask8));
+		}
+#endif
+
+#if CHIP8_POSTPROCESS_SSE2
+		const __m128i mask = _mm_set1_epi32((int)SCANLINE_MASK);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i pixels = _mm_loadu_si128((const __m128i*)(row + i));
+
+			_mm_storeu_si128((__m128i*)(row + i), _mm_and_si128(_mm_srli_epi32(pixels, 1), mask));
+		}
+#endif
+
+		for (; i < count; i++)
+			row[i] = (row[i] >> 1) & SCANLINE_MASK;
+	}
+
+	/* Write each of count pixels factor times */
+	static void ReplicatePixels(const uint32_t* in, size_t count, unsigned int factor, uint32_t* out)
+	{
+		size_t i;
+		unsigned int j;
+
+		for (i = 0; i < count; i++, out += factor)
+		{
+			j = 0;
+
+#if CHIP8_POSTPROCESS_SSE2
+			const __m128i pixel = _mm_set1_epi32((int)in[i]);
+
+			for (; j + 4 <= factor; j += 4)
+				_mm_storeu_si128((__m128i*)(out + j), pixel);
+#endif
+
+			for (; j < factor; j++)
+				out[j] = in[i];
+		}
+	}
+
+	#pragma region Chip8PostProcess
+
+	Chip8PostProcess::Chip8PostProcess(const PostProcessSettings& settings)
+		: settings(settings), source_width(0), source_height(0), target_width(0), target_height(0),
+		output_width(0), output_height(0), fading(false)
+	{
+		this->settings.phosphor_decay = std::min(settings.phosphor_decay, 255U);
+	}
+
+	void Chip8PostProcess::SetTargetSize(unsigned int width, unsigned int height)
+	{
+		if (width == target_width && height == target_height)
+			return;
+
+		target_width = width;
+		target_height = height;
+		Layout();
+
+		/* Same picture at the new size, without fading it a step */
+		if (source_width)
+			Scale(settings.phosphor_decay ? persist.data() : source.data());
+	}
+
+	void Chip8PostProcess::Layout()
+	{
+		unsigned int width = target_width ? target_width : source_width;
+		unsigned int height = target_height ? target_height : source_height;
+		double scale;
+		unsigned int i;
+
+		if (!source_width || !source_height)
+			return;
+
+		if (settings.filter == SCALE_INTEGER)
+		{
+			unsigned int factor = std::max(1U, std::min(width / source_width, height / source_height));
+
+			output_width = source_width * factor;
+			output_height = source_height * factor;
+		}
+		else
+		{
+			scale = std::min((double)width / source_width, (double)height / source_height);
+			output_width = std::max(1U, (unsigned int)lround(source_width * scale));
+			output_height = std::max(1U, (unsigned int)lround(source_height * scale));
+		}
+
+		output.assign((size_t)output_width * output_height, 0);
+		wide_rows.assign((size_t)output_width * source_height, 0);
+
+		/*
+		 * Sharp bilinear: sample as if the source were first blown up by the largest whole factor that fits with
+		 * nearest neighbour, then bilinearly scaled the rest of the way. Each pixel's middle is sampled exactly and
+		 * only the last fraction of an output pixel at its edges is blended with the neighbour.
+		 */
+		struct Axis
+		{
+			unsigned int in;
+			unsigned int out;
+			std::vector<uint32_t>* sources;
+			std::vector<uint32_t>* weights;
+		} axes[2] =
+		{
+			{ source_width, output_width, &column_source, &column_weight },
+			{ source_height, output_height, &row_source, &row_weight }
+		};
+
+		for (const Axis& axis : axes)
+		{
+			double ratio = (double)axis.out / axis.in;
+			double prescale = std::max(1.0, floor(ratio));
+			double region = 0.5 - 0.5 / prescale;
+
+			axis.sources->resize(axis.out);
+			axis.weights->resize(axis.out);
+
+			for (i = 0; i < axis.out; i++)
+			{
+				double texel = (i + 0.5) / ratio;
+				double floored = floor(texel);
+				double centre = texel - floored - 0.5;
+				double position = floored + (centre - std::max(-region, std::min(centre, region))) * prescale;
+				double first = floor(position);
+				unsigned int weight = (unsigned int)lround((position - first) * 256.0);
+
+				if (first < 0.0)
+				{
+					first = 0.0;
+					weight = 0;
+				}
+
+				if (first >= axis.in - 1)
+				{
+					first = axis.in - 1;
+					weight = 0;
+				}
+
+				(*axis.sources)[i] = (uint32_t)first;
+				(*axis.weights)[i] = weight;
+			}
+		}
+
+		/* Darken where the sample lands in the bottom quarter of an emulated row */
+		row_dark.assign(output_height, 0);
+
+		if (settings.scanlines && output_height >= 2 * source_height)
+		{
+			for (i = 0; i < output_height; i++)
+			{
+				double position = (i + 0.5) * source_height / output_height;
+
+				row_dark[i] = position - floor(position) >= 0.75;
+			}
+		}
+	}
+
+	void Chip8PostProcess::Process(const uint64_t* plane0, const uint64_t* plane1, unsigned int width, unsigned int height,
+		const uint32_t palette[4])
+	{
+		if (width != source_width || height != source_height)
+		{
+			source_width = width;
+			source_height = height;
+			source.assign((size_t)width * height, 0);
+			persist.assign((size_t)width * height, 0);
+			Layout();
+		}
+
+		if (plane1)
+			ExpandPlanes(plane0, plane1, width, height, source.data(), width, palette);
+		else
+			ExpandFramebuffer(plane0, width, height, source.data(), width, palette[1], palette[0]);
+
+		Scale(Blend());
+	}
+
+	void Chip8PostProcess::Refresh()
+	{
+		if (source_width)
+			Scale(Blend());
+	}
+
+	const uint32_t* Chip8PostProcess::Blend()
+	{
+		if (!settings.phosphor_decay)
+		{
+			fading = false;
+			return source.data();
+		}
+
+		fading = BlendPixels(source.data(), persist.data(), persist.size(), settings.phosphor_decay);
+		return persist.data();
+	}
+
+	void Chip8PostProcess::Scale(const uint32_t* image)
+	{
+		if (settings.filter == SCALE_INTEGER)
+			ScaleInteger(image);
+		else
+			ScaleSharpBilinear(image);
+	}
+
+	void Chip8PostProcess::ScaleInteger(const uint32_t* image)
+	{
+		unsigned int factor = output_width / source_width;
+		unsigned int row, copy;
+
+		for (row = 0; row < source_height; row++)
+		{
+			uint32_t* first = output.data() + (size_t)row * factor * output_width;
+
+			ReplicatePixels(image + (size_t)row * source_width, source_width, factor, first);
+
+			/* Copy before darkening, so a dark first row cannot leak into the rest */
+			for (copy = 1; copy < factor; copy++)
+				memcpy(first + (size_t)copy * output_width, first, output_width * sizeof(uint32_t));
+
+			for (copy = 0; copy < factor; copy++)
+			{
+				if (row_dark[row * factor + copy])
+					DarkenRow(first + (size_t)copy * output_width, output_width);
+			}
+		}
+	}
+
+	void Chip8PostProcess::ScaleSharpBilinear(const uint32_t* image)
+	{
+		unsigned int row, column;
+
+		/* Horizontal pass once per source row; most columns land inside a pixel and are plain copies */
+		for (row = 0; row < source_height; row++)
+		{
+			const uint32_t* in = image + (size_t)row * source_width;
+			uint32_t* out = wide_rows.data() + (size_t)row * output_width;
+
+			for (column = 0; column < output_width; column++)
+			{
+				uint32_t first = column_source[column];
+
+				if (!column_weight[column])
+					out[column] = in[first];
+				else
+					LerpRows(in + first, in + first + 1, column_weight[column], out + column, 1);
+			}
+		}
+
+		/* Vertical pass: whole rows at a time, copied or blended with SIMD */
+		for (row = 0; row < output_height; row++)
+		{
+			const uint32_t* upper = wide_rows.data() + (size_t)row_source[row] * output_width;
+			uint32_t* out = output.data() + (size_t)row * output_width;
+
+			LerpRows(upper, row_weight[row] ? upper + output_width : upper, row_weight[row], out, output_width);
+
+			if (row_dark[row])
+				DarkenRow(out, output_width);
+		}
+	}
+
+	bool Chip8PostProcess::IsFading() const
+	{
+		return fading;
+	}
+
+	const uint32_t* Chip8PostProcess::GetOutput() const
+	{
+		return output.data();
+	}
+
+	unsigned int Chip8PostProcess::GetOutputWidth() const
+	{
+		return output_width;
+	}
+
+	unsigned int Chip8PostProcess::GetOutputHeight() const
+	{
+		return output_height;
+	}
+
+	#pragma endregion
+}
@@ -0,0 +1,107 @@
+#ifndef _POSTPROCESS_H_
+#define _POSTPROCESS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace CHIP8
+{
+	enum ScaleFilter
+	{
+		/* Largest whole multiple that fits, each pixel an exact square, letterboxed */
+		SCALE_INTEGER,
+
+		/* Fill the output keeping the aspect ratio: nearest-neighbour inside pixels, a one-pixel blend at their edges */
+		SCALE_SHARP_BILINEAR
+	};
+
+	struct PostProcessSettings
+	{
+		/* Share of its brightness a pixel keeps each frame after it goes dark, in 1/256ths. 0 turns persistence off. */
+		unsigned int phosphor_decay;
+		ScaleFilter filter;
+
+		/* Darken the bottom quarter of every emulated row once rows are at least two output pixels tall */
+		bool scanlines;
+	};
+
+	/*
+	 * CPU-side post-processing from the packed framebuffer to output-sized RGBA pixels. Each Process expands the
+	 * planes at native resolution, blends them into a persistence buffer that keeps the brighter of the new pixel
+	 * and the old one decayed, so sprites that XOR-drawing blinks off for a frame fade instead of flickering, and
+	 * scales the result up. The blend and the scalers work on 8-bit channels with SSE2, or AVX2 where the build
+	 * targets it; a 1080p frame takes well under a millisecond.
+	 */
+	class Chip8PostProcess
+	{
+		private:
+			PostProcessSettings settings;
+
+			unsigned int source_width;
+			unsigned int source_height;
+
+			/* The latest expanded frame and the persistence buffer, at native resolution */
+			std::vector<uint32_t> source;
+			std::vector<uint32_t> persist;
+
+			/* Area the image may fill, and the image size actually produced inside it */
+			unsigned int target_width;
+			unsigned int target_height;
+			unsigned int output_width;
+			unsigned int output_height;
+			std::vector<uint32_t> output;
+
+			/* Sharp bilinear sampling positions per output column and row: first source pixel and weight of the next in 1/256ths */
+			std::vector<uint32_t> column_source;
+			std::vector<uint32_t> column_weight;
+			std::vector<uint32_t> row_source;
+			std::vector<uint32_t> row_weight;
+
+			/* Output rows the scanline effect darkens */
+			std::vector<uint8_t> row_dark;
+
+			/* Source rows scaled horizontally to output_width, for the vertical pass */
+			std::vector<uint32_t> wide_rows;
+
+			/* True while some pixel of persist is still fading towards source */
+			bool fading;
+
+			/* Work out the output size and sampling tables for the current source and target sizes */
+			void Layout();
+
+			/* Fold source into persist; the image to scale is persist, or source itself without persistence */
+			const uint32_t* Blend();
+
+			/* Scale image into output with the configured filter */
+			void Scale(const uint32_t* image);
+			void ScaleInteger(const uint32_t* image);
+			void ScaleSharpBilinear(const uint32_t* image);
+
+		public:
+			explicit Chip8PostProcess(const PostProcessSettings& settings);
+
+			/* Size of the area the image is fitted into, usually the window's drawable size. Rescales the current image. */
+			void SetTargetSize(unsigned int width, unsigned int height);
+
+			/*
+			 * Run a new frame laid out like Chip8Processor::GetDisplayPlane through the filters. plane1 may be NULL;
+			 * colours are palette[plane0 bit | plane1 bit << 1].
+			 */
+			void Process(const uint64_t* plane0, const uint64_t* plane1, unsigned int width, unsigned int height,
+				const uint32_t palette[4]);
+
+			/* Decay the persistence buffer one more frame towards the last frame and rescale */
+			void Refresh();
+
+			/* True while a refresh would still change the output */
+			bool IsFading() const;
+
+			/* The processed image, GetOutputWidth() pixels per row */
+			const uint32_t* GetOutput() const;
+			unsigned int GetOutputWidth() const;
+			unsigned int GetOutputHeight() const;
+	};
+}
+
+#endif
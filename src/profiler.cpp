@@ -0,0 +1,314 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace CHIP8
+{
+	static const char* OPCODE_NAMES[OP_COUNT] =
+	{
+		"NULL", "00E0", "00EE", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN",
+		"8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7", "8XYE", "9XY0",
+		"ANNN", "BNNN", "CXNN", "DXYN", "EX9E", "EXA1", "FX07", "FX0A", "FX15", "FX18",
+		"FX1E", "FX29", "FX33", "FX55", "FX65", "00CN", "00FB", "00FC", "00FD", "00FE",
+		"00FF", "DXY0", "FX30", "FX75", "FX85", "00DN", "5XY2", "5XY3", "F000", "FN01",
+		"F002", "FX3A"
+	};
+
+	static const char* TABLE_NAMES[PROFILE_TABLE_COUNT] = { "table", "table0", "table8", "tableE", "tableF" };
+
+	/* Heatmap shades from untouched to hottest */
+	static const char HEAT[] = " .:-=+*#%@";
+
+	static double Share(uint64_t count, uint64_t total)
+	{
+		return total ? 100.0 * count / total : 0.0;
+	}
+
+	#pragma region Chip8Profiler
+
+	Chip8Profiler::Chip8Profiler()
+	{
+		Reset();
+	}
+
+	void Chip8Profiler::Reset()
+	{
+		instructions = 0;
+		memset(pc_counts, 0, sizeof(pc_counts));
+		memset(pc_opcodes, 0, sizeof(pc_opcodes));
+		memset(opcode_counts, 0, sizeof(opcode_counts));
+		memset(table_counts, 0, sizeof(table_counts));
+		memset(reads, 0, sizeof(reads));
+		memset(writes, 0, sizeof(writes));
+
+		loops.clear();
+		has_last_pc = false;
+		last_pc = 0;
+
+		nodes.clear();
+		children.clear();
+		nodes.push_back({ 0, START_ADDRESS, 0 });
+
+		std::fill(std::begin(frames), std::end(frames), 0U);
+		current = 0;
+	}
+
+	uint64_t Chip8Profiler::GetInstructionCount() const
+	{
+		return instructions;
+	}
+
+	const char* Chip8Profiler::GetOpcodeName(uint8_t id)
+	{
+		return id < OP_COUNT ? OPCODE_NAMES[id] : "????";
+	}
+
+	#pragma endregion
+
+	#pragma region Hooks
+
+	void Chip8Profiler::OnExecute(uint16_t pc, uint16_t opcode)
+	{
+		unsigned int address = pc & MEMORY_MASK;
+		unsigned int group = opcode >> 12U;
+
+		instructions++;
+		pc_counts[address]++;
+		pc_opcodes[address] = opcode;
+		opcode_counts[Chip8Processor::Decode(opcode).id]++;
+		nodes[current].instructions++;
+
+		/* Every opcode goes through the main table, four groups then through a second one */
+		table_counts[PROFILE_TABLE]++;
+
+		if (group == 0x0)
+			table_counts[PROFILE_TABLE0]++;
+		else if (group == 0x8)
+			table_counts[PROFILE_TABLE8]++;
+		else if (group == 0xE)
+			table_counts[PROFILE_TABLEE]++;
+		else if (group == 0xF)
+			table_counts[PROFILE_TABLEF]++;
+
+		/* Control arriving at or before the previous instruction closes a loop */
+		if (has_last_pc && address <= last_pc)
+			loops[(address << 16U) | last_pc]++;
+
+		last_pc = (uint16_t)address;
+		has_last_pc = true;
+	}
+
+	void Chip8Profiler::OnCall(uint8_t sp, uint16_t target)
+	{
+		std::pair<uint32_t, uint16_t> key(current, target);
+		std::map<std::pair<uint32_t, uint16_t>, uint32_t>::iterator child = children.find(key);
+
+		if (child == children.end())
+		{
+			nodes.push_back({ current, target, 0 });
+			child = children.insert(std::make_pair(key, (uint32_t)(nodes.size() - 1))).first;
+		}
+
+		current = child->second;
+		frames[sp & (STACK_LEVELS - 1)] = current;
+	}
+
+	void Chip8Profiler::OnReturn(uint8_t sp)
+	{
+		current = frames[sp & (STACK_LEVELS - 1)];
+	}
+
+	void Chip8Profiler::OnRead(uint16_t address, unsigned int length)
+	{
+		unsigned int i;
+
+		for (i = 0; i < length; i++)
+			reads[(address + i) & MEMORY_MASK]++;
+	}
+
+	void Chip8Profiler::OnWrite(uint16_t address, unsigned int length)
+	{
+		unsigned int i;
+
+		for (i = 0; i < length; i++)
+			writes[(address + i) & MEMORY_MASK]++;
+	}
+
+	#pragma endregion
+
+	#pragma region Reports
+
+	void Chip8Profiler::WriteHeatmap(std::ostream& out, const uint64_t* counts) const
+	{
+		const unsigned int ROW_BYTES = 64;
+		const unsigned int SHADES = sizeof(HEAT) - 2;
+		uint64_t hottest = *std::max_element(counts, counts + MEMORY_LOCATIONS);
+		char line[ROW_BYTES + 16];
+		unsigned int row, i;
+
+		if (!hottest)
+		{
+			out << "  (none)\n";
+			return;
+		}
+
+		/* Shades are logarithmic, so a byte touched once still shows next to one touched millions of times */
+		for (row = 0; row < MEMORY_LOCATIONS; row += ROW_BYTES)
+		{
+			bool touched = false;
+			int length = snprintf(line, sizeof(line), "  %03X ", row);
+
+			for (i = 0; i < ROW_BYTES; i++)
+			{
+				uint64_t count = counts[row + i];
+				unsigned int shade = count ? 1 + (unsigned int)((SHADES - 1) * std::log((double)count) / std::log((double)hottest + 1.0)) : 0;
+
+				line[length + i] = HEAT[shade];
+				touched = touched || count;
+			}
+
+			line[length + ROW_BYTES] = '\0';
+
+			/* Untouched rows are left out to keep the map short */
+			if (touched)
+				out << line << "\n";
+		}
+	}
+
+	void Chip8Profiler::WriteReport(std::ostream& out, size_t top) const
+	{
+		std::vector<unsigned int> addresses;
+		std::vector<std::pair<uint64_t, uint32_t>> hot_loops;
+		std::vector<unsigned int> ids;
+		char line[128];
+		unsigned int i;
+
+		out << "Instructions: " << instructions << "\n\n";
+
+		/* Hottest addresses */
+		for (i = 0; i < MEMORY_LOCATIONS; i++)
+		{
+			if (pc_counts[i])
+				addresses.push_back(i);
+		}
+
+		std::sort(addresses.begin(), addresses.end(), [this](unsigned int a, unsigned int b)
+		{
+			return pc_counts[a] != pc_counts[b] ? pc_counts[a] > pc_counts[b] : a < b;
+		});
+
+		out << "Hot addresses\n";
+		out << "  address  opcode          count   share\n";
+
+		for (i = 0; i < addresses.size() && i < top; i++)
+		{
+			unsigned int address = addresses[i];
+
+			snprintf(line, sizeof(line), "  0x%03X    %04X  %15llu  %5.1f%%\n", address, pc_opcodes[address],
+				(unsigned long long)pc_counts[address], Share(pc_counts[address], instructions));
+			out << line;
+		}
+
+		/* A loop is the range from a backward branch's target to its source, weighted by the instructions inside */
+		for (const std::pair<const uint32_t, uint64_t>& loop : loops)
+		{
+			unsigned int first = loop.first >> 16U;
+			unsigned int last = loop.first & 0xFFFFU;
+			uint64_t body = 0;
+
+			for (i = first; i <= last; i++)
+				body += pc_counts[i];
+
+			hot_loops.push_back(std::make_pair(body, loop.first));
+		}
+
+		std::sort(hot_loops.begin(), hot_loops.end(), [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b)
+		{
+			return a.first != b.first ? a.first > b.first : a.second < b.second;
+		});
+
+		out << "\nHot loops\n";
+		out << "  range           iterations     instructions   share\n";
+
+		for (i = 0; i < hot_loops.size() && i < top; i++)
+		{
+			uint32_t key = hot_loops[i].second;
+
+			snprintf(line, sizeof(line), "  0x%03X-0x%03X  %12llu  %15llu  %5.1f%%\n", key >> 16U, key & 0xFFFFU,
+				(unsigned long long)loops.at(key), (unsigned long long)hot_loops[i].first, Share(hot_loops[i].first, instructions));
+			out << line;
+		}
+
+		/* Opcode mix */
+		for (i = 0; i < OP_COUNT; i++)
+		{
+			if (opcode_counts[i])
+				ids.push_back(i);
+		}
+
+		std::sort(ids.begin(), ids.end(), [this](unsigned int a, unsigned int b)
+		{
+			return opcode_counts[a] != opcode_counts[b] ? opcode_counts[a] > opcode_counts[b] : a < b;
+		});
+
+		out << "\nOpcode mix\n";
+
+		for (unsigned int id : ids)
+		{
+			snprintf(line, sizeof(line), "  %-6s  %15llu  %5.1f%%\n", OPCODE_NAMES[id],
+				(unsigned long long)opcode_counts[id], Share(opcode_counts[id], instructions));
+			out << line;
+		}
+
+		out << "\nDispatch tables\n";
+
+		for (i = 0; i < PROFILE_TABLE_COUNT; i++)
+		{
+			snprintf(line, sizeof(line), "  %-6s  %15llu  %5.1f%%\n", TABLE_NAMES[i],
+				(unsigned long long)table_counts[i], Share(table_counts[i], instructions));
+			out << line;
+		}
+
+		out << "\nIndex reads (64 bytes per row)\n";
+		WriteHeatmap(out, reads);
+
+		out << "\nIndex writes (64 bytes per row)\n";
+		WriteHeatmap(out, writes);
+	}
+
+	void Chip8Profiler::WriteFoldedStacks(std::ostream& out) const
+	{
+		std::vector<uint32_t> path;
+		char frame[16];
+		size_t i;
+
+		for (i = 0; i < nodes.size(); i++)
+		{
+			if (!nodes[i].instructions)
+				continue;
+
+			/* Walk up to the entry point, then print the path root first */
+			path.clear();
+
+			for (uint32_t node = (uint32_t)i; ; node = nodes[node].parent)
+			{
+				path.push_back(node);
+
+				if (!node)
+					break;
+			}
+
+			for (size_t depth = path.size(); depth > 0; depth--)
+			{
+				snprintf(frame, sizeof(frame), "sub_%03X", nodes[path[depth - 1]].address);
+				out << frame << (depth > 1 ? ";" : " ");
+			}
+
+			out << nodes[i].instructions << "\n";
+		}
+	}
+
+	#pragma endregion
+}
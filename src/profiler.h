@@ -0,0 +1,101 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "chip8.h"
+
+namespace CHIP8
+{
+	/* Dispatch tables an opcode goes through in the table dispatcher */
+	enum ProfileTable : uint8_t
+	{
+		PROFILE_TABLE, PROFILE_TABLE0, PROFILE_TABLE8, PROFILE_TABLEE, PROFILE_TABLEF,
+		PROFILE_TABLE_COUNT
+	};
+
+	/*
+	 * Guest-level profiler. Counts executions per address, per opcode and per dispatch table, index-relative
+	 * memory reads and writes per address, backward branches (loops), and instructions per call stack. The
+	 * call stack is built from 2NNN/00EE and mirrors the guest's stack pointer, so a ROM that unwinds by
+	 * jumping out of a subroutine is attributed the same way the hardware sees it.
+	 *
+	 * Attach with Chip8Processor::SetProfiler. The hooks only exist in builds with CHIP8_PROFILE=1; without it
+	 * Cycle does not test for a profiler at all.
+	 */
+	class Chip8Profiler
+	{
+		public:
+			static const unsigned int MEMORY_LOCATIONS = 4096;
+
+		private:
+			static const unsigned int MEMORY_MASK = MEMORY_LOCATIONS - 1;
+			static const unsigned int STACK_LEVELS = 16;
+			static const unsigned int START_ADDRESS = 0x200;
+
+			/* One node per distinct call path; node 0 is the entry point */
+			struct StackNode
+			{
+				uint32_t parent;
+				uint16_t address;
+				uint64_t instructions;
+			};
+
+			uint64_t instructions;
+			uint64_t pc_counts[MEMORY_LOCATIONS];
+			uint16_t pc_opcodes[MEMORY_LOCATIONS];
+			uint64_t opcode_counts[OP_COUNT];
+			uint64_t table_counts[PROFILE_TABLE_COUNT];
+			uint64_t reads[MEMORY_LOCATIONS];
+			uint64_t writes[MEMORY_LOCATIONS];
+
+			/* Taken backward branches keyed by (target << 16) | source */
+			std::unordered_map<uint32_t, uint64_t> loops;
+			uint16_t last_pc;
+			bool has_last_pc;
+
+			std::vector<StackNode> nodes;
+
+			/* Children of each node keyed by (parent, call target) */
+			std::map<std::pair<uint32_t, uint16_t>, uint32_t> children;
+
+			/* Call path node for each guest stack depth, indexed by sp */
+			uint32_t frames[STACK_LEVELS];
+			uint32_t current;
+
+			void WriteHeatmap(std::ostream& out, const uint64_t* counts) const;
+
+		public:
+			Chip8Profiler();
+
+			void Reset();
+
+			/* Called before the instruction at pc executes */
+			void OnExecute(uint16_t pc, uint16_t opcode);
+
+			/* Called after 2NNN or 00EE with the guest's new stack pointer */
+			void OnCall(uint8_t sp, uint16_t target);
+			void OnReturn(uint8_t sp);
+
+			/* Called by opcodes that read or write length bytes starting at the index register */
+			void OnRead(uint16_t address, unsigned int length);
+			void OnWrite(uint16_t address, unsigned int length);
+
+			uint64_t GetInstructionCount() const;
+
+			/* Human-readable summary: hottest addresses and loops, opcode mix, table counts and memory heatmaps */
+			void WriteReport(std::ostream& out, size_t top = 20) const;
+
+			/* One "frame;frame;... count" line per call path, for flamegraph.pl or speedscope */
+			void WriteFoldedStacks(std::ostream& out) const;
+
+			static const char* GetOpcodeName(uint8_t id);
+	};
+}
+
+#endif
@@ -0,0 +1,201 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "batch.h"
+#include "chip8.h"
+#include "inputlog.h"
+#include "rombundle.h"
+#include "scheduler.h"
+#include "video.h"
+
+/*
+ * Replays a session recorded with chip8 --record. The ROM is booted with the recorded seed and the keypad is
+ * set from the log before every frame, headless and as fast as the host allows, so a bug report or a long
+ * play session can be reproduced exactly and doubles as a benchmark. The final framebuffer and machine
+ * state hashes are the same for every engine and every run.
+ *
+ * --video FILE records the first run to FILE.y4m, FILE.gif or a FILE_NNNNNN.png sequence, each pixel
+ * --video-scale N pixels square. Encoding happens on a writer thread, so the timing barely moves.
+ *
+ * Usage: chip8-replay [--engine table|cached|jit] [--repeat N] [--video FILE] [--video-scale N] LOG ROM
+ */
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: chip8-replay [--engine table|cached|jit] [--repeat N] [--video FILE] [--video-scale N] LOG ROM" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	CHIP8::BatchEngine engine = CHIP8::ENGINE_TABLE;
+	unsigned int repeat = 1;
+	const char* videoFile = NULL;
+	CHIP8::VideoFormat videoFormat = CHIP8::VIDEO_Y4M;
+	unsigned int videoScale = 1;
+	const char* logFile = NULL;
+	const char* romFile = NULL;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--engine") && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+
+			if (!strcmp(name, "table"))
+				engine = CHIP8::ENGINE_TABLE;
+			else if (!strcmp(name, "cached"))
+				engine = CHIP8::ENGINE_DECODE_CACHE;
+			else if (!strcmp(name, "jit"))
+				engine = CHIP8::ENGINE_JIT;
+			else
+			{
+				PrintUsage();
+				return EXIT_FAILURE;
+			}
+		}
+		else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+			repeat = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--video") && i + 1 < argc)
+		{
+			videoFile = argv[++i];
+
+			if (!CHIP8::Chip8VideoSink::FormatFromPath(videoFile, videoFormat))
+			{
+				std::cerr << "Error: " << videoFile << " should end in .y4m, .png or .gif" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (!strcmp(argv[i], "--video-scale") && i + 1 < argc)
+			videoScale = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+		else if (!logFile)
+			logFile = argv[i];
+		else
+			romFile = argv[i];
+	}
+
+	if (!logFile || !romFile || repeat == 0 || videoScale == 0)
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	CHIP8::Chip8InputLog log;
+	std::vector<uint8_t> rom;
+
+	if (!log.Load(logFile))
+	{
+		std::cerr << "Error: Unable to read recording " << logFile << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (!CHIP8::ReadRomFile(romFile, rom))
+		return EXIT_FAILURE;
+
+	if (CHIP8::HashRom(rom.data(), rom.size()) != log.GetRomHash())
+	{
+		std::cerr << "Error: " << romFile << " is not the ROM " << logFile << " was recorded on" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<uint8_t> state(CHIP8::Chip8Processor::XO_STATE_SIZE);
+	uint64_t first_state_hash = 0;
+	uint64_t instructions = 0;
+	double best = 0.0;
+	unsigned int run;
+	CHIP8::Chip8VideoSink video;
+
+	if (videoFile && !video.Open(videoFile, videoFormat, videoScale))
+	{
+		std::cerr << "Error: Unable to write " << videoFile << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	for (run = 0; run < repeat; run++)
+	{
+		CHIP8::Chip8Processor chip8;
+		uint64_t frame;
+
+		chip8.LoadROM({ rom.data(), rom.size() });
+		chip8.SetRandomSeed(log.GetSeed());
+
+		if (engine == CHIP8::ENGINE_DECODE_CACHE)
+			chip8.SetDecodeCache(true);
+		else if (engine == CHIP8::ENGINE_JIT)
+			chip8.SetJit(true);
+
+		instructions = 0;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (frame = 0; frame < log.GetFrameCount(); frame++)
+		{
+			uint64_t count = CHIP8::Chip8Scheduler::InstructionsForFrame(log.GetInstructionsPerSecond(), frame);
+
+			chip8.SetKeypadMask(log.GetKeys(frame));
+			chip8.RunFrame(count);
+			instructions += count;
+
+			if (videoFile && run == 0)
+				video.AddFrame(chip8);
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (run == 0 || seconds < best)
+			best = seconds;
+
+		uint64_t state_hash = CHIP8::HashRom(state.data(), chip8.SaveState(state.data(), state.size()));
+
+		if (run == 0)
+		{
+			char line[512];
+
+			first_state_hash = state_hash;
+
+			snprintf(line, sizeof(line), "{\n  \"frames\": %llu,\n  \"keypad_changes\": %zu,\n  \"instructions\": %llu,\n"
+				"  \"display_hash\": \"%016llx\",\n  \"state_hash\": \"%016llx\",\n",
+				(unsigned long long)log.GetFrameCount(), log.GetEventCount(), (unsigned long long)instructions,
+				(unsigned long long)CHIP8::HashDisplayState(chip8),
+				(unsigned long long)state_hash);
+			std::cout << line;
+		}
+		else if (state_hash != first_state_hash)
+		{
+			/* Something outside the log leaked into the machine */
+			std::cerr << "Error: Run " << run + 1 << " ended in a different state than run 1" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (videoFile)
+	{
+		bool written = video.Close();
+		CHIP8::VideoStats stats = video.GetStats();
+
+		std::cerr << "Video: " << stats.frames << " frames, " << stats.duplicates << " unchanged, "
+			<< stats.stalls << " queue stalls, " << stats.bytes_written << " bytes" << std::endl;
+
+		if (!written)
+		{
+			std::cerr << "Error: Unable to write " << videoFile << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	char line[256];
+
+	snprintf(line, sizeof(line), "  \"repeat\": %u,\n  \"best_seconds\": %.6f,\n  \"instructions_per_second\": %.0f\n}\n",
+		repeat, best, best > 0.0 ? instructions / best : 0.0);
+	std::cout << line;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,345 @@
+#include "rewind.h"
+#include <chrono>
+#include <cstring>
+
+namespace CHIP8
+{
+	/* A literal run ends at the first stretch of this many unchanged bytes */
+	static const size_t MIN_ZERO_RUN = 4;
+
+	static void PutVarint(uint8_t*& out, size_t value)
+	{
+		while (value >= 0x80)
+		{
+			*out++ = (uint8_t)(value | 0x80);
+			value >>= 7;
+		}
+
+		*out++ = (uint8_t)value;
+	}
+
+	static size_t GetVarint(const uint8_t*& in, const uint8_t* end)
+	{
+		size_t value = 0;
+		unsigned int shift = 0;
+
+		while (in < end)
+		{
+			uint8_t byte = *in++;
+
+			value |= (size_t)(byte & 0x7F) << shift;
+
+			if (!(byte & 0x80))
+				break;
+
+			shift += 7;
+		}
+
+		return value;
+	}
+
+	#pragma region Chip8Rewind
+
+	Chip8Rewind::Chip8Rewind(size_t capacity, unsigned int keyframe_interval)
+		: ring(capacity), records(capacity / MIN_RECORD_BYTES + 1),
+		keyframe_interval(keyframe_interval < 1 ? 1 : keyframe_interval > MAX_KEYFRAME_INTERVAL ? MAX_KEYFRAME_INTERVAL : keyframe_interval),
+		keyframe(Chip8Processor::XO_STATE_SIZE), state_size(Chip8Processor::STATE_SIZE), state(Chip8Processor::XO_STATE_SIZE),
+		zeros(Chip8Processor::XO_STATE_SIZE), encoded(Chip8Processor::XO_STATE_SIZE * 2)
+	{
+		Clear();
+	}
+
+	void Chip8Rewind::Clear()
+	{
+		write_offset = 0;
+		bytes_used = 0;
+		sequence = 0;
+		count = 0;
+		keyframe_sequence = 0;
+		keyframes = 0;
+		captures = 0;
+		total_capture_us = 0.0;
+		max_capture_us = 0.0;
+	}
+
+	Chip8Rewind::Record& Chip8Rewind::RecordAt(uint64_t record_sequence)
+	{
+		return records[record_sequence % records.size()];
+	}
+
+	uint64_t Chip8Rewind::KeyframeOf(uint64_t record_sequence)
+	{
+		return record_sequence - RecordAt(record_sequence).keyframe_distance;
+	}
+
+	uint64_t Chip8Rewind::Oldest() const
+	{
+		return sequence - count;
+	}
+
+	uint64_t Chip8Rewind::GetFrameCount() const
+	{
+		return count;
+	}
+
+	RewindStats Chip8Rewind::GetStats() const
+	{
+		RewindStats stats;
+
+		stats.frames = count;
+		stats.keyframes = keyframes;
+		stats.bytes_used = bytes_used;
+		stats.capacity = ring.size();
+		stats.footprint = ring.size() + records.size() * sizeof(Record)
+			+ keyframe.size() + state.size() + zeros.size() + encoded.size();
+		stats.mean_capture_us = captures ? total_capture_us / captures : 0.0;
+		stats.max_capture_us = max_capture_us;
+
+		return stats;
+	}
+
+	#pragma endregion
+
+	#pragma region Ring
+
+	void Chip8Rewind::EvictOldest()
+	{
+		do
+		{
+			Record& record = RecordAt(Oldest());
+
+			if (!record.keyframe_distance)
+				keyframes--;
+
+			bytes_used -= record.size;
+			count--;
+
+			/* Deltas whose keyframe is gone cannot be restored, drop them with it */
+		} while (count && KeyframeOf(Oldest()) < Oldest());
+	}
+
+	size_t Chip8Rewind::Allocate(size_t size)
+	{
+		size_t offset = write_offset;
+		bool wrapped = false;
+
+		if (offset + size > ring.size())
+		{
+			offset = 0;
+			wrapped = true;
+		}
+
+		/*
+		 * Records between the write offset and the end of the ring are the oldest ones, in order. Evict those
+		 * the new record overlaps, and on wrap-around also those left stranded past the old write offset.
+		 */
+		while (count)
+		{
+			const Record& record = RecordAt(Oldest());
+			bool overlaps = record.offset < offset + size && offset < (size_t)record.offset + record.size;
+			bool stranded = wrapped && record.offset >= write_offset;
+
+			if (!overlaps && !stranded && count < records.size())
+				break;
+
+			EvictOldest();
+		}
+
+		write_offset = offset + size;
+
+		return offset;
+	}
+
+	#pragma endregion
+
+	#pragma region Delta Encoding
+
+	size_t Chip8Rewind::Encode(const uint8_t* current, const uint8_t* reference)
+	{
+		const size_t size = state_size;
+		uint8_t* out = encoded.data();
+		size_t i = 0;
+
+		while (i < size)
+		{
+			size_t run_start = i;
+			size_t literal_start;
+			uint64_t a, b;
+
+			/* Skip unchanged bytes a word at a time */
+			while (i + 8 <= size)
+			{
+				memcpy(&a, current + i, 8);
+				memcpy(&b, reference + i, 8);
+
+				if (a != b)
+					break;
+
+				i += 8;
+			}
+
+			while (i < size && current[i] == reference[i])
+				i++;
+
+			/* Trailing unchanged bytes are implied */
+			if (i == size)
+				break;
+
+			literal_start = i;
+
+			while (i < size)
+			{
+				size_t j = i;
+
+				while (j < size && j - i < MIN_ZERO_RUN && current[j] == reference[j])
+					j++;
+
+				if (j - i >= MIN_ZERO_RUN || j == size)
+					break;
+
+				i = (j == i) ? i + 1 : j;
+			}
+
+			PutVarint(out, literal_start - run_start);
+			PutVarint(out, i - literal_start);
+
+			for (; literal_start < i; literal_start++)
+				*out++ = current[literal_start] ^ reference[literal_start];
+		}
+
+		return out - encoded.data();
+	}
+
+	void Chip8Rewind::Decode(const uint8_t* data, size_t size, uint8_t* output, size_t output_size)
+	{
+		const uint8_t* end = data + size;
+		size_t position = 0;
+
+		while (data < end)
+		{
+			size_t skip = GetVarint(data, end);
+			size_t literal = GetVarint(data, end);
+
+			position += skip;
+
+			if (position > output_size || literal > output_size - position || literal > (size_t)(end - data))
+				return;
+
+			for (; literal; literal--)
+				output[position++] ^= *data++;
+		}
+	}
+
+	void Chip8Rewind::DecodeRecord(uint64_t record_sequence, uint8_t* output)
+	{
+		const Record& record = RecordAt(record_sequence);
+
+		if (!record.keyframe_distance)
+			memset(output, 0, state_size);
+		else
+			DecodeRecord(KeyframeOf(record_sequence), output);
+
+		Decode(&ring[record.offset], record.size, output, state_size);
+	}
+
+	#pragma endregion
+
+	#pragma region Capture and Rewind
+
+	void Chip8Rewind::Capture(const Chip8Processor& chip8)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool key;
+		size_t size, offset;
+		double elapsed;
+
+		size = chip8.SaveState(state.data(), state.size());
+
+		/* Deltas only make sense between states of the same layout */
+		if (size != state_size)
+		{
+			Clear();
+			state_size = size;
+		}
+
+		key = !count || sequence - keyframe_sequence >= keyframe_interval;
+
+		for (;;)
+		{
+			size = Encode(state.data(), key ? zeros.data() : keyframe.data());
+
+			if (size > ring.size())
+				return;
+
+			offset = Allocate(size);
+
+			/* Making room evicted the keyframe this delta was encoded against, store a keyframe instead */
+			if (key || (count && keyframe_sequence >= Oldest()))
+				break;
+
+			key = true;
+		}
+
+		Record& record = RecordAt(sequence);
+
+		record.offset = (uint32_t)offset;
+		record.size = (uint32_t)size;
+		record.keyframe_distance = key ? 0 : (uint16_t)(sequence - keyframe_sequence);
+		memcpy(&ring[offset], encoded.data(), size);
+
+		if (key)
+		{
+			keyframe_sequence = sequence;
+			memcpy(keyframe.data(), state.data(), state_size);
+			keyframes++;
+		}
+
+		sequence++;
+		count++;
+		bytes_used += size;
+
+		elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		total_capture_us += elapsed;
+		captures++;
+
+		if (elapsed > max_capture_us)
+			max_capture_us = elapsed;
+	}
+
+	bool Chip8Rewind::StepBack(Chip8Processor& chip8)
+	{
+		uint8_t keys[Chip8Processor::INPUT_KEYS];
+		uint64_t newest;
+
+		if (count < 2)
+			return false;
+
+		/* The newest record was the last one allocated, so its space is handed straight back */
+		newest = sequence - 1;
+		write_offset = RecordAt(newest).offset;
+		bytes_used -= RecordAt(newest).size;
+
+		if (!RecordAt(newest).keyframe_distance)
+			keyframes--;
+
+		sequence--;
+		count--;
+
+		DecodeRecord(sequence - 1, state.data());
+
+		memcpy(keys, chip8.GetKeypadState(), sizeof(keys));
+
+		if (!chip8.LoadState(state.data(), state_size))
+			return false;
+
+		memcpy(chip8.GetKeypadState(), keys, sizeof(keys));
+
+		/* Captures after rewinding are encoded against the restored frame's keyframe */
+		keyframe_sequence = KeyframeOf(sequence - 1);
+		DecodeRecord(keyframe_sequence, keyframe.data());
+
+		return true;
+	}
+
+	#pragma endregion
+}
@@ -0,0 +1,122 @@
+#ifndef _REWIND_H_
+#define _REWIND_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "chip8.h"
+
+namespace CHIP8
+{
+	/* Memory use and capture cost of a Chip8Rewind */
+	struct RewindStats
+	{
+		uint64_t frames;
+		uint64_t keyframes;
+		size_t bytes_used;
+		size_t capacity;
+
+		/* Everything allocated: the ring, the record index and scratch buffers */
+		size_t footprint;
+		double mean_capture_us;
+		double max_capture_us;
+	};
+
+	/*
+	 * Rewind history kept in a fixed-size byte ring. Every captured frame is a save state stored as the
+	 * XOR against the latest keyframe, run-length encoded so the unchanged bulk of memory and the framebuffer
+	 * costs a couple of bytes. A full keyframe (encoded against zero) is written every keyframe_interval
+	 * frames, so restoring any frame decodes at most two records.
+	 *
+	 * When the ring is full the oldest frames are dropped, together with any deltas whose keyframe went with
+	 * them. All buffers are allocated up front, large enough for XO-CHIP states; Capture and StepBack do not
+	 * allocate. A machine that switches memory size starts a new history.
+	 */
+	class Chip8Rewind
+	{
+		public:
+			static const size_t DEFAULT_CAPACITY = 8 * 1024 * 1024;
+			static const unsigned int DEFAULT_KEYFRAME_INTERVAL = 60;
+
+		private:
+			/* Smallest plausible record, used to size the index */
+			static const size_t MIN_RECORD_BYTES = 16;
+
+			/* Keyframes are at most this many records apart, so the distance fits a Record */
+			static const unsigned int MAX_KEYFRAME_INTERVAL = 0xFFFF;
+
+			/* Where a record lives in the ring, and how many records back its keyframe is (zero for a keyframe) */
+			struct Record
+			{
+				uint32_t offset;
+				uint32_t size;
+				uint16_t keyframe_distance;
+			};
+
+			std::vector<uint8_t> ring;
+			size_t write_offset;
+			size_t bytes_used;
+
+			/* Records indexed by sequence number modulo records.size(); newest is sequence - 1 */
+			std::vector<Record> records;
+			uint64_t sequence;
+			uint64_t count;
+
+			/* Sequence number of the keyframe new deltas are encoded against, and its decoded state */
+			uint64_t keyframe_sequence;
+			unsigned int keyframe_interval;
+			std::vector<uint8_t> keyframe;
+
+			/* Size of every state in the history: STATE_SIZE, or XO_STATE_SIZE for a machine with XO-CHIP memory */
+			size_t state_size;
+
+			/* Scratch space for the state being captured or restored, the all-zero keyframe reference and encodings */
+			std::vector<uint8_t> state;
+			std::vector<uint8_t> zeros;
+			std::vector<uint8_t> encoded;
+
+			uint64_t keyframes;
+			uint64_t captures;
+			double total_capture_us;
+			double max_capture_us;
+
+			Record& RecordAt(uint64_t record_sequence);
+			uint64_t KeyframeOf(uint64_t record_sequence);
+			uint64_t Oldest() const;
+
+			/* Evict old records until size bytes fit contiguously, and return where they go */
+			size_t Allocate(size_t size);
+			void EvictOldest();
+
+			/* XOR current against reference and run-length encode the result into encoded. Returns its size. */
+			size_t Encode(const uint8_t* current, const uint8_t* reference);
+
+			/* Apply an encoded delta to output, which holds the reference */
+			static void Decode(const uint8_t* data, size_t size, uint8_t* output, size_t output_size);
+
+			/* Decode the state recorded with the given sequence number into output */
+			void DecodeRecord(uint64_t record_sequence, uint8_t* output);
+
+		public:
+			explicit Chip8Rewind(size_t capacity = DEFAULT_CAPACITY, unsigned int keyframe_interval = DEFAULT_KEYFRAME_INTERVAL);
+
+			/* Record the processor's current state as the newest frame */
+			void Capture(const Chip8Processor& chip8);
+
+			/*
+			 * Drop the newest frame and restore the one before it. The keypad keeps its live state rather than
+			 * the recorded one. Returns false when there is no earlier frame.
+			 */
+			bool StepBack(Chip8Processor& chip8);
+
+			/* Forget all history */
+			void Clear();
+
+			/* Number of frames that can currently be rewound */
+			uint64_t GetFrameCount() const;
+
+			RewindStats GetStats() const;
+	};
+}
+
+#endif
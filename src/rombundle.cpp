@@ -0,0 +1,433 @@
+#include "rombundle.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace CHIP8
+{
+	static const unsigned int START_ADDRESS = 0x200;
+
+	static void PutLE(std::vector<uint8_t>& out, size_t offset, uint64_t value, unsigned int bytes)
+	{
+		unsigned int i;
+
+		for (i = 0; i < bytes; i++)
+			out[offset + i] = (uint8_t)(value >> (8 * i));
+	}
+
+	static uint64_t GetLE(const uint8_t* in, unsigned int bytes)
+	{
+		uint64_t value = 0;
+		unsigned int i;
+
+		for (i = 0; i < bytes; i++)
+			value |= (uint64_t)in[i] << (8 * i);
+
+		return value;
+	}
+
+	#pragma region Platform Detection
+
+	/* Opcodes only SUPER-CHIP defines: 00CN, 00FB-00FF, DXY0 (16x16 sprite), FX30, FX75, FX85 */
+	static bool IsSuperChipOpcode(uint16_t opcode)
+	{
+		switch (opcode >> 12U)
+		{
+			case 0x0:
+				return (opcode & 0xFFF0U) == 0x00C0U || (opcode >= 0x00FBU && opcode <= 0x00FFU);
+
+			case 0xD:
+				return (opcode & 0x000FU) == 0;
+
+			case 0xF:
+				return (opcode & 0x00FFU) == 0x30U || (opcode & 0x00FFU) == 0x75U || (opcode & 0x00FFU) == 0x85U;
+
+			default:
+				return false;
+		}
+	}
+
+	RomPlatform DetectPlatform(const uint8_t* data, size_t size)
+	{
+		std::vector<bool> visited(size, false);
+		std::vector<size_t> pending;
+
+		if (size >= 2 && data[0] == 0x12 && data[1] == 0x60)
+			return PLATFORM_CHIP8_HIRES;
+
+		pending.push_back(0);
+
+		while (!pending.empty())
+		{
+			size_t offset = pending.back();
+			pending.pop_back();
+
+			if (offset + 1 >= size || visited[offset])
+				continue;
+
+			visited[offset] = true;
+
+			uint16_t opcode = (uint16_t)((data[offset] << 8U) | data[offset + 1]);
+			unsigned int group = opcode >> 12U;
+			size_t target = (opcode & 0x0FFFU) - START_ADDRESS;
+
+			if (IsSuperChipOpcode(opcode))
+				return PLATFORM_SCHIP;
+
+			/* Returns, exits and computed jumps end the path; jumps go on at their target only */
+			if (opcode == 0x00EE || opcode == 0x00FD || group == 0xB)
+				continue;
+
+			if (group == 0x1 || group == 0x2)
+			{
+				if ((opcode & 0x0FFFU) >= START_ADDRESS)
+					pending.push_back(target);
+
+				if (group == 0x1)
+					continue;
+			}
+
+			/* Skips continue at both the next and the one after */
+			if (group == 0x3 || group == 0x4 || ((group == 0x5 || group == 0x9) && (opcode & 0x000FU) == 0)
+				|| (group == 0xE && ((opcode & 0x00FFU) == 0x9E || (opcode & 0x00FFU) == 0xA1)))
+				pending.push_back(offset + 4);
+
+			pending.push_back(offset + 2);
+		}
+
+		return PLATFORM_CHIP8;
+	}
+
+	const char* GetPlatformName(RomPlatform platform)
+	{
+		switch (platform)
+		{
+			case PLATFORM_CHIP8_HIRES:
+				return "chip8-hires";
+
+			case PLATFORM_SCHIP:
+				return "schip";
+
+			default:
+				return "chip8";
+		}
+	}
+
+	uint64_t HashRom(const uint8_t* data, size_t size)
+	{
+		const uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+		const uint64_t FNV_PRIME = 0x100000001B3ULL;
+
+		uint64_t hash = FNV_OFFSET_BASIS;
+		size_t i;
+
+		for (i = 0; i < size; i++)
+		{
+			hash ^= data[i];
+			hash *= FNV_PRIME;
+		}
+
+		return hash;
+	}
+
+	#pragma endregion
+
+	#pragma region Chip8RomBundle
+
+	Chip8RomBundle::Chip8RomBundle() : mapping(NULL), mapping_size(0)
+	{
+#if defined(_WIN32)
+		file_handle = INVALID_HANDLE_VALUE;
+		mapping_handle = NULL;
+#else
+		fd = -1;
+#endif
+	}
+
+	Chip8RomBundle::~Chip8RomBundle()
+	{
+		Close();
+	}
+
+	bool Chip8RomBundle::Open(const char* path)
+	{
+		Close();
+
+#if defined(_WIN32)
+		LARGE_INTEGER size;
+
+		file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if (file_handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_handle, &size) || size.QuadPart < (LONGLONG)HEADER_SIZE)
+		{
+			Close();
+			return false;
+		}
+
+		mapping_size = (size_t)size.QuadPart;
+		mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+		if (mapping_handle)
+			mapping = (const uint8_t*)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+#else
+		struct stat info;
+
+		fd = open(path, O_RDONLY);
+
+		if (fd < 0 || fstat(fd, &info) != 0 || (size_t)info.st_size < HEADER_SIZE)
+		{
+			Close();
+			return false;
+		}
+
+		mapping_size = (size_t)info.st_size;
+
+		void* view = mmap(NULL, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+		mapping = view == MAP_FAILED ? NULL : (const uint8_t*)view;
+#endif
+
+		if (!mapping || !ReadIndex())
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void Chip8RomBundle::Close()
+	{
+#if defined(_WIN32)
+		if (mapping)
+			UnmapViewOfFile(mapping);
+
+		if (mapping_handle)
+			CloseHandle(mapping_handle);
+
+		if (file_handle != INVALID_HANDLE_VALUE)
+			CloseHandle(file_handle);
+
+		mapping_handle = NULL;
+		file_handle = INVALID_HANDLE_VALUE;
+#else
+		if (mapping)
+			munmap((void*)mapping, mapping_size);
+
+		if (fd >= 0)
+			close(fd);
+
+		fd = -1;
+#endif
+
+		mapping = NULL;
+		mapping_size = 0;
+		entries.clear();
+	}
+
+	bool Chip8RomBundle::IsOpen() const
+	{
+		return mapping != NULL;
+	}
+
+	size_t Chip8RomBundle::GetCount() const
+	{
+		return entries.size();
+	}
+
+	const RomEntry& Chip8RomBundle::GetEntry(size_t index) const
+	{
+		return entries[index];
+	}
+
+	const RomEntry* Chip8RomBundle::Find(const char* name) const
+	{
+		std::vector<RomEntry>::const_iterator entry = std::lower_bound(entries.begin(), entries.end(), name,
+			[](const RomEntry& a, const char* b) { return strcmp(a.name, b) < 0; });
+
+		return entry != entries.end() && !strcmp(entry->name, name) ? &*entry : NULL;
+	}
+
+	bool Chip8RomBundle::ReadIndex()
+	{
+		uint64_t count, index_offset, file_size;
+		size_t i;
+
+		if (memcmp(mapping, "C8RB", 4) || GetLE(mapping + 4, 2) != VERSION)
+			return false;
+
+		count = GetLE(mapping + 8, 4);
+		index_offset = GetLE(mapping + 12, 4);
+		file_size = GetLE(mapping + 24, 8);
+
+		/* A truncated or padded file is not the one that was packed */
+		if (file_size != mapping_size || index_offset > mapping_size || count > (mapping_size - index_offset) / ENTRY_SIZE)
+			return false;
+
+		entries.resize((size_t)count);
+
+		for (i = 0; i < count; i++)
+		{
+			const uint8_t* record = mapping + index_offset + i * ENTRY_SIZE;
+			uint64_t image_offset = GetLE(record + 8, 4);
+			uint64_t image_size = GetLE(record + 12, 4);
+			uint64_t name_offset = GetLE(record + 16, 4);
+			uint64_t name_length = GetLE(record + 20, 2);
+			RomEntry& entry = entries[i];
+
+			/* Everything an entry points at has to lie inside the file, and names need their terminator */
+			if (image_size > MAX_ROM_SIZE || image_offset > mapping_size || image_size > mapping_size - image_offset
+				|| name_offset >= mapping_size || name_length >= mapping_size - name_offset || mapping[name_offset + name_length] != '\0')
+				return false;
+
+			entry.hash = GetLE(record, 8);
+			entry.image.data = mapping + image_offset;
+			entry.image.size = (size_t)image_size;
+			entry.name = (const char*)(mapping + name_offset);
+			entry.platform = record[22] <= PLATFORM_SCHIP ? (RomPlatform)record[22] : PLATFORM_CHIP8;
+
+			/* Find relies on the packer's ordering */
+			if (i > 0 && strcmp(entries[i - 1].name, entry.name) >= 0)
+				return false;
+		}
+
+		return true;
+	}
+
+	#pragma endregion
+
+	#pragma region Packing
+
+	bool ReadRomFile(const char* path, std::vector<uint8_t>& image)
+	{
+		FILE* rom = fopen(path, "rb");
+		size_t size;
+
+		image.clear();
+
+		if (!rom)
+		{
+			std::cerr << "Unable to read ROM file " << path << std::endl;
+			return false;
+		}
+
+		/* One byte more than fits, so an oversized file is caught without asking for its size */
+		image.resize(Chip8RomBundle::MAX_ROM_SIZE + 1);
+		size = fread(image.data(), 1, image.size(), rom);
+		fclose(rom);
+
+		if (size > Chip8RomBundle::MAX_ROM_SIZE)
+		{
+			std::cerr << "ROM file " << path << " does not fit in memory" << std::endl;
+			image.clear();
+			return false;
+		}
+
+		image.resize(size);
+
+		return true;
+	}
+
+	int Chip8RomBundle::Pack(const char* path, const std::vector<std::string>& files)
+	{
+		struct Image
+		{
+			std::string name;
+			std::vector<uint8_t> data;
+		};
+
+		std::vector<Image> images;
+		size_t names_size = 0;
+		size_t images_size = 0;
+		size_t i;
+
+		for (const std::string& file : files)
+		{
+			std::vector<uint8_t> data;
+
+			if (ReadRomFile(file.c_str(), data))
+				images.push_back({ file, data });
+		}
+
+		std::sort(images.begin(), images.end(), [](const Image& a, const Image& b) { return a.name < b.name; });
+		images.erase(std::unique(images.begin(), images.end(), [](const Image& a, const Image& b) { return a.name == b.name; }), images.end());
+
+		for (const Image& image : images)
+		{
+			names_size += image.name.size() + 1;
+			images_size += image.data.size();
+		}
+
+		size_t index_offset = HEADER_SIZE;
+		size_t names_offset = index_offset + images.size() * ENTRY_SIZE;
+		size_t images_offset = names_offset + names_size;
+		size_t file_size = images_offset + images_size;
+		size_t name_offset = names_offset;
+		size_t image_offset = images_offset;
+		std::vector<uint8_t> bundle(file_size, 0);
+
+		if (file_size > 0xFFFFFFFFU)
+		{
+			std::cerr << "Bundle " << path << " would exceed 4 GB" << std::endl;
+			return -1;
+		}
+
+		memcpy(bundle.data(), "C8RB", 4);
+		PutLE(bundle, 4, VERSION, 2);
+		PutLE(bundle, 8, images.size(), 4);
+		PutLE(bundle, 12, index_offset, 4);
+		PutLE(bundle, 16, names_offset, 4);
+		PutLE(bundle, 20, images_offset, 4);
+		PutLE(bundle, 24, file_size, 8);
+
+		for (i = 0; i < images.size(); i++)
+		{
+			const Image& image = images[i];
+			size_t record = index_offset + i * ENTRY_SIZE;
+
+			PutLE(bundle, record, HashRom(image.data.data(), image.data.size()), 8);
+			PutLE(bundle, record + 8, image_offset, 4);
+			PutLE(bundle, record + 12, image.data.size(), 4);
+			PutLE(bundle, record + 16, name_offset, 4);
+			PutLE(bundle, record + 20, image.name.size(), 2);
+			bundle[record + 22] = DetectPlatform(image.data.data(), image.data.size());
+
+			memcpy(&bundle[name_offset], image.name.c_str(), image.name.size() + 1);
+			name_offset += image.name.size() + 1;
+
+			if (!image.data.empty())
+				memcpy(&bundle[image_offset], image.data.data(), image.data.size());
+
+			image_offset += image.data.size();
+		}
+
+		FILE* out = fopen(path, "wb");
+
+		if (!out)
+		{
+			std::cerr << "Unable to create bundle " << path << std::endl;
+			return -1;
+		}
+
+		bool written = fwrite(bundle.data(), 1, bundle.size(), out) == bundle.size();
+
+		if (fclose(out) != 0 || !written)
+		{
+			std::cerr << "Unable to write bundle " << path << std::endl;
+			return -1;
+		}
+
+		return (int)images.size();
+	}
+
+	#pragma endregion
+}
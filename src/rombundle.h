@@ -0,0 +1,108 @@
+#ifndef _ROMBUNDLE_H_
+#define _ROMBUNDLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "chip8.h"
+
+namespace CHIP8
+{
+	/* Machine a ROM was written for */
+	enum RomPlatform : uint8_t
+	{
+		PLATFORM_CHIP8,
+
+		/* COSMAC VIP two-page 64x64 mode, announced by a jump to 0x260 at the start address */
+		PLATFORM_CHIP8_HIRES,
+
+		/* SUPER-CHIP: scrolling, 128x64 mode, 16x16 sprites */
+		PLATFORM_SCHIP
+	};
+
+	/*
+	 * Detect the platform of a ROM image. Code is found by following jumps, calls and skips from the start
+	 * address, so sprite data that happens to look like a SUPER-CHIP opcode is not mistaken for one.
+	 */
+	RomPlatform DetectPlatform(const uint8_t* data, size_t size);
+
+	const char* GetPlatformName(RomPlatform platform);
+
+	/* Content hash of a ROM image (64-bit FNV-1a) */
+	uint64_t HashRom(const uint8_t* data, size_t size);
+
+	/* Read a ROM file whole. Reports and returns false if it cannot be read or does not fit in memory. */
+	bool ReadRomFile(const char* path, std::vector<uint8_t>& image);
+
+	/* One ROM in a bundle. image and name point into the mapping and stay valid until the bundle is closed. */
+	struct RomEntry
+	{
+		const char* name;
+		ByteSpan image;
+		uint64_t hash;
+		RomPlatform platform;
+	};
+
+	/*
+	 * A set of ROMs packed into one indexed file, so a batch over hundreds of ROMs opens and maps a single file
+	 * instead of hundreds. The index is sorted by name. Loading a ROM copies it straight from the mapping into
+	 * the processor's memory.
+	 *
+	 * Layout, little-endian: a 32-byte header ("C8RB", version, count, offsets of the index, the names and the
+	 * images, and the file size), one ENTRY_SIZE record per ROM (hash, image offset and size, name offset and
+	 * length, platform), the NUL-terminated names, then the images back to back.
+	 */
+	class Chip8RomBundle
+	{
+		public:
+			static const uint16_t VERSION = 1;
+
+			/* Largest image that fits between the start address and the end of XO-CHIP memory */
+			static const size_t MAX_ROM_SIZE = 65536 - 0x200;
+
+		private:
+			static const size_t HEADER_SIZE = 32;
+			static const size_t ENTRY_SIZE = 24;
+
+			const uint8_t* mapping;
+			size_t mapping_size;
+			std::vector<RomEntry> entries;
+
+#if defined(_WIN32)
+			void* file_handle;
+			void* mapping_handle;
+#else
+			int fd;
+#endif
+
+			/* Check the header and every entry against the file size, then build entries */
+			bool ReadIndex();
+
+		public:
+			Chip8RomBundle();
+			~Chip8RomBundle();
+
+			Chip8RomBundle(const Chip8RomBundle&) = delete;
+			Chip8RomBundle& operator=(const Chip8RomBundle&) = delete;
+
+			/* Map a bundle read-only. Returns false if it cannot be opened or is not a valid bundle. */
+			bool Open(const char* path);
+			void Close();
+			bool IsOpen() const;
+
+			size_t GetCount() const;
+			const RomEntry& GetEntry(size_t index) const;
+
+			/* Look a ROM up by the name it was packed under. Returns NULL if there is none. */
+			const RomEntry* Find(const char* name) const;
+
+			/*
+			 * Write a bundle of the given ROM files to path, named as given. Files that cannot be read or do not
+			 * fit in memory are reported and left out. Returns the number of ROMs written, or -1 on failure.
+			 */
+			static int Pack(const char* path, const std::vector<std::string>& files);
+	};
+}
+
+#endif
@@ -0,0 +1,197 @@
+#include "scheduler.h"
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+namespace CHIP8
+{
+	#pragma region Chip8Scheduler
+
+	Chip8Scheduler::Chip8Scheduler(Chip8Processor& chip8, unsigned int instructions_per_second)
+		: chip8(chip8), instructions_per_second(instructions_per_second), start(Clock::now()), frame(0),
+		emulated_frame(0), turbo(false), turbo_speed(DEFAULT_TURBO_SPEED), paused(false), input_log(NULL), beeper(NULL), timed_frames(0), dropped_frames(0),
+		total_jitter(0.0), max_jitter(0.0)
+	{
+#if defined(_WIN32)
+		/* The default 15.6 ms timer resolution is too coarse to sleep between 16.7 ms frames */
+		timeBeginPeriod(1);
+#endif
+	}
+
+	Chip8Scheduler::~Chip8Scheduler()
+	{
+#if defined(_WIN32)
+		timeEndPeriod(1);
+#endif
+	}
+
+	void Chip8Scheduler::SetInstructionsPerSecond(unsigned int instructions_per_second)
+	{
+		this->instructions_per_second = instructions_per_second;
+	}
+
+	unsigned int Chip8Scheduler::GetInstructionsPerSecond() const
+	{
+		return instructions_per_second;
+	}
+
+	void Chip8Scheduler::SetTurbo(bool enabled)
+	{
+		turbo = enabled;
+	}
+
+	void Chip8Scheduler::SetTurboSpeed(unsigned int turbo_speed)
+	{
+		this->turbo_speed = turbo_speed;
+	}
+
+	bool Chip8Scheduler::GetTurbo() const
+	{
+		return turbo;
+	}
+
+	void Chip8Scheduler::SetPaused(bool paused)
+	{
+		this->paused = paused;
+	}
+
+	void Chip8Scheduler::SetInputLog(Chip8InputLog* input_log)
+	{
+		this->input_log = input_log;
+	}
+
+	void Chip8Scheduler::SetBeeper(Chip8Beeper* beeper)
+	{
+		this->beeper = beeper;
+	}
+
+	uint64_t Chip8Scheduler::InstructionsForFrame(uint64_t frame_number) const
+	{
+		return InstructionsForFrame(instructions_per_second, frame_number);
+	}
+
+	uint64_t Chip8Scheduler::InstructionsForFrame(unsigned int instructions_per_second, uint64_t frame_number)
+	{
+		uint64_t second_frame = frame_number % FRAMES_PER_SECOND;
+
+		return (instructions_per_second * (second_frame + 1)) / FRAMES_PER_SECOND
+			- (instructions_per_second * second_frame) / FRAMES_PER_SECOND;
+	}
+
+	Chip8Scheduler::Clock::time_point Chip8Scheduler::Deadline(uint64_t frame_number) const
+	{
+		return start + std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<double>((double)frame_number / FRAMES_PER_SECOND));
+	}
+
+	#pragma endregion
+
+	#pragma region Frames
+
+	void Chip8Scheduler::RunEmulatedFrame()
+	{
+		if (input_log)
+			input_log->Record(emulated_frame, chip8.GetKeypadMask());
+
+		chip8.RunFrame(InstructionsForFrame(emulated_frame++));
+
+		if (beeper)
+			beeper->RenderFrame(chip8);
+	}
+
+	unsigned int Chip8Scheduler::RunHostFrame()
+	{
+		unsigned int frames_run = 0;
+		unsigned int i;
+
+		if (!turbo)
+		{
+			RunEmulatedFrame();
+			frames_run = 1;
+		}
+		else if (turbo_speed != TURBO_UNCAPPED)
+		{
+			for (i = 0; i < turbo_speed; i++)
+				RunEmulatedFrame();
+
+			frames_run = turbo_speed;
+		}
+		else
+		{
+			/* Leave a tenth of the host frame for input and presenting */
+			Clock::time_point budget = Deadline(frame) + (Deadline(frame + 1) - Deadline(frame)) * 9 / 10;
+
+			do
+			{
+				RunEmulatedFrame();
+				frames_run++;
+			} while (Clock::now() < budget);
+		}
+
+		return frames_run;
+	}
+
+	unsigned int Chip8Scheduler::Update()
+	{
+		Clock::time_point now = Clock::now();
+		unsigned int frames_run = 0;
+
+		/* After a long stall (debugger, window drag) skip ahead rather than fast-forwarding through it */
+		if (now - Deadline(frame) > std::chrono::duration<double>((double)MAX_FRAMES_BEHIND / FRAMES_PER_SECOND))
+		{
+			uint64_t behind = (uint64_t)(std::chrono::duration<double>(now - start).count() * FRAMES_PER_SECOND);
+
+			dropped_frames += behind - frame;
+			frame = behind;
+		}
+
+		while (Deadline(frame) <= now)
+		{
+			double jitter = std::chrono::duration<double, std::milli>(now - Deadline(frame)).count();
+
+			total_jitter += jitter;
+			timed_frames++;
+
+			if (jitter > max_jitter)
+				max_jitter = jitter;
+
+			if (!paused)
+				frames_run += RunHostFrame();
+			else if (beeper)
+				beeper->Stop();
+
+			frame++;
+			now = Clock::now();
+		}
+
+		return frames_run;
+	}
+
+	void Chip8Scheduler::WaitForNextFrame()
+	{
+		std::this_thread::sleep_until(Deadline(frame));
+	}
+
+	void Chip8Scheduler::Resync()
+	{
+		start += Clock::now() - Deadline(frame);
+	}
+
+	FrameTiming Chip8Scheduler::GetFrameTiming() const
+	{
+		FrameTiming timing;
+
+		timing.frames = timed_frames;
+		timing.emulated_frames = emulated_frame;
+		timing.dropped_frames = dropped_frames;
+		timing.mean_jitter_ms = timed_frames ? total_jitter / timed_frames : 0.0;
+		timing.max_jitter_ms = max_jitter;
+
+		return timing;
+	}
+
+	#pragma endregion
+}
@@ -0,0 +1,124 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <chrono>
+#include <cstdint>
+#include "beeper.h"
+#include "chip8.h"
+#include "inputlog.h"
+
+namespace CHIP8
+{
+	/* How far actual frame starts drifted from their deadlines */
+	struct FrameTiming
+	{
+		uint64_t frames;
+		uint64_t emulated_frames;
+		uint64_t dropped_frames;
+		double mean_jitter_ms;
+		double max_jitter_ms;
+	};
+
+	/*
+	 * Paces a Chip8Processor in real time on a monotonic clock. Each 60 Hz frame runs the configured number of
+	 * instructions through RunFrame, which ticks the timers at the frame boundary, and the host thread sleeps
+	 * until the next frame is due instead of busy-waiting.
+	 *
+	 * In turbo mode each host frame runs several emulated frames (or, at TURBO_UNCAPPED, as many as fit in
+	 * the host frame), each ticking the timers, so emulated time stays consistent while the window only
+	 * renders once per host frame.
+	 */
+	class Chip8Scheduler
+	{
+		public:
+			static const unsigned int FRAMES_PER_SECOND = 60;
+			static const unsigned int DEFAULT_INSTRUCTIONS_PER_SECOND = 500;
+
+			/* Frames further behind than this are dropped instead of run back to back to catch up */
+			static const unsigned int MAX_FRAMES_BEHIND = 5;
+
+			/* Turbo speed that runs as many frames as the host allows */
+			static const unsigned int TURBO_UNCAPPED = 0;
+			static const unsigned int DEFAULT_TURBO_SPEED = TURBO_UNCAPPED;
+
+		private:
+			typedef std::chrono::steady_clock Clock;
+
+			Chip8Processor& chip8;
+			unsigned int instructions_per_second;
+
+			Clock::time_point start;
+
+			/* Host frames elapsed and emulated frames run; they only differ in turbo mode */
+			uint64_t frame;
+			uint64_t emulated_frame;
+
+			bool turbo;
+			unsigned int turbo_speed;
+			bool paused;
+
+			/* Receives the keypad state of every emulated frame while recording */
+			Chip8InputLog* input_log;
+
+			/* Renders the buzzer for every emulated frame when audio is on */
+			Chip8Beeper* beeper;
+
+			/* Jitter accumulators */
+			uint64_t timed_frames;
+			uint64_t dropped_frames;
+			double total_jitter;
+			double max_jitter;
+
+			Clock::time_point Deadline(uint64_t frame_number) const;
+
+			/* Record the keypad if asked to, run the next emulated frame, then render its audio */
+			void RunEmulatedFrame();
+
+			/* Run the emulated frames for the current host frame. Returns how many were run. */
+			unsigned int RunHostFrame();
+
+		public:
+			explicit Chip8Scheduler(Chip8Processor& chip8, unsigned int instructions_per_second = DEFAULT_INSTRUCTIONS_PER_SECOND);
+			~Chip8Scheduler();
+
+			void SetInstructionsPerSecond(unsigned int instructions_per_second);
+			unsigned int GetInstructionsPerSecond() const;
+
+			/* Fast-forward at turbo_speed emulated frames per host frame, or uncapped at TURBO_UNCAPPED */
+			void SetTurbo(bool enabled);
+			void SetTurboSpeed(unsigned int turbo_speed);
+			bool GetTurbo() const;
+
+			/* While paused, host frames keep their pacing but no emulated frames are run */
+			void SetPaused(bool paused);
+
+			/*
+			 * Instructions to run in the given frame. Spreads instructions_per_second over 60 frames so rates
+			 * that are not a multiple of 60 still average out exactly.
+			 */
+			uint64_t InstructionsForFrame(uint64_t frame_number) const;
+			static uint64_t InstructionsForFrame(unsigned int instructions_per_second, uint64_t frame_number);
+
+			/* Record the keys held during every emulated frame from now on into input_log, or stop with NULL */
+			void SetInputLog(Chip8InputLog* input_log);
+
+			/* Render the sound of every emulated frame into beeper from now on, or stop with NULL */
+			void SetBeeper(Chip8Beeper* beeper);
+
+			/* Run every frame that is due. Returns the number of emulated frames run. */
+			unsigned int Update();
+
+			/* Sleep until the next frame is due */
+			void WaitForNextFrame();
+
+			/*
+			 * Make the next frame due now. Call after the host deliberately slept through frames, such as while
+			 * the machine waited for input, so they are neither run to catch up nor counted as dropped.
+			 */
+			void Resync();
+
+			FrameTiming GetFrameTiming() const;
+	};
+}
+
+#endif
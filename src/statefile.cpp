@@ -0,0 +1,179 @@
+#include "statefile.h"
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace CHIP8
+{
+	#pragma region Chip8StateFile
+
+	Chip8StateFile::Chip8StateFile() : mapping(NULL), sequence(0)
+	{
+#if defined(_WIN32)
+		file_handle = INVALID_HANDLE_VALUE;
+		mapping_handle = NULL;
+#else
+		fd = -1;
+#endif
+	}
+
+	Chip8StateFile::~Chip8StateFile()
+	{
+		Close();
+	}
+
+	bool Chip8StateFile::Open(const char* path)
+	{
+		unsigned int slot;
+
+		Close();
+
+#if defined(_WIN32)
+		file_handle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if (file_handle == INVALID_HANDLE_VALUE)
+			return false;
+
+		/* Mapping past the end of the file grows it to FILE_SIZE */
+		mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READWRITE, 0, (DWORD)FILE_SIZE, NULL);
+
+		if (mapping_handle)
+			mapping = (uint8_t*)MapViewOfFile(mapping_handle, FILE_MAP_ALL_ACCESS, 0, 0, FILE_SIZE);
+#else
+		struct stat info;
+
+		fd = open(path, O_RDWR | O_CREAT, 0644);
+
+		if (fd < 0)
+			return false;
+
+		/* A file of any other size is from another format, start it over */
+		if (fstat(fd, &info) == 0 && (size_t)info.st_size != FILE_SIZE)
+		{
+			if (ftruncate(fd, 0) != 0 || ftruncate(fd, FILE_SIZE) != 0)
+			{
+				Close();
+				return false;
+			}
+		}
+
+		void* view = mmap(NULL, FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		mapping = view == MAP_FAILED ? NULL : (uint8_t*)view;
+#endif
+
+		if (!mapping)
+		{
+			Close();
+			return false;
+		}
+
+		if (memcmp(mapping, "C8SF", 4))
+		{
+			memset(mapping, 0, FILE_SIZE);
+			memcpy(mapping, "C8SF", 4);
+		}
+
+		for (slot = 0; slot < 2; slot++)
+		{
+			if (SlotSequence(slot) > sequence)
+				sequence = SlotSequence(slot);
+		}
+
+		return true;
+	}
+
+	void Chip8StateFile::Close()
+	{
+#if defined(_WIN32)
+		if (mapping)
+			UnmapViewOfFile(mapping);
+
+		if (mapping_handle)
+			CloseHandle(mapping_handle);
+
+		if (file_handle != INVALID_HANDLE_VALUE)
+			CloseHandle(file_handle);
+
+		mapping_handle = NULL;
+		file_handle = INVALID_HANDLE_VALUE;
+#else
+		if (mapping)
+			munmap(mapping, FILE_SIZE);
+
+		if (fd >= 0)
+			close(fd);
+
+		fd = -1;
+#endif
+
+		mapping = NULL;
+		sequence = 0;
+	}
+
+	bool Chip8StateFile::IsOpen() const
+	{
+		return mapping != NULL;
+	}
+
+	uint8_t* Chip8StateFile::Slot(unsigned int slot) const
+	{
+		return mapping + FILE_HEADER_SIZE + slot * SLOT_SIZE;
+	}
+
+	uint64_t Chip8StateFile::SlotSequence(unsigned int slot) const
+	{
+		uint64_t value;
+
+		memcpy(&value, Slot(slot), sizeof(value));
+
+		return value;
+	}
+
+	#pragma endregion
+
+	#pragma region Save and Restore
+
+	bool Chip8StateFile::Save(const Chip8Processor& chip8)
+	{
+		uint8_t* slot;
+
+		if (!mapping)
+			return false;
+
+		/* Slot 0 holds odd sequence numbers and slot 1 even ones, so the newest state is never overwritten */
+		sequence++;
+		slot = Slot(sequence & 1 ? 0 : 1);
+
+		if (!chip8.SaveState(slot + SLOT_HEADER_SIZE, Chip8Processor::XO_STATE_SIZE))
+			return false;
+
+		memcpy(slot, &sequence, sizeof(sequence));
+
+		return true;
+	}
+
+	bool Chip8StateFile::Restore(Chip8Processor& chip8)
+	{
+		unsigned int newest;
+
+		if (!mapping || !sequence)
+			return false;
+
+		newest = SlotSequence(0) > SlotSequence(1) ? 0 : 1;
+
+		/* Fall back to the older slot if the newest one was torn by a crash */
+		if (chip8.LoadState(Slot(newest) + SLOT_HEADER_SIZE, Chip8Processor::XO_STATE_SIZE))
+			return true;
+
+		return SlotSequence(newest ^ 1) && chip8.LoadState(Slot(newest ^ 1) + SLOT_HEADER_SIZE, Chip8Processor::XO_STATE_SIZE);
+	}
+
+	#pragma endregion
+}
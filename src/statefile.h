@@ -0,0 +1,60 @@
+#ifndef _STATEFILE_H_
+#define _STATEFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "chip8.h"
+
+namespace CHIP8
+{
+	/*
+	 * Keeps the latest save state in a memory-mapped file so a restarted emulator resumes where it stopped.
+	 * The file holds two slots that are written alternately, each tagged with a sequence number, so a process
+	 * killed in the middle of Save still leaves the previous state intact. Slots are sized for an XO-CHIP state;
+	 * a Chip-8 state only touches its first pages. Saving is a copy into the mapping; the kernel writes it back
+	 * in the background.
+	 */
+	class Chip8StateFile
+	{
+		private:
+			static const size_t FILE_HEADER_SIZE = 16;
+			static const size_t SLOT_HEADER_SIZE = 8;
+			static const size_t SLOT_SIZE = SLOT_HEADER_SIZE + Chip8Processor::XO_STATE_SIZE;
+			static const size_t FILE_SIZE = FILE_HEADER_SIZE + 2 * SLOT_SIZE;
+
+			uint8_t* mapping;
+
+			/* Sequence number of the most recently written slot */
+			uint64_t sequence;
+
+#if defined(_WIN32)
+			void* file_handle;
+			void* mapping_handle;
+#else
+			int fd;
+#endif
+
+			uint8_t* Slot(unsigned int slot) const;
+			uint64_t SlotSequence(unsigned int slot) const;
+
+		public:
+			Chip8StateFile();
+			~Chip8StateFile();
+
+			Chip8StateFile(const Chip8StateFile&) = delete;
+			Chip8StateFile& operator=(const Chip8StateFile&) = delete;
+
+			/* Map the file at path, creating it if needed. A file in another format is reset. Returns false on failure. */
+			bool Open(const char* path);
+			void Close();
+			bool IsOpen() const;
+
+			/* Write the processor's state into the older slot */
+			bool Save(const Chip8Processor& chip8);
+
+			/* Restore the newest valid state. Returns false if the file holds none. */
+			bool Restore(Chip8Processor& chip8);
+	};
+}
+
+#endif
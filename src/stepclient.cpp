@@ -0,0 +1,140 @@
+#include "stepclient.h"
+
+namespace CHIP8
+{
+	#pragma region Chip8StepClient
+
+	Chip8StepClient::Chip8StepClient()
+	{
+
+	}
+
+	bool Chip8StepClient::Open(const char* name)
+	{
+		uint32_t ring;
+
+		if (!segment.Open(name))
+			return false;
+
+		const StepSegmentHeader& header = segment.GetHeader();
+
+		if (header.state.load(std::memory_order_acquire) != STEP_SERVER_RUNNING)
+		{
+			segment.Close();
+			return false;
+		}
+
+		written.assign(header.rings, 0);
+		published.assign(header.rings, 0);
+
+		/* Pick up where a previous client left the rings */
+		for (ring = 0; ring < header.rings; ring++)
+		{
+			written[ring] = segment.GetRing(ring).submitted.load(std::memory_order_relaxed);
+			published[ring] = written[ring];
+		}
+
+		return true;
+	}
+
+	void Chip8StepClient::Close()
+	{
+		segment.Close();
+		written.clear();
+		published.clear();
+	}
+
+	uint32_t Chip8StepClient::GetInstanceCount() const
+	{
+		return segment.IsOpen() ? segment.GetHeader().instances : 0;
+	}
+
+	const StepSegmentHeader& Chip8StepClient::GetHeader() const
+	{
+		return segment.GetHeader();
+	}
+
+	const StepObservation& Chip8StepClient::GetObservation(uint32_t instance) const
+	{
+		return segment.GetObservation(instance);
+	}
+
+	bool Chip8StepClient::Step(uint32_t instance, uint16_t keys, uint32_t frames)
+	{
+		if (frames > StepCommand::MAX_FRAMES)
+			return false;
+
+		return Queue({ instance, STEP_RUN, keys, frames });
+	}
+
+	bool Chip8StepClient::Reset(uint32_t instance)
+	{
+		return Queue({ instance, STEP_RESET, 0, 0 });
+	}
+
+	bool Chip8StepClient::Snapshot(uint32_t instance)
+	{
+		return Queue({ instance, STEP_SNAPSHOT, 0, 0 });
+	}
+
+	bool Chip8StepClient::Queue(const StepCommand& command)
+	{
+		if (command.instance >= GetInstanceCount())
+			return false;
+
+		uint32_t ring = command.instance % segment.GetHeader().rings;
+		StepRing& shared = segment.GetRing(ring);
+
+		/* The slot is free once the server has completed the command SIZE places back */
+		if (written[ring] - shared.completed.load(std::memory_order_acquire) >= StepRing::SIZE && !Wait())
+			return false;
+
+		shared.commands[written[ring] % StepRing::SIZE] = command;
+		written[ring]++;
+
+		return true;
+	}
+
+	void Chip8StepClient::Submit()
+	{
+		uint32_t ring;
+
+		for (ring = 0; ring < written.size(); ring++)
+		{
+			if (written[ring] == published[ring])
+				continue;
+
+			StepRing& shared = segment.GetRing(ring);
+
+			shared.submitted.store(written[ring], std::memory_order_release);
+			StepWake(shared.submitted, shared.server_waiting);
+			published[ring] = written[ring];
+		}
+	}
+
+	bool Chip8StepClient::Wait()
+	{
+		const StepSegmentHeader& header = segment.GetHeader();
+		uint32_t ring;
+
+		Submit();
+
+		for (ring = 0; ring < published.size(); ring++)
+		{
+			StepRing& shared = segment.GetRing(ring);
+			uint32_t completed;
+
+			while ((completed = shared.completed.load(std::memory_order_acquire)) != published[ring])
+			{
+				if (header.state.load(std::memory_order_acquire) != STEP_SERVER_RUNNING)
+					return false;
+
+				StepWait(shared.completed, completed, shared.client_waiting, SERVER_CHECK_MS);
+			}
+		}
+
+		return true;
+	}
+
+	#pragma endregion
+}
@@ -0,0 +1,60 @@
+#ifndef _STEPCLIENT_H_
+#define _STEPCLIENT_H_
+
+#include <cstdint>
+#include <vector>
+#include "stepshm.h"
+
+namespace CHIP8
+{
+	/*
+	 * The agent's side of a Chip8StepServer. Step, Reset and Snapshot only write commands into the shared rings;
+	 * Submit publishes everything queued with one store per ring and at most one wake-up, and Wait blocks until
+	 * the server has run it all. Observations point straight into the segment. Use one client per process, or
+	 * at least one per ring, since every ring has a single producer.
+	 */
+	class Chip8StepClient
+	{
+		private:
+			/* How long Wait sleeps at a time before it checks that the server is still there */
+			static const int SERVER_CHECK_MS = 100;
+
+			Chip8StepSegment segment;
+
+			/* Per ring: commands written, and commands published to the server */
+			std::vector<uint32_t> written;
+			std::vector<uint32_t> published;
+
+			bool Queue(const StepCommand& command);
+
+		public:
+			Chip8StepClient();
+
+			/* Attach to the server's segment. Returns false if it does not exist or the server is not running yet. */
+			bool Open(const char* name);
+			void Close();
+
+			uint32_t GetInstanceCount() const;
+			const StepSegmentHeader& GetHeader() const;
+
+			/* The instance's observation, valid to read once Wait returns and until its next command is submitted */
+			const StepObservation& GetObservation(uint32_t instance) const;
+
+			/*
+			 * Queue a command for an instance. If its ring is full, the queued commands are submitted and waited
+			 * for first. Returns false for an unknown instance, more than StepCommand::MAX_FRAMES frames or a server
+			 * that stopped.
+			 */
+			bool Step(uint32_t instance, uint16_t keys, uint32_t frames);
+			bool Reset(uint32_t instance);
+			bool Snapshot(uint32_t instance);
+
+			/* Hand every queued command to the server */
+			void Submit();
+
+			/* Submit, then wait until the server has run every command. Returns false if the server stopped. */
+			bool Wait();
+	};
+}
+
+#endif
@@ -0,0 +1,255 @@
+#include "stepserver.h"
+#include <cstring>
+#include "rombundle.h"
+#include "scheduler.h"
+
+namespace CHIP8
+{
+	#pragma region Chip8StepServer
+
+	Chip8StepServer::Chip8StepServer()
+		: instructions_per_second(Chip8Scheduler::DEFAULT_INSTRUCTIONS_PER_SECOND), stopping(false), commands(0), frames(0), rejected(0)
+	{
+
+	}
+
+	Chip8StepServer::~Chip8StepServer()
+	{
+		Stop();
+	}
+
+	bool Chip8StepServer::Start(const char* name, ByteSpan rom, uint32_t instances, unsigned int threads,
+		unsigned int instructions_per_second, uint32_t seed, BatchEngine engine)
+	{
+		uint32_t i;
+
+		if (IsRunning() || !instances)
+			return false;
+
+		if (threads == 0)
+			threads = std::thread::hardware_concurrency();
+
+		if (threads == 0)
+			threads = 1;
+
+		if (threads > instances)
+			threads = instances;
+
+		this->instances.clear();
+
+		for (i = 0; i < instances; i++)
+		{
+			std::unique_ptr<Instance> instance(new Instance());
+
+			/* Hosts without a JIT fall back to the interpreter */
+			if (engine == ENGINE_DECODE_CACHE)
+				instance->chip8.SetDecodeCache(true);
+			else if (engine == ENGINE_JIT)
+				instance->chip8.SetJit(true);
+
+			if (!instance->chip8.LoadROM(rom))
+				return false;
+
+			instance->chip8.SetRandomSeed(seed);
+			instance->frame = 0;
+			instance->snapshot.resize(instance->chip8.GetStateSize());
+			instance->chip8.SaveState(instance->snapshot.data(), instance->snapshot.size());
+			instance->snapshot_frame = 0;
+			instance->published_generation = instance->chip8.GetFrameGeneration();
+
+			this->instances.push_back(std::move(instance));
+		}
+
+		if (!segment.Create(name, instances, threads))
+			return false;
+
+		StepSegmentHeader& header = segment.GetHeader();
+
+		header.rom_hash = HashRom(rom.data, rom.size);
+		header.instructions_per_second = instructions_per_second;
+		header.seed = seed;
+
+		for (i = 0; i < instances; i++)
+			Publish(i, true);
+
+		this->instructions_per_second = instructions_per_second;
+		stopping = false;
+		commands = 0;
+		frames = 0;
+		rejected = 0;
+
+		header.state.store(STEP_SERVER_RUNNING, std::memory_order_release);
+
+		for (i = 0; i < threads; i++)
+			workers.emplace_back(&Chip8StepServer::WorkerLoop, this, i);
+
+		return true;
+	}
+
+	void Chip8StepServer::Stop()
+	{
+		uint32_t ring;
+
+		if (!segment.IsOpen())
+			return;
+
+		StepSegmentHeader& header = segment.GetHeader();
+
+		/* Agents waiting for a completion see the state change when their wait times out or is woken */
+		header.state.store(STEP_SERVER_STOPPED, std::memory_order_release);
+		stopping = true;
+
+		for (ring = 0; ring < header.rings; ring++)
+		{
+			StepRing& shared = segment.GetRing(ring);
+
+			StepWake(shared.submitted, shared.server_waiting);
+			StepWake(shared.completed, shared.client_waiting);
+		}
+
+		for (std::thread& worker : workers)
+			worker.join();
+
+		workers.clear();
+		segment.Close();
+	}
+
+	bool Chip8StepServer::IsRunning() const
+	{
+		return segment.IsOpen() && !stopping;
+	}
+
+	StepServerStats Chip8StepServer::GetStats() const
+	{
+		StepServerStats stats;
+
+		stats.commands = commands.load(std::memory_order_relaxed);
+		stats.frames = frames.load(std::memory_order_relaxed);
+		stats.rejected = rejected.load(std::memory_order_relaxed);
+
+		return stats;
+	}
+
+	void Chip8StepServer::WorkerLoop(uint32_t ring)
+	{
+		StepRing& shared = segment.GetRing(ring);
+		uint32_t done = shared.completed.load(std::memory_order_relaxed);
+
+		while (!stopping.load(std::memory_order_relaxed))
+		{
+			uint32_t submitted = shared.submitted.load(std::memory_order_acquire);
+
+			if (submitted == done)
+			{
+				StepWait(shared.submitted, done, shared.server_waiting, IDLE_WAIT_MS);
+				continue;
+			}
+
+			/* Run everything the agent published, then answer once for the whole batch */
+			while (done != submitted)
+			{
+				Execute(ring, shared.commands[done % StepRing::SIZE]);
+				done++;
+			}
+
+			shared.completed.store(done, std::memory_order_release);
+			StepWake(shared.completed, shared.client_waiting);
+		}
+	}
+
+	void Chip8StepServer::Execute(uint32_t ring, const StepCommand& shared_command)
+	{
+		/* The slot lives in memory the agent can scribble on; check and run a private copy, and trust nothing in it */
+		StepCommand command = shared_command;
+		uint32_t rings = segment.GetHeader().rings;
+
+		if (command.instance >= instances.size() || command.instance % rings != ring)
+		{
+			rejected.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		Instance& instance = *instances[command.instance];
+		bool force = false;
+		uint32_t frame;
+
+		switch (command.op)
+		{
+			case STEP_RUN:
+			{
+				if (command.frames > StepCommand::MAX_FRAMES)
+				{
+					rejected.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+
+				instance.chip8.SetKeypadMask(command.keys);
+
+				for (frame = 0; frame < command.frames; frame++)
+				{
+					instance.chip8.RunFrame(Chip8Scheduler::InstructionsForFrame(instructions_per_second, instance.frame));
+					instance.frame++;
+				}
+
+				frames.fetch_add(command.frames, std::memory_order_relaxed);
+			} break;
+
+			case STEP_RESET:
+			{
+				instance.chip8.LoadState(instance.snapshot.data(), instance.snapshot.size());
+				instance.frame = instance.snapshot_frame;
+				force = true;
+			} break;
+
+			case STEP_SNAPSHOT:
+			{
+				instance.snapshot.resize(instance.chip8.GetStateSize());
+				instance.chip8.SaveState(instance.snapshot.data(), instance.snapshot.size());
+				instance.snapshot_frame = instance.frame;
+			} break;
+
+			default:
+			{
+				rejected.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+
+		commands.fetch_add(1, std::memory_order_relaxed);
+		Publish(command.instance, force);
+	}
+
+	void Chip8StepServer::Publish(uint32_t index, bool force)
+	{
+		Instance& instance = *instances[index];
+		StepObservation& observation = segment.GetObservation(index);
+		const Chip8Processor& chip8 = instance.chip8;
+		uint32_t generation = chip8.GetFrameGeneration();
+
+		/* Most steps draw nothing; skip the framebuffer copy for those */
+		if (force || generation != instance.published_generation)
+		{
+			const uint64_t* plane1 = chip8.GetDisplayPlane(1);
+			size_t words = chip8.GetDisplayWidth() / 64 * chip8.GetDisplayHeight();
+
+			memcpy(observation.planes, chip8.GetDisplayState(), words * sizeof(uint64_t));
+
+			if (plane1)
+				memcpy(&observation.planes[Chip8Processor::MAX_DISPLAY_WORDS], plane1, words * sizeof(uint64_t));
+
+			observation.width = (uint16_t)chip8.GetDisplayWidth();
+			observation.height = (uint16_t)chip8.GetDisplayHeight();
+			observation.has_plane1 = plane1 != NULL;
+			instance.published_generation = generation;
+		}
+
+		chip8.GetRegisters(observation.registers);
+		observation.frame = instance.frame;
+		observation.commands++;
+		observation.keypad = chip8.GetKeypadMask();
+		observation.sound_playing = chip8.IsSoundPlaying();
+		observation.waiting_for_input = chip8.IsWaitingForInput();
+	}
+
+	#pragma endregion
+}
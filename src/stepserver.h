@@ -0,0 +1,90 @@
+#ifndef _STEPSERVER_H_
+#define _STEPSERVER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "batch.h"
+#include "chip8.h"
+#include "stepshm.h"
+
+namespace CHIP8
+{
+	struct StepServerStats
+	{
+		uint64_t commands;
+		uint64_t frames;
+
+		/* Commands naming an instance that does not exist or is served by another ring */
+		uint64_t rejected;
+	};
+
+	/*
+	 * Serves many Chip8Processor instances to agents in other processes through a Chip8StepSegment. Each worker
+	 * thread owns one command ring and the instances assigned to it, so instances never move between threads and
+	 * a ring has exactly one consumer. Every command leaves the instance's framebuffer, registers and keypad in
+	 * its StepObservation, where agents read them without a copy on their side. The framebuffer is only copied
+	 * when the frame generation says it changed.
+	 *
+	 * Frames run the same instruction counts as the interactive scheduler at the same rate, so an episode played
+	 * through the server can be reproduced with chip8-replay.
+	 */
+	class Chip8StepServer
+	{
+		private:
+			struct Instance
+			{
+				Chip8Processor chip8;
+				uint64_t frame;
+
+				/* What STEP_RESET restores */
+				std::vector<uint8_t> snapshot;
+				uint64_t snapshot_frame;
+
+				/* Frame generation last copied to the observation */
+				uint32_t published_generation;
+			};
+
+			/* How long a worker sleeps on its ring before it checks whether to stop */
+			static const int IDLE_WAIT_MS = 100;
+
+			Chip8StepSegment segment;
+			std::vector<std::unique_ptr<Instance>> instances;
+			std::vector<std::thread> workers;
+			unsigned int instructions_per_second;
+			std::atomic<bool> stopping;
+
+			std::atomic<uint64_t> commands;
+			std::atomic<uint64_t> frames;
+			std::atomic<uint64_t> rejected;
+
+			void WorkerLoop(uint32_t ring);
+			void Execute(uint32_t ring, const StepCommand& shared_command);
+
+			/* Copy the instance's state into its observation */
+			void Publish(uint32_t index, bool force);
+
+		public:
+			Chip8StepServer();
+			~Chip8StepServer();
+
+			/*
+			 * Create the segment called name with instances machines booted from rom and start threads workers, or
+			 * one per hardware thread for zero. Every machine starts from the same seed and that state becomes its
+			 * first snapshot.
+			 */
+			bool Start(const char* name, ByteSpan rom, uint32_t instances, unsigned int threads,
+				unsigned int instructions_per_second, uint32_t seed, BatchEngine engine);
+
+			/* Mark the segment stopped, wake any agent waiting on it, join the workers and remove the segment */
+			void Stop();
+
+			bool IsRunning() const;
+
+			StepServerStats GetStats() const;
+	};
+}
+
+#endif
@@ -0,0 +1,118 @@
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "batch.h"
+#include "rombundle.h"
+#include "scheduler.h"
+#include "stepserver.h"
+
+/*
+ * Step server for agents in other processes. Boots N copies of a ROM and serves them through the POSIX
+ * shared-memory segment NAME until interrupted. Agents attach with Chip8StepClient, queue "set keys and run
+ * frames", "reset to snapshot" and "snapshot" commands, and read each instance's framebuffer, registers and
+ * keypad in place.
+ *
+ * Usage: chip8-step-server [--name NAME] [--instances N] [--threads N] [--ips N] [--seed N] [--engine table|cached|jit] ROM
+ */
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void OnSignal(int)
+{
+	interrupted = 1;
+}
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: chip8-step-server [--name NAME] [--instances N] [--threads N] [--ips N] [--seed N] [--engine table|cached|jit] ROM" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	const char* name = "/chip8-step";
+	uint32_t instances = 1;
+	unsigned int threads = 0;
+	unsigned int instructions_per_second = CHIP8::Chip8Scheduler::DEFAULT_INSTRUCTIONS_PER_SECOND;
+	uint32_t seed = CHIP8::Chip8Processor::DEFAULT_RANDOM_SEED;
+	CHIP8::BatchEngine engine = CHIP8::ENGINE_TABLE;
+	const char* romFile = NULL;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		bool has_value = i + 1 < argc;
+
+		if (!strcmp(argv[i], "--name") && has_value)
+			name = argv[++i];
+		else if (!strcmp(argv[i], "--instances") && has_value)
+			instances = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--threads") && has_value)
+			threads = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--ips") && has_value)
+			instructions_per_second = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--seed") && has_value)
+			seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--engine") && has_value)
+		{
+			const char* engineName = argv[++i];
+
+			if (!strcmp(engineName, "table"))
+				engine = CHIP8::ENGINE_TABLE;
+			else if (!strcmp(engineName, "cached"))
+				engine = CHIP8::ENGINE_DECODE_CACHE;
+			else if (!strcmp(engineName, "jit"))
+				engine = CHIP8::ENGINE_JIT;
+			else
+			{
+				PrintUsage();
+				return EXIT_FAILURE;
+			}
+		}
+		else if (argv[i][0] == '-' || romFile)
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+		else
+			romFile = argv[i];
+	}
+
+	if (!romFile || instances == 0 || instructions_per_second == 0)
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	std::vector<uint8_t> rom;
+	CHIP8::Chip8StepServer server;
+
+	if (!CHIP8::ReadRomFile(romFile, rom))
+		return EXIT_FAILURE;
+
+	if (!server.Start(name, { rom.data(), rom.size() }, instances, threads, instructions_per_second, seed, engine))
+	{
+		std::cerr << "Error: Unable to start the step server on " << name << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::signal(SIGINT, OnSignal);
+	std::signal(SIGTERM, OnSignal);
+
+	std::cerr << "Serving " << instances << " instances of " << romFile << " on " << name << std::endl;
+
+	while (!interrupted)
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	server.Stop();
+
+	CHIP8::StepServerStats stats = server.GetStats();
+
+	std::cerr << "Step server: " << stats.commands << " commands, " << stats.frames << " frames, "
+		<< stats.rejected << " rejected" << std::endl;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,235 @@
+#include "stepshm.h"
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CHIP8_STEP_PAUSE() _mm_pause()
+#else
+#define CHIP8_STEP_PAUSE() ((void)0)
+#endif
+
+namespace CHIP8
+{
+	/* Polls of the word before StepWait goes to sleep, some tens of microseconds */
+	static const unsigned int SPIN_COUNT = 1024;
+
+	static size_t RoundUp(size_t size, size_t alignment)
+	{
+		return (size + alignment - 1) / alignment * alignment;
+	}
+
+	#pragma region Chip8StepSegment
+
+	Chip8StepSegment::Chip8StepSegment() : mapping(NULL), mapping_size(0), owner(false)
+	{
+
+	}
+
+	Chip8StepSegment::~Chip8StepSegment()
+	{
+		Close();
+	}
+
+	size_t Chip8StepSegment::GetSize(uint32_t instances, uint32_t rings)
+	{
+		return RoundUp(sizeof(StepSegmentHeader), 64) + rings * sizeof(StepRing) + instances * sizeof(StepObservation);
+	}
+
+	bool Chip8StepSegment::Create(const char* name, uint32_t instances, uint32_t rings)
+	{
+		Close();
+
+#if defined(_WIN32)
+		return false;
+#else
+		/* shm_open names start with a slash and contain no other */
+		this->name = name[0] == '/' ? name : std::string("/") + name;
+		mapping_size = GetSize(instances, rings);
+
+		/* A segment left behind by a server that crashed is replaced */
+		shm_unlink(this->name.c_str());
+
+		int fd = shm_open(this->name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+		if (fd < 0)
+			return false;
+
+		owner = true;
+
+		void* view = ftruncate(fd, (off_t)mapping_size) == 0 ? mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+		close(fd);
+
+		if (view == MAP_FAILED)
+		{
+			Close();
+			return false;
+		}
+
+		mapping = (uint8_t*)view;
+
+		/* The new segment is zero filled; construct the shared structures in place */
+		StepSegmentHeader* header = new (mapping) StepSegmentHeader();
+		uint32_t ring;
+
+		memcpy(header->magic, "C8SS", 4);
+		header->version = VERSION;
+		header->instances = instances;
+		header->rings = rings;
+		header->state.store(STEP_SERVER_STARTING, std::memory_order_relaxed);
+
+		for (ring = 0; ring < rings; ring++)
+			new (&GetRing(ring)) StepRing();
+
+		return true;
+#endif
+	}
+
+	bool Chip8StepSegment::Open(const char* name)
+	{
+		Close();
+
+#if defined(_WIN32)
+		return false;
+#else
+		struct stat info;
+
+		this->name = name[0] == '/' ? name : std::string("/") + name;
+
+		int fd = shm_open(this->name.c_str(), O_RDWR, 0);
+
+		if (fd < 0)
+			return false;
+
+		if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(StepSegmentHeader))
+		{
+			close(fd);
+			return false;
+		}
+
+		mapping_size = (size_t)info.st_size;
+
+		void* view = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (view == MAP_FAILED)
+			return false;
+
+		mapping = (uint8_t*)view;
+
+		const StepSegmentHeader& header = GetHeader();
+
+		if (memcmp(header.magic, "C8SS", 4) || header.version != VERSION || !header.rings
+			|| mapping_size < GetSize(header.instances, header.rings))
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+#endif
+	}
+
+	void Chip8StepSegment::Close()
+	{
+#if !defined(_WIN32)
+		if (mapping)
+			munmap(mapping, mapping_size);
+
+		if (owner)
+			shm_unlink(name.c_str());
+#endif
+
+		mapping = NULL;
+		mapping_size = 0;
+		owner = false;
+	}
+
+	bool Chip8StepSegment::IsOpen() const
+	{
+		return mapping != NULL;
+	}
+
+	StepSegmentHeader& Chip8StepSegment::GetHeader() const
+	{
+		return *(StepSegmentHeader*)mapping;
+	}
+
+	StepRing& Chip8StepSegment::GetRing(uint32_t ring) const
+	{
+		return ((StepRing*)(mapping + RoundUp(sizeof(StepSegmentHeader), 64)))[ring];
+	}
+
+	StepObservation& Chip8StepSegment::GetObservation(uint32_t instance) const
+	{
+		uint8_t* observations = mapping + RoundUp(sizeof(StepSegmentHeader), 64) + GetHeader().rings * sizeof(StepRing);
+
+		return ((StepObservation*)observations)[instance];
+	}
+
+	#pragma endregion
+
+	#pragma region Wake-ups
+
+	void StepWait(std::atomic<uint32_t>& word, uint32_t value, std::atomic<uint32_t>& waiting, int timeout_ms)
+	{
+		/* On a single core the other side cannot answer while this one spins */
+		static const unsigned int spins = std::thread::hardware_concurrency() > 1 ? SPIN_COUNT : 0;
+		unsigned int spin;
+
+		for (spin = 0; spin < spins; spin++)
+		{
+			if (word.load(std::memory_order_acquire) != value)
+				return;
+
+			CHIP8_STEP_PAUSE();
+		}
+
+		/* Raised before the last check, so a StepWake that stores after it sees a waiter and makes the call */
+		waiting.fetch_add(1, std::memory_order_seq_cst);
+
+		if (word.load(std::memory_order_seq_cst) == value)
+		{
+#if defined(__linux__)
+			struct timespec timeout = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L };
+
+			/* Not FUTEX_PRIVATE: the word is shared with another process */
+			syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAIT, value, &timeout, NULL, 0);
+#else
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+#endif
+		}
+
+		waiting.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void StepWake(std::atomic<uint32_t>& word, std::atomic<uint32_t>& waiting)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (!waiting.load(std::memory_order_relaxed))
+			return;
+
+#if defined(__linux__)
+		syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+	}
+
+	#pragma endregion
+}
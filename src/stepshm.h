@@ -0,0 +1,156 @@
+#ifndef _STEPSHM_H_
+#define _STEPSHM_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "chip8.h"
+
+namespace CHIP8
+{
+	enum StepOp : uint16_t
+	{
+		/* Set the keypad to keys and run the given number of 60 Hz frames */
+		STEP_RUN,
+
+		/* Restore the instance's snapshot, initially the freshly booted ROM */
+		STEP_RESET,
+
+		/* Make the current state the one STEP_RESET returns to */
+		STEP_SNAPSHOT
+	};
+
+	struct StepCommand
+	{
+		/* Longest STEP_RUN the server accepts, one minute of frames, so one command cannot hold a worker for long */
+		static const uint32_t MAX_FRAMES = 3600;
+
+		uint32_t instance;
+		uint16_t op;
+
+		/* STEP_RUN only: keypad mask, key 0 in the least significant bit, and the number of frames */
+		uint16_t keys;
+		uint32_t frames;
+	};
+
+	/*
+	 * What an agent sees of one instance, read in place from the segment. The server writes it only while it runs
+	 * a command for that instance, so it is stable from the moment the command completes until the next command
+	 * for the instance is submitted.
+	 */
+	struct alignas(64) StepObservation
+	{
+		/* Plane p at planes[p * MAX_DISPLAY_WORDS], laid out like Chip8Processor::GetDisplayPlane */
+		uint64_t planes[Chip8Processor::DISPLAY_PLANES * Chip8Processor::MAX_DISPLAY_WORDS];
+		Chip8Registers registers;
+
+		/* Frames run since the ROM booted; a reset goes back to the snapshot's count */
+		uint64_t frame;
+
+		/* Commands run on this instance, so an agent can tell a fresh observation from a stale one */
+		uint32_t commands;
+
+		uint16_t width;
+		uint16_t height;
+		uint16_t keypad;
+		uint8_t has_plane1;
+		uint8_t sound_playing;
+		uint8_t waiting_for_input;
+	};
+
+	/*
+	 * Single-producer, single-consumer command ring between the agent and one server thread. The agent writes
+	 * commands and then publishes them all with one store to submitted; the server runs them in order and
+	 * publishes its progress in completed. Each side sleeps on the other's counter with a futex once a short spin
+	 * finds nothing new, and the *_waiting counts tell the other side whether a wake-up system call is needed.
+	 */
+	struct alignas(64) StepRing
+	{
+		static const uint32_t SIZE = 1024;
+
+		/* Written by the agent */
+		std::atomic<uint32_t> submitted;
+		std::atomic<uint32_t> client_waiting;
+
+		/* Written by the server */
+		alignas(64) std::atomic<uint32_t> completed;
+		std::atomic<uint32_t> server_waiting;
+
+		alignas(64) StepCommand commands[SIZE];
+	};
+
+	enum StepServerState : uint32_t
+	{
+		STEP_SERVER_STARTING,
+		STEP_SERVER_RUNNING,
+		STEP_SERVER_STOPPED
+	};
+
+	struct alignas(64) StepSegmentHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t instances;
+
+		/* Instance i is served through ring i % rings, one ring per server thread */
+		uint32_t rings;
+
+		/* What every instance runs, so an agent can check it is talking to the right server */
+		uint64_t rom_hash;
+		uint32_t instructions_per_second;
+		uint32_t seed;
+
+		std::atomic<uint32_t> state;
+	};
+
+	/*
+	 * A POSIX shared-memory segment holding a step server's header, one StepRing per server thread and one
+	 * StepObservation per instance, in that order. The server creates it and the agents' processes map it.
+	 */
+	class Chip8StepSegment
+	{
+		public:
+			static const uint32_t VERSION = 1;
+
+		private:
+			uint8_t* mapping;
+			size_t mapping_size;
+			std::string name;
+			bool owner;
+
+		public:
+			Chip8StepSegment();
+			~Chip8StepSegment();
+
+			Chip8StepSegment(const Chip8StepSegment&) = delete;
+			Chip8StepSegment& operator=(const Chip8StepSegment&) = delete;
+
+			static size_t GetSize(uint32_t instances, uint32_t rings);
+
+			/* Create the segment called name, replacing a stale one, with the header filled in and state STARTING */
+			bool Create(const char* name, uint32_t instances, uint32_t rings);
+
+			/* Map an existing segment. Returns false if there is none or it is from another version. */
+			bool Open(const char* name);
+
+			/* Unmap, and remove the name if this side created it */
+			void Close();
+			bool IsOpen() const;
+
+			StepSegmentHeader& GetHeader() const;
+			StepRing& GetRing(uint32_t ring) const;
+			StepObservation& GetObservation(uint32_t instance) const;
+	};
+
+	/*
+	 * Wait until word no longer holds value or timeout_ms passes. Spins briefly first, since an answer usually
+	 * comes within microseconds, then sleeps on a futex with waiting raised so the other side knows to wake it.
+	 */
+	void StepWait(std::atomic<uint32_t>& word, uint32_t value, std::atomic<uint32_t>& waiting, int timeout_ms);
+
+	/* Wake anyone sleeping in StepWait on word. Store to word first. Free when nobody sleeps. */
+	void StepWake(std::atomic<uint32_t>& word, std::atomic<uint32_t>& waiting);
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include "triplebuffer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace CHIP8
+{
+	#pragma region Chip8TripleBuffer
+
+	Chip8TripleBuffer::Chip8TripleBuffer()
+		: frames(), middle(1), back(0), carry(false), carry_first(0), carry_last(0), front(2)
+	{
+
+	}
+
+	void Chip8TripleBuffer::Publish(const Chip8Processor& chip8, unsigned int first_row, unsigned int last_row, uint16_t input_serial)
+	{
+		Chip8Frame& frame = frames[back];
+		const uint64_t* plane1 = chip8.GetDisplayPlane(1);
+		size_t words = chip8.GetDisplayWidth() / 64 * chip8.GetDisplayHeight();
+		unsigned int previous;
+
+		/* The slot is two frames old, so copy the whole framebuffer rather than just the changed rows */
+		memcpy(frame.planes, chip8.GetDisplayPlane(0), words * sizeof(uint64_t));
+
+		if (plane1)
+			memcpy(&frame.planes[Chip8Processor::MAX_DISPLAY_WORDS], plane1, words * sizeof(uint64_t));
+
+		frame.has_plane1 = plane1 != NULL;
+		frame.width = chip8.GetDisplayWidth();
+		frame.height = chip8.GetDisplayHeight();
+		frame.first_row = carry ? std::min(first_row, carry_first) : first_row;
+		frame.last_row = carry ? std::max(last_row, carry_last) : last_row;
+		frame.input_serial = input_serial;
+
+		/* Release the filled slot and take back whichever one was shared */
+		previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+		back = previous & ~FRESH;
+
+		/* A frame the consumer never took still owes it its changed rows */
+		carry = (previous & FRESH) != 0;
+		carry_first = frames[back].first_row;
+		carry_last = frames[back].last_row;
+	}
+
+	const Chip8Frame* Chip8TripleBuffer::Acquire()
+	{
+		if (!(middle.load(std::memory_order_acquire) & FRESH))
+			return NULL;
+
+		front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+
+		return &frames[front];
+	}
+
+	#pragma endregion
+}
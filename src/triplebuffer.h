@@ -0,0 +1,67 @@
+#ifndef _TRIPLEBUFFER_H_
+#define _TRIPLEBUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+#include "chip8.h"
+
+namespace CHIP8
+{
+	/* A copy of the framebuffer as it stood at the end of an emulated frame */
+	struct Chip8Frame
+	{
+		/* Plane p at planes[p * MAX_DISPLAY_WORDS], laid out like Chip8Processor::GetDisplayPlane */
+		uint64_t planes[Chip8Processor::DISPLAY_PLANES * Chip8Processor::MAX_DISPLAY_WORDS];
+		bool has_plane1;
+		unsigned int width;
+		unsigned int height;
+
+		/* Rows changed since the previous frame the consumer took, including frames it never saw */
+		unsigned int first_row;
+		unsigned int last_row;
+
+		/* Serial of the keypad change in effect when the frame was emulated, for input latency */
+		uint16_t input_serial;
+	};
+
+	/*
+	 * Hands finished frames from the emulation thread to the render thread without locks. Of the three slots the
+	 * producer owns one, the consumer owns one and the third is swapped between them with a single atomic
+	 * exchange. Publish never waits for the consumer and Acquire never waits for the producer: a slow present just
+	 * means frames are skipped, and the consumer always gets the newest one.
+	 */
+	class Chip8TripleBuffer
+	{
+		private:
+			/* Set in the shared slot index while it holds a frame the consumer has not taken */
+			static const unsigned int FRESH = 4;
+
+			Chip8Frame frames[3];
+
+			/* The shared slot, plus FRESH */
+			alignas(64) std::atomic<unsigned int> middle;
+
+			/* Producer side: the slot being filled, and the rows of frames the consumer skipped */
+			alignas(64) unsigned int back;
+			bool carry;
+			unsigned int carry_first;
+			unsigned int carry_last;
+
+			/* Consumer side: the slot last returned by Acquire */
+			alignas(64) unsigned int front;
+
+		public:
+			Chip8TripleBuffer();
+
+			/*
+			 * Producer: copy chip8's framebuffer, which changed in rows first_row to last_row while running with keypad
+			 * change input_serial, and make it the newest frame
+			 */
+			void Publish(const Chip8Processor& chip8, unsigned int first_row, unsigned int last_row, uint16_t input_serial);
+
+			/* Consumer: the newest frame if one was published since the last call, or NULL. Valid until the next call. */
+			const Chip8Frame* Acquire();
+	};
+}
+
+#endif
@@ -0,0 +1,651 @@
+#include "video.h"
+#include <algorithm>
+#include <cstring>
+
+namespace CHIP8
+{
+	/* Background, plane 0, plane 1 and both, as on screen */
+	static const uint8_t PALETTE_RGB[4][3] = { { 0x00, 0x00, 0x00 }, { 0xFF, 0xFF, 0xFF }, { 0xFF, 0x66, 0x00 }, { 0x66, 0x22, 0x00 } };
+
+	/* Largest code the GIF LZW dictionary may hold */
+	static const unsigned int LZW_MAX_CODES = 4096;
+
+	static void PutLE16(std::vector<uint8_t>& out, unsigned int value)
+	{
+		out.push_back((uint8_t)value);
+		out.push_back((uint8_t)(value >> 8));
+	}
+
+	static void PutBE32(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back((uint8_t)(value >> 24));
+		out.push_back((uint8_t)(value >> 16));
+		out.push_back((uint8_t)(value >> 8));
+		out.push_back((uint8_t)value);
+	}
+
+	static uint32_t Crc32(const uint8_t* data, size_t size)
+	{
+		static uint32_t table[256];
+		static bool ready = false;
+		uint32_t crc = 0xFFFFFFFFU;
+		size_t i;
+
+		/* Only the writer thread gets here */
+		if (!ready)
+		{
+			for (i = 0; i < 256; i++)
+			{
+				uint32_t value = (uint32_t)i;
+				unsigned int bit;
+
+				for (bit = 0; bit < 8; bit++)
+					value = value & 1 ? 0xEDB88320U ^ (value >> 1) : value >> 1;
+
+				table[i] = value;
+			}
+
+			ready = true;
+		}
+
+		for (i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+		return crc ^ 0xFFFFFFFFU;
+	}
+
+	/* Append a PNG chunk: length, type, data and the CRC of type and data */
+	static void PutChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+	{
+		size_t start;
+
+		PutBE32(out, (uint32_t)data.size());
+		start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data.begin(), data.end());
+		PutBE32(out, Crc32(&out[start], out.size() - start));
+	}
+
+	/* Packs variable-width codes least significant bit first, as GIF LZW wants */
+	struct CodeWriter
+	{
+		std::vector<uint8_t>& out;
+		uint32_t bits;
+		unsigned int count;
+
+		explicit CodeWriter(std::vector<uint8_t>& out) : out(out), bits(0), count(0) { }
+
+		void Put(unsigned int code, unsigned int width)
+		{
+			bits |= (uint32_t)code << count;
+			count += width;
+
+			while (count >= 8)
+			{
+				out.push_back((uint8_t)bits);
+				bits >>= 8;
+				count -= 8;
+			}
+		}
+
+		void Flush()
+		{
+			if (count)
+				out.push_back((uint8_t)bits);
+
+			bits = 0;
+			count = 0;
+		}
+	};
+
+	/* LZW code the palette indices (each below 1 << minimum_size) into out */
+	static void EncodeLZW(const std::vector<uint8_t>& indices, unsigned int minimum_size, std::vector<uint8_t>& out)
+	{
+		const unsigned int clear = 1U << minimum_size;
+		const unsigned int end = clear + 1;
+		const unsigned int alphabet = 1U << minimum_size;
+
+		/* Dictionary as a trie: child[code * alphabet + index] is the code for code's string plus index, or 0 */
+		std::vector<uint16_t> child(LZW_MAX_CODES * alphabet, 0);
+		unsigned int next = end + 1;
+		unsigned int width = minimum_size + 1;
+		unsigned int prefix;
+		size_t i;
+		CodeWriter writer(out);
+
+		writer.Put(clear, width);
+
+		if (indices.empty())
+		{
+			writer.Put(end, width);
+			writer.Flush();
+			return;
+		}
+
+		prefix = indices[0];
+
+		for (i = 1; i < indices.size(); i++)
+		{
+			unsigned int index = indices[i];
+			unsigned int code = child[prefix * alphabet + index];
+
+			if (code)
+			{
+				prefix = code;
+				continue;
+			}
+
+			writer.Put(prefix, width);
+
+			if (next < LZW_MAX_CODES)
+			{
+				child[prefix * alphabet + index] = (uint16_t)next++;
+
+				/* The decoder adds each entry one code later, so widen once it has room for the next */
+				if (next > (1U << width) && width < 12)
+					width++;
+			}
+			else
+			{
+				writer.Put(clear, width);
+				std::fill(child.begin(), child.end(), 0);
+				next = end + 1;
+				width = minimum_size + 1;
+			}
+
+			prefix = index;
+		}
+
+		writer.Put(prefix, width);
+
+		/* The decoder adds one last entry on reading the final prefix and may widen before the end code */
+		if (next < LZW_MAX_CODES && next + 1 > (1U << width) && width < 12)
+			width++;
+
+		writer.Put(end, width);
+		writer.Flush();
+	}
+
+	#pragma region Chip8VideoSink
+
+	Chip8VideoSink::Chip8VideoSink()
+		: format(VIDEO_Y4M), scale(1), file(NULL), frames(0), duplicates(0), stalls(0), last(), have_last(false), queue_head(0),
+		queue_count(0), closing(false), video_width(0), video_height(0), header_written(false), pending(), have_pending(false), bytes_written(0), failed(false)
+	{
+
+	}
+
+	Chip8VideoSink::~Chip8VideoSink()
+	{
+		Close();
+	}
+
+	bool Chip8VideoSink::FormatFromPath(const char* path, VideoFormat& format)
+	{
+		const char* extension = strrchr(path, '.');
+
+		if (!extension)
+			return false;
+
+		if (!strcmp(extension, ".y4m"))
+			format = VIDEO_Y4M;
+		else if (!strcmp(extension, ".png"))
+			format = VIDEO_PNG;
+		else if (!strcmp(extension, ".gif"))
+			format = VIDEO_GIF;
+		else
+			return false;
+
+		return true;
+	}
+
+	bool Chip8VideoSink::Open(const char* path, VideoFormat format, unsigned int scale)
+	{
+		if (writer.joinable() || !scale)
+			return false;
+
+		this->format = format;
+		this->path = path;
+		this->scale = scale;
+
+		/* PNG frames each get their own file */
+		if (format != VIDEO_PNG && (file = fopen(path, "wb")) == NULL)
+			return false;
+
+		frames = 0;
+		duplicates = 0;
+		stalls = 0;
+		have_last = false;
+		queue.assign(QUEUE_FRAMES, Frame());
+		queue_head = 0;
+		queue_count = 0;
+		closing = false;
+		video_width = Chip8Processor::HIRES_WIDTH * scale;
+		video_height = Chip8Processor::HIRES_HEIGHT * scale;
+		header_written = false;
+		have_pending = false;
+		bytes_written = 0;
+		failed = false;
+
+		writer = std::thread(&Chip8VideoSink::WriterLoop, this);
+
+		return true;
+	}
+
+	void Chip8VideoSink::AddFrame(const Chip8Processor& chip8)
+	{
+		const uint64_t* plane1 = chip8.GetDisplayPlane(1);
+		unsigned int width = chip8.GetDisplayWidth();
+		unsigned int height = chip8.GetDisplayHeight();
+		size_t words = width / 64 * height;
+		uint64_t index;
+
+		if (!writer.joinable())
+			return;
+
+		index = frames++;
+
+		/* Most frames of most games change nothing; those cost one compare of at most 2 KB */
+		if (have_last && last.width == width && last.height == height && last.has_plane1 == (plane1 != NULL)
+			&& !memcmp(last.planes, chip8.GetDisplayState(), words * sizeof(uint64_t))
+			&& (!plane1 || !memcmp(&last.planes[Chip8Processor::MAX_DISPLAY_WORDS], plane1, words * sizeof(uint64_t))))
+		{
+			duplicates++;
+			return;
+		}
+
+		memcpy(last.planes, chip8.GetDisplayState(), words * sizeof(uint64_t));
+
+		if (plane1)
+			memcpy(&last.planes[Chip8Processor::MAX_DISPLAY_WORDS], plane1, words * sizeof(uint64_t));
+
+		last.width = width;
+		last.height = height;
+		last.has_plane1 = plane1 != NULL;
+		last.index = index;
+		have_last = true;
+
+		{
+			std::unique_lock<std::mutex> guard(lock);
+
+			if (queue_count == QUEUE_FRAMES)
+			{
+				stalls++;
+				frame_taken.wait(guard, [this]() { return queue_count < QUEUE_FRAMES; });
+			}
+
+			queue[(queue_head + queue_count) % QUEUE_FRAMES] = last;
+			queue_count++;
+		}
+
+		frame_added.notify_one();
+	}
+
+	bool Chip8VideoSink::Close()
+	{
+		if (!writer.joinable())
+			return !failed;
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			closing = true;
+		}
+
+		frame_added.notify_one();
+		writer.join();
+
+		if (format == VIDEO_GIF && file && header_written)
+		{
+			const uint8_t trailer = 0x3B;
+
+			Write(&trailer, 1);
+		}
+
+		if (file && fclose(file) != 0)
+			failed = true;
+
+		file = NULL;
+
+		return !failed;
+	}
+
+	VideoStats Chip8VideoSink::GetStats() const
+	{
+		VideoStats stats;
+
+		stats.frames = frames;
+		stats.duplicates = duplicates;
+		stats.stalls = stalls;
+		stats.bytes_written = bytes_written.load(std::memory_order_relaxed);
+
+		return stats;
+	}
+
+	#pragma endregion
+
+	#pragma region Writer
+
+	void Chip8VideoSink::WriterLoop()
+	{
+		std::unique_lock<std::mutex> guard(lock);
+
+		for (;;)
+		{
+			frame_added.wait(guard, [this]() { return queue_count || closing; });
+
+			if (!queue_count)
+				break;
+
+			/* The producer never touches a queued slot, so it can be encoded without the lock */
+			const Frame& frame = queue[queue_head];
+
+			guard.unlock();
+
+			/* A frame's length is only known once the next one arrives */
+			if (have_pending)
+				WriteFrame(pending, frame.index - pending.index);
+
+			pending = frame;
+			have_pending = true;
+
+			guard.lock();
+			queue_head = (queue_head + 1) % QUEUE_FRAMES;
+			queue_count--;
+			frame_taken.notify_one();
+		}
+
+		/* Close set closing after the last AddFrame, so frames is final here */
+		if (have_pending)
+			WriteFrame(pending, frames - pending.index);
+
+		have_pending = false;
+	}
+
+	bool Chip8VideoSink::Write(const void* data, size_t size)
+	{
+		if (failed)
+			return false;
+
+		if (fwrite(data, 1, size, file) != size)
+		{
+			failed = true;
+			return false;
+		}
+
+		bytes_written += size;
+		return true;
+	}
+
+	void Chip8VideoSink::Rasterize(const Frame& frame, unsigned int width, unsigned int height)
+	{
+		const unsigned int words = frame.width / 64;
+		unsigned int x, y;
+
+		indices.resize((size_t)width * height);
+
+		for (y = 0; y < height; y++)
+		{
+			unsigned int row = y * frame.height / height;
+
+			/* Scaled rows repeat the one above */
+			if (y && row == (y - 1) * frame.height / height)
+			{
+				memcpy(&indices[(size_t)y * width], &indices[(size_t)(y - 1) * width], width);
+				continue;
+			}
+
+			const uint64_t* bits0 = frame.planes + row * words;
+			const uint64_t* bits1 = frame.planes + Chip8Processor::MAX_DISPLAY_WORDS + row * words;
+			uint8_t* out = &indices[(size_t)y * width];
+
+			for (x = 0; x < width; x++)
+			{
+				unsigned int column = x * frame.width / width;
+				unsigned int shift = 63 - column % 64;
+				unsigned int index = (bits0[column / 64] >> shift) & 1U;
+
+				if (frame.has_plane1)
+					index |= ((bits1[column / 64] >> shift) & 1U) << 1;
+
+				out[x] = (uint8_t)index;
+			}
+		}
+	}
+
+	void Chip8VideoSink::WriteFrame(const Frame& frame, uint64_t count)
+	{
+		if (failed)
+			return;
+
+		switch (format)
+		{
+			case VIDEO_Y4M:
+			{
+				WriteY4M(frame, count);
+			} break;
+
+			case VIDEO_PNG:
+			{
+				WritePNG(frame);
+			} break;
+
+			case VIDEO_GIF:
+			{
+				WriteGIF(frame, count);
+			} break;
+		}
+	}
+
+	void Chip8VideoSink::WriteY4M(const Frame& frame, uint64_t count)
+	{
+		static const char FRAME_HEADER[] = "FRAME\n";
+		uint8_t yuv[4][3];
+		size_t pixels, i;
+		unsigned int colour;
+		uint64_t repeat;
+
+		if (!header_written)
+		{
+			char header[128];
+
+			header_written = true;
+			snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F60:1 Ip A1:1 C444 XCOLORRANGE=FULL\n", video_width, video_height);
+
+			if (!Write(header, strlen(header)))
+				return;
+		}
+
+		/* Full-range BT.601; the four colours land on distinct triples, so the palette index survives */
+		for (colour = 0; colour < 4; colour++)
+		{
+			double r = PALETTE_RGB[colour][0], g = PALETTE_RGB[colour][1], b = PALETTE_RGB[colour][2];
+
+			yuv[colour][0] = (uint8_t)(0.299 * r + 0.587 * g + 0.114 * b + 0.5);
+			yuv[colour][1] = (uint8_t)(128.0 - 0.168736 * r - 0.331264 * g + 0.5 * b + 0.5);
+			yuv[colour][2] = (uint8_t)(128.0 + 0.5 * r - 0.418688 * g - 0.081312 * b + 0.5);
+		}
+
+		Rasterize(frame, video_width, video_height);
+		pixels = indices.size();
+		encoded.resize(3 * pixels);
+
+		for (i = 0; i < pixels; i++)
+		{
+			encoded[i] = yuv[indices[i]][0];
+			encoded[pixels + i] = yuv[indices[i]][1];
+			encoded[2 * pixels + i] = yuv[indices[i]][2];
+		}
+
+		/* Y4M has a fixed frame rate, so a frame that lasted several is written that many times */
+		for (repeat = 0; repeat < count; repeat++)
+		{
+			if (!Write(FRAME_HEADER, sizeof(FRAME_HEADER) - 1) || !Write(encoded.data(), encoded.size()))
+				return;
+		}
+	}
+
+	void Chip8VideoSink::WritePNG(const Frame& frame)
+	{
+		static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		unsigned int width = frame.width * scale;
+		unsigned int height = frame.height * scale;
+		unsigned int depth = frame.has_plane1 ? 2 : 1;
+		size_t stride = ((size_t)width * depth + 7) / 8;
+		std::vector<uint8_t> chunk;
+		std::vector<uint8_t> raw;
+		unsigned int x, y, colour;
+		size_t offset;
+
+		Rasterize(frame, width, height);
+
+		/* Each row: filter type 0, then the indices packed most significant bit first */
+		raw.assign((stride + 1) * height, 0);
+
+		for (y = 0; y < height; y++)
+		{
+			uint8_t* row = &raw[y * (stride + 1) + 1];
+
+			for (x = 0; x < width; x++)
+				row[x * depth / 8] |= (uint8_t)(indices[(size_t)y * width + x] << (8 - depth - x * depth % 8));
+		}
+
+		encoded.assign(SIGNATURE, SIGNATURE + sizeof(SIGNATURE));
+
+		PutBE32(chunk, width);
+		PutBE32(chunk, height);
+		chunk.push_back((uint8_t)depth);
+		chunk.push_back(3);
+		chunk.push_back(0);
+		chunk.push_back(0);
+		chunk.push_back(0);
+		PutChunk(encoded, "IHDR", chunk);
+
+		chunk.clear();
+
+		for (colour = 0; colour < (1U << depth); colour++)
+			chunk.insert(chunk.end(), PALETTE_RGB[colour], PALETTE_RGB[colour] + 3);
+
+		PutChunk(encoded, "PLTE", chunk);
+
+		/* zlib stream of stored deflate blocks: no compression library needed, and 1-bit rows are small anyway */
+		uint32_t a = 1, b = 0;
+
+		chunk.assign({ 0x78, 0x01 });
+
+		for (offset = 0; offset < raw.size() || offset == 0; )
+		{
+			size_t size = std::min(raw.size() - offset, (size_t)65535);
+
+			chunk.push_back(offset + size == raw.size() ? 1 : 0);
+			PutLE16(chunk, (unsigned int)size);
+			PutLE16(chunk, (unsigned int)(~size & 0xFFFF));
+			chunk.insert(chunk.end(), raw.begin() + offset, raw.begin() + offset + size);
+			offset += size;
+
+			if (!size)
+				break;
+		}
+
+		for (uint8_t byte : raw)
+		{
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+
+		PutBE32(chunk, (b << 16) | a);
+		PutChunk(encoded, "IDAT", chunk);
+
+		chunk.clear();
+		PutChunk(encoded, "IEND", chunk);
+
+		/* path_NNNNNN.ext, numbered by emulated frame */
+		char number[32];
+		size_t dot = path.rfind('.');
+		size_t slash = path.find_last_of("/\\");
+
+		if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+			dot = path.size();
+
+		snprintf(number, sizeof(number), "_%06llu", (unsigned long long)frame.index);
+
+		std::string name = path.substr(0, dot) + number + path.substr(dot);
+
+		if ((file = fopen(name.c_str(), "wb")) == NULL)
+		{
+			failed = true;
+			return;
+		}
+
+		Write(encoded.data(), encoded.size());
+
+		if (fclose(file) != 0)
+			failed = true;
+
+		file = NULL;
+	}
+
+	void Chip8VideoSink::WriteGIF(const Frame& frame, uint64_t count)
+	{
+		unsigned int bits = frame.has_plane1 ? 2 : 1;
+		unsigned int colour;
+		size_t offset;
+
+		encoded.clear();
+
+		if (!header_written)
+		{
+			static const uint8_t LOOP[19] = { 0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 0x03, 0x01, 0x00, 0x00, 0x00 };
+
+			header_written = true;
+
+			/* Logical screen without a global colour table; every frame brings its own */
+			encoded.insert(encoded.end(), { 'G', 'I', 'F', '8', '9', 'a' });
+			PutLE16(encoded, video_width);
+			PutLE16(encoded, video_height);
+			encoded.insert(encoded.end(), { 0x00, 0x00, 0x00 });
+			encoded.insert(encoded.end(), LOOP, LOOP + sizeof(LOOP));
+		}
+
+		/* Delays are in hundredths of a second; round frame boundaries so the total stays exact */
+		uint64_t start = (frame.index * 100 + 30) / 60;
+		uint64_t end = ((frame.index + count) * 100 + 30) / 60;
+		uint64_t delay = std::min(end - start, (uint64_t)0xFFFF);
+
+		encoded.insert(encoded.end(), { 0x21, 0xF9, 0x04, 0x04 });
+		PutLE16(encoded, (unsigned int)delay);
+		encoded.insert(encoded.end(), { 0x00, 0x00 });
+
+		/* Image descriptor with a local colour table of 1 << bits entries */
+		encoded.push_back(0x2C);
+		PutLE16(encoded, 0);
+		PutLE16(encoded, 0);
+		PutLE16(encoded, video_width);
+		PutLE16(encoded, video_height);
+		encoded.push_back((uint8_t)(0x80 | (bits - 1)));
+
+		for (colour = 0; colour < (1U << bits); colour++)
+			encoded.insert(encoded.end(), PALETTE_RGB[colour], PALETTE_RGB[colour] + 3);
+
+		/* GIF's smallest LZW code size is 2, even for two colours */
+		std::vector<uint8_t> data;
+
+		Rasterize(frame, video_width, video_height);
+		EncodeLZW(indices, 2, data);
+
+		encoded.push_back(2);
+
+		for (offset = 0; offset < data.size(); offset += 255)
+		{
+			size_t size = std::min(data.size() - offset, (size_t)255);
+
+			encoded.push_back((uint8_t)size);
+			encoded.insert(encoded.end(), data.begin() + offset, data.begin() + offset + size);
+		}
+
+		encoded.push_back(0);
+
+		Write(encoded.data(), encoded.size());
+	}
+
+	#pragma endregion
+}
@@ -0,0 +1,142 @@
+#ifndef _VIDEO_H_
+#define _VIDEO_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "chip8.h"
+
+namespace CHIP8
+{
+	enum VideoFormat
+	{
+		/* YUV4MPEG2, 4:4:4 full range at 60 fps. Every palette colour maps to its own YUV triple, so it is lossless. */
+		VIDEO_Y4M,
+
+		/* One indexed PNG per distinct frame, named after the emulated frame it first appeared on */
+		VIDEO_PNG,
+
+		/* Animated GIF, each distinct frame shown for as long as it lasted */
+		VIDEO_GIF
+	};
+
+	struct VideoStats
+	{
+		/* Frames passed to AddFrame, and those dropped for matching the one before */
+		uint64_t frames;
+		uint64_t duplicates;
+
+		/* Times AddFrame waited for the writer because the queue was full */
+		uint64_t stalls;
+
+		uint64_t bytes_written;
+	};
+
+	/*
+	 * Records the framebuffer once per emulated frame without an SDL window. AddFrame compares the frame with the
+	 * previous one and drops it if nothing changed; otherwise it copies the planes into a slot of a bounded queue.
+	 * A writer thread encodes and writes them, so the emulation thread only pays for a compare and a copy of at
+	 * most 2 KB. Dropped frames are not lost: the writer repeats the last frame in Y4M, gives it a longer delay in
+	 * GIF and leaves a gap in the PNG numbering. A full queue makes AddFrame wait rather than drop a frame.
+	 *
+	 * Indexed PNGs are 1 bit per pixel, or 2 once an XO-CHIP second plane is in use, and GIF frames carry a 2 or
+	 * 4 colour table to match. Both are built here without zlib: PNG data goes in stored deflate blocks, GIF
+	 * data is LZW coded.
+	 */
+	class Chip8VideoSink
+	{
+		public:
+			/* Frames queued before AddFrame waits for the writer */
+			static const unsigned int QUEUE_FRAMES = 64;
+
+		private:
+			struct Frame
+			{
+				uint64_t planes[Chip8Processor::DISPLAY_PLANES * Chip8Processor::MAX_DISPLAY_WORDS];
+				unsigned int width;
+				unsigned int height;
+				bool has_plane1;
+
+				/* Emulated frame it first appeared on */
+				uint64_t index;
+			};
+
+			VideoFormat format;
+			std::string path;
+			unsigned int scale;
+			FILE* file;
+
+			/* Producer: frames seen, the last frame kept, and whether there is one */
+			uint64_t frames;
+			uint64_t duplicates;
+			uint64_t stalls;
+			Frame last;
+			bool have_last;
+
+			/* Ring of QUEUE_FRAMES slots between AddFrame and the writer */
+			std::vector<Frame> queue;
+			size_t queue_head;
+			size_t queue_count;
+			bool closing;
+			std::mutex lock;
+			std::condition_variable frame_added;
+			std::condition_variable frame_taken;
+			std::thread writer;
+
+			/* Y4M and GIF size: the hires screen, so low resolution frames are doubled rather than hires ones halved */
+			unsigned int video_width;
+			unsigned int video_height;
+			bool header_written;
+
+			/* Writer: the frame waiting for its length, encode buffers, and the outcome */
+			Frame pending;
+			bool have_pending;
+			std::vector<uint8_t> indices;
+			std::vector<uint8_t> encoded;
+			std::atomic<uint64_t> bytes_written;
+			std::atomic<bool> failed;
+
+			void WriterLoop();
+
+			/* Encode and write frame, which lasted count emulated frames */
+			void WriteFrame(const Frame& frame, uint64_t count);
+
+			/* Palette indices of frame resampled to width x height, into indices */
+			void Rasterize(const Frame& frame, unsigned int width, unsigned int height);
+
+			void WriteY4M(const Frame& frame, uint64_t count);
+			void WritePNG(const Frame& frame);
+			void WriteGIF(const Frame& frame, uint64_t count);
+
+			bool Write(const void* data, size_t size);
+
+		public:
+			Chip8VideoSink();
+			~Chip8VideoSink();
+
+			/* Pick the format from path's extension: .y4m, .png or .gif. Returns false for anything else. */
+			static bool FormatFromPath(const char* path, VideoFormat& format);
+
+			/*
+			 * Start recording to path and start the writer. Y4M and GIF are 128x64 times scale, PNGs are the frame's
+			 * own size times scale. For VIDEO_PNG, path is a pattern: frames are written as path with _NNNNNN (the
+			 * frame number) before the extension.
+			 */
+			bool Open(const char* path, VideoFormat format, unsigned int scale = 1);
+
+			/* Offer the frame chip8 just finished. Call once per emulated frame, from one thread. */
+			void AddFrame(const Chip8Processor& chip8);
+
+			/* Flush the last frame, stop the writer and close the output. Returns false if anything failed to write. */
+			bool Close();
+
+			VideoStats GetStats() const;
+	};
+}
+
+#endif